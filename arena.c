@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+struct ArenaBlock {
+    ArenaBlock* next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGNMENT) unsigned char data[];
+};
+
+void initArena(Arena* arena) {
+    arena->head = NULL;
+    arena->bytes_used = 0;
+    arena->bytes_reserved = 0;
+    arena->allocation_count = 0;
+    arena->block_count = 0;
+}
+
+static ArenaBlock* newBlock(Arena* arena, size_t size) {
+    ArenaBlock* block = malloc(sizeof(ArenaBlock) + size);
+    if (block == NULL) {
+        fprintf(stderr, "Out of memory allocating AST.\n");
+        exit(74);
+    }
+    block->size = size;
+    block->used = 0;
+    arena->bytes_reserved += size;
+    arena->block_count++;
+    return block;
+}
+
+void* arenaAlloc(Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    ArenaBlock* block = arena->head;
+
+    if (block == NULL || block->size - block->used < size) {
+        if (size > ARENA_BLOCK_SIZE / 4) {
+            // Oversized requests get a block of their own behind the current
+            // one so the remaining space in the current block is not wasted.
+            ArenaBlock* large = newBlock(arena, size);
+            if (block == NULL) {
+                large->next = NULL;
+                arena->head = large;
+            } else {
+                large->next = block->next;
+                block->next = large;
+            }
+            large->used = size;
+            arena->bytes_used += size;
+            arena->allocation_count++;
+            return large->data;
+        }
+        block = newBlock(arena, ARENA_BLOCK_SIZE);
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    void* result = block->data + block->used;
+    block->used += size;
+    arena->bytes_used += size;
+    arena->allocation_count++;
+    return result;
+}
+
+void freeArena(Arena* arena) {
+    ArenaBlock* block = arena->head;
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    initArena(arena);
+}
+
+void printArenaStats(Arena* arena, FILE* out) {
+    fprintf(out, "arena: %d allocations, %zu bytes used, %zu bytes reserved in %d blocks\n",
+            arena->allocation_count, arena->bytes_used, arena->bytes_reserved, arena->block_count);
+}
@@ -0,0 +1,24 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Bump-pointer allocator for the AST. Everything allocated from an arena is
+// released together by freeArena; there is no per-object free.
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;
+    size_t bytes_used;
+    size_t bytes_reserved;
+    int allocation_count;
+    int block_count;
+} Arena;
+
+void initArena(Arena* arena);
+void* arenaAlloc(Arena* arena, size_t size);
+void freeArena(Arena* arena);
+void printArenaStats(Arena* arena, FILE* out);
+
+#endif
@@ -0,0 +1,309 @@
+// Benchmark harness: runs each workload through the pipeline one phase at a
+// time and prints, for every phase, wall time statistics over the
+// repetitions, heap allocations and the workload's peak RSS, as one JSON
+// object per line so results from different versions can be compared.
+//
+//   bench [-n runs] [--tree-walk] [--label name] [--generate blocks] [script.tc...]
+//
+// The phases are lex (tokenize), parse, check (resolve, type check and
+// optimize at -O1) and run (compile to bytecode and run on the VM, or walk
+// the tree with --tree-walk). --generate adds a synthetic script of the given
+// number of blocks, built in memory. Each workload runs in its own child
+// process, after one unmeasured warm-up run, so its peak RSS is its own.
+//
+// Allocations are counted by wrapping malloc, calloc and realloc at link time
+// (-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc; see the Makefile). Only
+// calls made by the compiler itself are counted, not those inside the C
+// library, and memory the source or VM maps directly does not show up.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "compiler.h"
+#include "interpreter.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "source.h"
+#include "tokenbuffer.h"
+#include "typecheck.h"
+#include "vm.h"
+
+enum { PHASE_LEX, PHASE_PARSE, PHASE_CHECK, PHASE_RUN, PHASE_COUNT };
+
+static const char* phaseNames[PHASE_COUNT] = {"lex", "parse", "check", "run"};
+
+static long allocationCount;
+static long long allocationBytes;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    allocationCount++;
+    allocationBytes += size;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    allocationCount++;
+    allocationBytes += count * size;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+    allocationCount++;
+    allocationBytes += size;
+    return __real_realloc(pointer, size);
+}
+
+typedef struct {
+    double* seconds;        // One entry per measured repetition
+    long allocations;       // Per repetition; every repetition does the same work
+    long long bytes;
+} PhaseStats;
+
+typedef struct {
+    double start;
+    long allocations;
+    long long bytes;
+} Probe;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void beginPhase(Probe* probe) {
+    probe->allocations = allocationCount;
+    probe->bytes = allocationBytes;
+    probe->start = now();
+}
+
+static void endPhase(Probe* probe, PhaseStats* stats, int repetition) {
+    double elapsed = now() - probe->start;
+    if (repetition < 0) return;
+    stats->seconds[repetition] = elapsed;
+    stats->allocations = allocationCount - probe->allocations;
+    stats->bytes = allocationBytes - probe->bytes;
+}
+
+// Runs the whole pipeline once, recording each phase under repetition (or
+// nowhere for the warm-up run, repetition -1). Returns 0 if the script does
+// not compile.
+static int runOnce(const char* text, int treeWalk, PhaseStats* stats, int repetition) {
+    Probe probe;
+    int ok = 0;
+
+    beginPhase(&probe);
+    Interner interner;
+    initInterner(&interner);
+    Lexer lexer;
+    initLexer(&lexer, text, &interner);
+    TokenBuffer tokens;
+    initTokenBuffer(&tokens);
+    tokenize(&tokens, &lexer);
+    endPhase(&probe, &stats[PHASE_LEX], repetition);
+
+    beginPhase(&probe);
+    Arena arena;
+    initArena(&arena);
+    Parser parser;
+    initParser(&parser, &tokens, &arena);
+    Node* program = parseProgram(&parser);
+    endPhase(&probe, &stats[PHASE_PARSE], repetition);
+    if (parser.hadError) goto done;
+
+    beginPhase(&probe);
+    if (!resolveProgram(program, stderr) || !typeCheckProgram(program, &arena, stderr)) goto done;
+    optimizeProgram(program, OPTIMIZE_FOLD, &arena);
+    endPhase(&probe, &stats[PHASE_CHECK], repetition);
+
+    beginPhase(&probe);
+    if (treeWalk) {
+        Interpreter interpreter;
+        initInterpreter(&interpreter, program);
+        evaluateNode(&interpreter, program);
+        freeInterpreter(&interpreter);
+    } else {
+        Chunk chunk;
+        initChunk(&chunk);
+        if (!compileProgram(program, &chunk, stderr)) {
+            freeChunk(&chunk);
+            goto done;
+        }
+        VM vm;
+        initVM(&vm);
+        runVM(&vm, &chunk);
+        freeVM(&vm);
+        freeChunk(&chunk);
+    }
+    endPhase(&probe, &stats[PHASE_RUN], repetition);
+    ok = 1;
+
+done:
+    freeArena(&arena);
+    freeTokenBuffer(&tokens);
+    freeInterner(&interner);
+    return ok;
+}
+
+static int compareSeconds(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void printString(const char* text) {
+    putchar('"');
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            printf("\\%c", *c);
+        } else if ((unsigned char)*c < 0x20) {
+            printf("\\u%04x", *c);
+        } else {
+            putchar(*c);
+        }
+    }
+    putchar('"');
+}
+
+static void report(const char* label, const char* workload, int treeWalk, size_t length, int runs,
+                   PhaseStats* stats, long peakKilobytes) {
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        double* seconds = stats[phase].seconds;
+        qsort(seconds, runs, sizeof(double), compareSeconds);
+        double median = runs % 2 ? seconds[runs / 2] : (seconds[runs / 2 - 1] + seconds[runs / 2]) / 2;
+        int p99 = (runs * 99 + 99) / 100 - 1;    // Nearest rank
+
+        printf("{\"label\":");
+        printString(label);
+        printf(",\"workload\":");
+        printString(workload);
+        printf(",\"engine\":\"%s\",\"phase\":\"%s\",\"source_bytes\":%zu,\"runs\":%d", treeWalk ? "tree-walk" : "vm",
+               phaseNames[phase], length, runs);
+        printf(",\"min_ms\":%.4f,\"median_ms\":%.4f,\"p99_ms\":%.4f", seconds[0] * 1e3, median * 1e3,
+               seconds[p99] * 1e3);
+        printf(",\"allocations\":%ld,\"allocated_bytes\":%lld,\"peak_rss_kb\":%ld}\n", stats[phase].allocations,
+               stats[phase].bytes, peakKilobytes);
+    }
+}
+
+// Measures one workload in a child process. Returns the child's exit status.
+static int benchmark(const char* label, const char* workload, const char* text, int runs, int treeWalk) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "Could not start a process for %s.\n", workload);
+        return 70;
+    }
+    if (pid > 0) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        return WIFEXITED(status) ? WEXITSTATUS(status) : 70;
+    }
+
+    PhaseStats stats[PHASE_COUNT];
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        stats[phase].seconds = calloc(runs, sizeof(double));
+    }
+    int ok = runOnce(text, treeWalk, stats, -1);
+    for (int i = 0; ok && i < runs; i++) {
+        ok = runOnce(text, treeWalk, stats, i);
+    }
+    if (!ok) {
+        fprintf(stderr, "%s does not compile.\n", workload);
+        _exit(65);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    report(label, workload, treeWalk, strlen(text), runs, stats, usage.ru_maxrss);
+    fflush(stdout);
+    _exit(0);
+}
+
+// A large script of independent blocks, each with its own locals, a branch
+// and a short loop, so the program's frame stays small however long it gets.
+static char* generate(int blocks) {
+    size_t capacity = 64 + (size_t)blocks * 256;
+    char* text = malloc(capacity);
+    size_t length = sprintf(text, "int total = 0;\n");
+    for (int i = 0; i < blocks; i++) {
+        int a = i % 97;
+        length += sprintf(text + length,
+                          "{\n"
+                          "    int a%d = %d;\n"
+                          "    float f%d = a%d * 0.5 + %d.25;\n"
+                          "    if (a%d) { total = total + a%d / 3; }\n"
+                          "    int c%d = %d;\n"
+                          "    while (c%d) { c%d = c%d - 1; total = total - c%d; }\n"
+                          "}\n",
+                          i, a, i, i, a % 10, i, i, i, a % 8, i, i, i, i);
+    }
+    sprintf(text + length, "return total;\n");
+    return text;
+}
+
+// Loads a script as a terminated string; the lexer reads up to the NUL.
+static char* readScript(const char* path) {
+    Source source;
+    if (!openSource(&source, path, stderr)) return NULL;
+    loadSource(&source);
+    char* text = malloc(source.length + 1);
+    memcpy(text, source.data, source.length);
+    text[source.length] = '\0';
+    closeSource(&source);
+    return text;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-n runs] [--tree-walk] [--label name] [--generate blocks] [script.tc...]\n", program);
+    exit(64);
+}
+
+int main(int argc, char* argv[]) {
+    int runs = 10;
+    int treeWalk = 0;
+    const char* label = "unknown";
+    int status = 0;
+    int workloads = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+            if (runs < 1) usage(argv[0]);
+        } else if (strcmp(argv[i], "--tree-walk") == 0) {
+            treeWalk = 1;
+        } else if (strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+            label = argv[++i];
+        } else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+            int blocks = atoi(argv[++i]);
+            if (blocks < 1) usage(argv[0]);
+            char name[32];
+            snprintf(name, sizeof(name), "generated:%d", blocks);
+            char* text = generate(blocks);
+            int result = benchmark(label, name, text, runs, treeWalk);
+            if (result != 0) status = result;
+            free(text);
+            workloads++;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+        } else {
+            char* text = readScript(argv[i]);
+            int result = text == NULL ? 74 : benchmark(label, argv[i], text, runs, treeWalk);
+            if (result != 0) status = result;
+            free(text);
+            workloads++;
+        }
+    }
+    if (workloads == 0) usage(argv[0]);
+    return status;
+}
@@ -0,0 +1,120 @@
+// Lexer throughput benchmark: tokenizes the same text with every scanning
+// mode this machine supports and reports MB/s for each.
+//
+//   lexbench [file] [repetitions]
+//
+// Without a file a synthetic program of about 64 MB is generated in memory.
+// Every mode must produce the same tokens; a mismatch exits with status 1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lexer.h"
+#include "source.h"
+
+static const char *modeNames[] = {"scalar", "table", "sse2", "avx2"};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char* generate(size_t target) {
+    static const char* lines[] = {
+        "int counter_%zu = %zu;\n",
+        "    // accumulate the running total for iteration %zu of %zu\n",
+        "float ratio_%zu = %zu.25 * 3.5 / (counter + 1);\n",
+        "while (counter_%zu) { counter_%zu = counter_%zu - 1; }\n",
+        "\t\tif (value) {   total = total + value_%zu * %zu;   }\n",
+    };
+    size_t count = sizeof(lines) / sizeof(lines[0]);
+    char* text = malloc(target + 256);
+    if (text == NULL) return NULL;
+
+    size_t length = 0;
+    for (size_t i = 0; length < target; i++) {
+        const char* format = lines[i % count];
+        length += sprintf(text + length, format, i, i, i);
+    }
+    return text;
+}
+
+// A cheap digest of the token stream so modes can be compared.
+static unsigned long long lex(const char* text, LexerMode mode, size_t* tokens) {
+    Interner interner;
+    initInterner(&interner);
+
+    Lexer lexer;
+    initLexer(&lexer, text, &interner);
+    lexer.mode = mode;
+
+    unsigned long long digest = 1469598103934665603ULL;
+    size_t count = 0;
+    for (;;) {
+        Token token = nextToken(&lexer);
+        digest = (digest ^ (unsigned long long)token.type) * 1099511628211ULL;
+        digest = (digest ^ (unsigned long long)(token.lexeme - text)) * 1099511628211ULL;
+        digest = (digest ^ (unsigned long long)token.length) * 1099511628211ULL;
+        digest = (digest ^ ((unsigned long long)token.line << 20 | (unsigned long long)token.column)) * 1099511628211ULL;
+        digest = (digest ^ (unsigned long long)(token.symbol + 1)) * 1099511628211ULL;
+        count++;
+        if (token.type == TOKEN_EOF) break;
+    }
+    freeInterner(&interner);
+    *tokens = count;
+    return digest;
+}
+
+int main(int argc, char* argv[]) {
+    Source source = {0};
+    const char* text;
+    size_t length;
+    int repetitions = argc > 2 ? atoi(argv[2]) : 5;
+    char* generated = NULL;
+
+    if (argc > 1) {
+        if (!openSource(&source, argv[1], stderr)) return 74;
+        loadSource(&source);
+        // initLexer wants a terminated string; copy so a mapped file is not
+        // read past its end.
+        generated = malloc(source.length + 1);
+        memcpy(generated, source.data, source.length);
+        generated[source.length] = '\0';
+        closeSource(&source);
+    } else {
+        generated = generate((size_t)64 << 20);
+    }
+    if (generated == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        return 74;
+    }
+    text = generated;
+    length = strlen(text);
+    if (repetitions < 1) repetitions = 1;
+
+    printf("%zu bytes, best mode %s\n", length, modeNames[bestLexerMode()]);
+
+    unsigned long long expected = 0;
+    int status = 0;
+    for (LexerMode mode = LEXER_SCALAR; mode <= bestLexerMode(); mode++) {
+        double best = 0.0;
+        size_t tokens = 0;
+        unsigned long long digest = 0;
+        for (int i = 0; i < repetitions; i++) {
+            double start = now();
+            digest = lex(text, mode, &tokens);
+            double elapsed = now() - start;
+            if (i == 0 || elapsed < best) best = elapsed;
+        }
+        if (mode == LEXER_SCALAR) expected = digest;
+        printf("%-7s %9.1f MB/s  %zu tokens%s\n", modeNames[mode],
+               length / best / 1e6, tokens,
+               digest == expected ? "" : "  (token stream differs!)");
+        if (digest != expected) status = 1;
+    }
+
+    free(generated);
+    return status;
+}
@@ -0,0 +1,269 @@
+// Per-record evaluation benchmark: runs one compiled script over many input
+// records through libtinyc and reports records per second, as one JSON
+// object per line like bench.c.
+//
+//   recordbench [-n records] [-j threads] [script.tc]
+//
+// Each record writes every input slot of a bound array and runs the script on
+// the same context, which is how a host evaluates a formula over a data set.
+// The records are pseudo-random and the same on every run. Without a script a
+// built-in pricing formula is used, and it is also measured the way a host
+// had to before inputs existed: splicing the record into the source as
+// initializers and compiling it again. That mode runs on a sample of the
+// records, since it is far slower. Both modes must agree on every result they
+// compute; a mismatch exits with status 1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "tinyc.h"
+
+#define FORMULA_INPUTS \
+    "input int quantity;\n" \
+    "input float price;\n" \
+    "input int tier;\n"
+
+#define FORMULA_BODY \
+    "float total = quantity * price;\n" \
+    "if (tier) {\n" \
+    "    total = total - total * 0.05 * tier;\n" \
+    "}\n" \
+    "int bulk = quantity / 100;\n" \
+    "if (bulk) {\n" \
+    "    total = total - bulk * 2.5;\n" \
+    "}\n" \
+    "return total;\n"
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Fills values with record number index, each of its input's type.
+static void makeRecord(const TinycScript* script, long index, Value* values) {
+    unsigned long long state = (unsigned long long)index * 6364136223846793005ull + 1442695040888963407ull;
+    for (int i = 0; i < tinycInputCount(script); i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        int bits = (int)(state >> 40);
+        if (tinycInputType(script, i) == VALUE_FLOAT) {
+            values[i] = (Value){VALUE_FLOAT, {.float_value = (bits % 100000) / 100.0f}};
+        } else {
+            values[i] = (Value){VALUE_INT, {.int_value = bits % 1000}};
+        }
+    }
+}
+
+static double resultNumber(Value value) {
+    return value.type == VALUE_FLOAT ? value.as.float_value : value.as.int_value;
+}
+
+static void report(const char* workload, const char* mode, long records, double seconds, double checksum) {
+    printf("{\"workload\":\"%s\",\"mode\":\"%s\",\"records\":%ld,\"seconds\":%.4f,"
+           "\"records_per_second\":%.0f,\"ns_per_record\":%.1f,\"checksum\":%.6g}\n",
+           workload, mode, records, seconds, records / seconds, seconds * 1e9 / records, checksum);
+}
+
+static void fail(const char* what, TinycStatus status, const char* message) {
+    fprintf(stderr, "%s failed with status %d%s%s\n", what, status, message != NULL ? ": " : "",
+            message != NULL ? message : "");
+    exit(status == TINYC_OK ? 1 : status);
+}
+
+// Compiles once and runs every record on one context, rewriting only the
+// bound input array in between, and stores each record's result in results.
+static void runBound(const char* workload, const TinycScript* script, long records, double* results) {
+    Value* inputs = calloc(tinycInputCount(script) + 1, sizeof(Value));
+    TinycContext* context = tinycNewContext();
+    tinycBindInputs(context, inputs);
+
+    double checksum = 0;
+    double start = now();
+    for (long i = 0; i < records; i++) {
+        makeRecord(script, i, inputs);
+        Value result;
+        TinycStatus status = tinycRun(context, script, &result);
+        if (status != TINYC_OK) fail("run", status, tinycContextError(context));
+        checksum += resultNumber(result);
+        results[i] = resultNumber(result);
+    }
+    report(workload, "bound", records, now() - start, checksum);
+
+    tinycFreeContext(context);
+    free(inputs);
+}
+
+// Runs every record in one call per kernel kind, from the same records laid out
+// as one column per input.
+static void runColumns(const char* workload, const TinycScript* script, long records, const double* expected) {
+    static const struct {
+        TinycKernels kernels;
+        const char* mode;
+    } kinds[] = {
+        {TINYC_KERNELS_SCALAR, "columns-scalar"},
+        {TINYC_KERNELS_SSE2, "columns-sse2"},
+        {TINYC_KERNELS_AVX2, "columns-avx2"},
+    };
+    int inputCount = tinycInputCount(script);
+    Value* values = calloc(inputCount + 1, sizeof(Value));
+    void** inputs = calloc(inputCount + 1, sizeof(void*));
+    for (int i = 0; i < inputCount; i++) inputs[i] = malloc(records * sizeof(int));
+    for (long i = 0; i < records; i++) {
+        makeRecord(script, i, values);
+        for (int j = 0; j < inputCount; j++) {
+            if (values[j].type == VALUE_FLOAT) {
+                ((float*)inputs[j])[i] = values[j].as.float_value;
+            } else {
+                ((int*)inputs[j])[i] = values[j].as.int_value;
+            }
+        }
+    }
+    ValueType type = tinycColumnResultType(script);
+    void* results = malloc(records * sizeof(int));
+    TinycContext* context = tinycNewContext();
+
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        if (!tinycUseKernels(context, kinds[k].kernels)) continue;
+        double start = now();
+        TinycStatus status = tinycRunColumns(context, script, (const void* const*)inputs, records, results);
+        double seconds = now() - start;
+        if (status != TINYC_OK) fail("column run", status, tinycContextError(context));
+
+        double checksum = 0;
+        for (long i = 0; i < records; i++) {
+            double result = type == VALUE_FLOAT ? ((float*)results)[i] : ((int*)results)[i];
+            if (result != expected[i]) {
+                fprintf(stderr, "Record %ld: bound run gave %g, %s run gave %g.\n", i, expected[i], kinds[k].mode,
+                        result);
+                exit(1);
+            }
+            checksum += result;
+        }
+        report(workload, kinds[k].mode, records, seconds, checksum);
+    }
+
+    tinycFreeContext(context);
+    free(results);
+    for (int i = 0; i < inputCount; i++) free(inputs[i]);
+    free(inputs);
+    free(values);
+}
+
+// Runs all the records on each thread count in turn, checking every result.
+static void runThreads(const char* workload, const TinycScript* script, long records, int maxThreads,
+                       const double* expected) {
+    int inputCount = tinycInputCount(script);
+    Value* values = malloc((records * inputCount + 1) * sizeof(Value));
+    for (long i = 0; i < records; i++) makeRecord(script, i, values + i * inputCount);
+    Value* results = malloc(records * sizeof(Value));
+    TinycContext* context = tinycNewContext();
+
+    double single = 0;
+    for (int threads = 1; threads <= maxThreads; threads = threads * 2 > maxThreads && threads < maxThreads
+                                                                ? maxThreads
+                                                                : threads * 2) {
+        double start = now();
+        TinycStatus status = tinycRunRecords(context, script, values, records, results, threads);
+        double seconds = now() - start;
+        if (status != TINYC_OK) fail("threaded run", status, tinycContextError(context));
+
+        double checksum = 0;
+        for (long i = 0; i < records; i++) {
+            if (resultNumber(results[i]) != expected[i]) {
+                fprintf(stderr, "Record %ld: bound run gave %g, run on %d threads gave %g.\n", i, expected[i],
+                        threads, resultNumber(results[i]));
+                exit(1);
+            }
+            checksum += resultNumber(results[i]);
+        }
+        if (threads == 1) single = seconds;
+        printf("{\"workload\":\"%s\",\"mode\":\"threads\",\"threads\":%d,\"records\":%ld,\"seconds\":%.4f,"
+               "\"records_per_second\":%.0f,\"speedup\":%.2f,\"checksum\":%.6g}\n",
+               workload, threads, records, seconds, records / seconds, single / seconds, checksum);
+    }
+
+    tinycFreeContext(context);
+    free(results);
+    free(values);
+}
+
+// Compiles the formula afresh for every record, with the record's values
+// written into the source as initializers.
+static void runRecompiled(const TinycScript* script, long records, long stride, const double* expected) {
+    Value values[3];
+    char source[sizeof(FORMULA_BODY) + 128];
+    TinycContext* context = tinycNewContext();
+
+    double checksum = 0;
+    long count = 0;
+    double start = now();
+    for (long i = 0; i < records; i += stride) {
+        makeRecord(script, i, values);
+        int length = snprintf(source, sizeof(source), "int quantity = %d;\nfloat price = %.9g;\nint tier = %d;\n%s",
+                              values[0].as.int_value, values[1].as.float_value, values[2].as.int_value,
+                              FORMULA_BODY);
+        TinycScript* compiled;
+        TinycStatus status = tinycCompile(source, length, 1, &compiled, NULL);
+        if (status != TINYC_OK) fail("compile", status, NULL);
+        Value result;
+        status = tinycRun(context, compiled, &result);
+        if (status != TINYC_OK) fail("run", status, tinycContextError(context));
+        tinycFreeScript(compiled);
+
+        if (resultNumber(result) != expected[i]) {
+            fprintf(stderr, "Record %ld: bound run gave %g, recompiled run gave %g.\n", i, expected[i],
+                    resultNumber(result));
+            exit(1);
+        }
+        checksum += resultNumber(result);
+        count++;
+    }
+    report("formula", "recompiled", count, now() - start, checksum);
+    tinycFreeContext(context);
+}
+
+int main(int argc, char* argv[]) {
+    long records = 1000000;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char* path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            records = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            if (threads < 1) records = 0;
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            records = 0;
+            break;
+        }
+    }
+    if (records < 1) {
+        fprintf(stderr, "Usage: %s [-n records] [-j threads] [script.tc]\n", argv[0]);
+        return 64;
+    }
+
+    TinycScript* script;
+    char* errors = NULL;
+    TinycStatus status = path != NULL ? tinycCompileFile(path, 1, &script, &errors)
+                                      : tinycCompile(FORMULA_INPUTS FORMULA_BODY,
+                                                     strlen(FORMULA_INPUTS FORMULA_BODY), 1, &script, &errors);
+    if (status != TINYC_OK) {
+        if (errors != NULL) fputs(errors, stderr);
+        free(errors);
+        return status;
+    }
+
+    const char* workload = path != NULL ? path : "formula";
+    double* results = malloc(records * sizeof(double));
+    runBound(workload, script, records, results);
+    if (tinycColumnResultType(script) != VALUE_VOID) runColumns(workload, script, records, results);
+    runThreads(workload, script, records, threads < 1 ? 1 : threads, results);
+    if (path == NULL) runRecompiled(script, records, records < 1000 ? 1 : records / 1000, results);
+    free(results);
+    tinycFreeScript(script);
+    return 0;
+}
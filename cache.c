@@ -0,0 +1,327 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cache.h"
+
+// File layout, all integers little-endian and every section 8-byte aligned:
+//
+//   header     CacheHeader
+//   code       code_count bytes, exactly as the compiler emitted them
+//   constants  constant_count entries of {uint32 type, uint32 bits}
+//   functions  function_count entries of {int32 entry, int32 arity, int32 max_stack}
+//   inputs     input_count entries of {uint32 type, uint32 name length}
+//   names      the input names back to back, input_name_bytes in all
+//
+// Nothing in the file is a pointer, so it can be mapped at any address. The
+// header's checksum covers everything after it, and the code is checked to
+// stay inside the file's tables before it is run, so a damaged file is a
+// miss rather than a crash.
+static const char magic[8] = {'T', 'C', 'B', 'C', 'A', 'C', 'H', 'E'};
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t optimize_level;
+    uint64_t source_hash;
+    uint64_t source_length;
+    uint64_t checksum;
+    uint32_t code_count;
+    uint32_t constant_count;
+    uint32_t function_count;
+    uint32_t max_stack;
+    uint32_t frame_size;
+    uint32_t input_count;
+    uint32_t input_name_bytes;
+} CacheHeader;
+
+static size_t align(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+static int isLittleEndian(void) {
+    uint16_t probe = 1;
+    return *(uint8_t*)&probe == 1;
+}
+
+// FNV-1a over 8-byte words rather than bytes, with a shift after each
+// multiply so high bits feed back into low ones. The source is hashed on
+// every cached run, so this is on the startup path.
+static uint64_t hashBytes(const char* data, size_t length) {
+    uint64_t hash = 14695981039346656037ull ^ length;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+        hash ^= hash >> 29;
+    }
+    for (; i < length; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Section offsets from the start of the file, as laid out above.
+typedef struct {
+    size_t code;
+    size_t constants;
+    size_t functions;
+    size_t inputs;
+    size_t names;
+    size_t end;
+} Layout;
+
+static Layout layoutOf(const CacheHeader* header) {
+    Layout layout;
+    layout.code = align(sizeof(CacheHeader));
+    layout.constants = layout.code + align(header->code_count);
+    layout.functions = layout.constants + align((size_t)header->constant_count * 8);
+    layout.inputs = layout.functions + align((size_t)header->function_count * 12);
+    layout.names = layout.inputs + align((size_t)header->input_count * 8);
+    layout.end = layout.names + align(header->input_name_bytes);
+    return layout;
+}
+
+// Operand words after each opcode; the rest have none.
+static const uint8_t operandCounts[OP_RETURN + 1] = {
+    [OP_CONSTANT] = 1, [OP_GET_LOCAL] = 1, [OP_SET_LOCAL] = 1, [OP_INPUT] = 1,
+    [OP_GET_GLOBAL] = 1, [OP_SET_GLOBAL] = 1, [OP_POPN] = 1,
+    [OP_JUMP] = 1, [OP_JUMP_IF_FALSE] = 1, [OP_JUMP_IF_FALSE_FLOAT] = 1,
+    [OP_JUMP_IF_TRUE] = 1, [OP_JUMP_IF_TRUE_FLOAT] = 1,
+    [OP_ADD_LOCAL_CONSTANT] = 2, [OP_SUBTRACT_LOCAL_CONSTANT] = 2, [OP_MULTIPLY_LOCAL_CONSTANT] = 2,
+    [OP_DIVIDE_LOCAL_CONSTANT] = 2, [OP_INCREMENT_LOCAL] = 2, [OP_JUMP_IF_LOCAL_FALSE] = 2,
+    [OP_JUMP_UNLESS_EQUAL_INT] = 1, [OP_JUMP_UNLESS_NOT_EQUAL_INT] = 1,
+    [OP_JUMP_UNLESS_LESS_INT] = 1, [OP_JUMP_UNLESS_LESS_EQUAL_INT] = 1,
+    [OP_JUMP_UNLESS_GREATER_INT] = 1, [OP_JUMP_UNLESS_GREATER_EQUAL_INT] = 1,
+    [OP_JUMP_UNLESS_EQUAL_FLOAT] = 1, [OP_JUMP_UNLESS_NOT_EQUAL_FLOAT] = 1,
+    [OP_JUMP_UNLESS_LESS_FLOAT] = 1, [OP_JUMP_UNLESS_LESS_EQUAL_FLOAT] = 1,
+    [OP_JUMP_UNLESS_GREATER_FLOAT] = 1, [OP_JUMP_UNLESS_GREATER_EQUAL_FLOAT] = 1,
+    [OP_LOOP] = 1, [OP_CALL] = 1, [OP_TAIL_CALL] = 1,
+};
+
+static int isJump(uint8_t op) {
+    return op == OP_JUMP || op == OP_JUMP_IF_FALSE || op == OP_JUMP_IF_FALSE_FLOAT || op == OP_JUMP_IF_TRUE ||
+           op == OP_JUMP_IF_TRUE_FLOAT || op == OP_JUMP_IF_LOCAL_FALSE ||
+           (op >= OP_JUMP_UNLESS_EQUAL_INT && op <= OP_JUMP_UNLESS_GREATER_EQUAL_FLOAT);
+}
+
+// Checks that every instruction is whole and every constant, input, function
+// and jump it names exists, and that functions and jumps land on the start
+// of an instruction, so the VM never reads outside the chunk.
+static int validChunk(const Chunk* chunk) {
+    int valid = chunk->count > 0 && chunk->code[chunk->count - 1] == OP_RETURN &&
+                chunk->frame_size >= 0 && chunk->frame_size <= chunk->max_stack;
+    uint8_t* starts = calloc(chunk->count + 1, 1);
+    for (int i = 0; valid && i < chunk->count;) {
+        uint8_t op = chunk->code[i];
+        starts[i] = 1;
+        if (op > OP_RETURN || i + 1 + 2 * operandCounts[op] > chunk->count) {
+            valid = 0;
+            break;
+        }
+        i += 1 + 2 * operandCounts[op];
+    }
+    for (int i = 0; valid && i < chunk->function_count; i++) {
+        const FunctionEntry* function = &chunk->functions[i];
+        valid = function->entry >= 0 && function->entry < chunk->count && starts[function->entry] &&
+                function->arity >= 0 && function->arity <= function->max_stack;
+    }
+    for (int i = 0; valid && i < chunk->count;) {
+        uint8_t op = chunk->code[i];
+        int next = i + 1 + 2 * operandCounts[op];
+        int last = (chunk->code[next - 2] << 8) | chunk->code[next - 1];
+        int index = operandCounts[op] == 0 ? 0 : last;
+        switch (op) {
+            case OP_CONSTANT: valid = index < chunk->constant_count; break;
+            case OP_INPUT: valid = index < chunk->input_count; break;
+            case OP_CALL:
+            case OP_TAIL_CALL: valid = index < chunk->function_count; break;
+            case OP_LOOP: valid = index <= next && starts[next - index]; break;
+            case OP_ADD_LOCAL_CONSTANT:
+            case OP_SUBTRACT_LOCAL_CONSTANT:
+            case OP_MULTIPLY_LOCAL_CONSTANT:
+            case OP_DIVIDE_LOCAL_CONSTANT:
+            case OP_INCREMENT_LOCAL: valid = index < chunk->constant_count; break;
+            default:
+                if (isJump(op)) valid = next + index <= chunk->count && starts[next + index];
+                break;
+        }
+        i = next;
+    }
+    free(starts);
+    return valid;
+}
+
+void initCacheKey(CacheKey* key, const char* scriptPath, Source* source, int optimizeLevel) {
+    size_t length = strlen(scriptPath);
+    if (length > 3 && strcmp(scriptPath + length - 3, ".tc") == 0) length -= 3;
+    key->path = malloc(length + 5);
+    memcpy(key->path, scriptPath, length);
+    memcpy(key->path + length, ".tcb", 5);
+    key->source_hash = hashBytes(source->data, source->length);
+    key->source_length = source->length;
+    key->optimize_level = optimizeLevel;
+}
+
+void freeCacheKey(CacheKey* key) {
+    free(key->path);
+    key->path = NULL;
+}
+
+int loadCache(CacheKey* key, CachedProgram* cached) {
+    if (!isLittleEndian()) return 0;
+    int fd = open(key->path, O_RDONLY);
+    if (fd == -1) return 0;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(CacheHeader)) {
+        close(fd);
+        return 0;
+    }
+    size_t size = info.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return 0;
+
+    const CacheHeader* header = mapping;
+    Layout layout = layoutOf(header);
+    if (memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != CACHE_VERSION ||
+        header->optimize_level != (uint32_t)key->optimize_level || header->source_hash != key->source_hash ||
+        header->source_length != key->source_length || layout.end != size ||
+        header->checksum != hashBytes((const char*)mapping + layout.code, size - layout.code)) {
+        munmap(mapping, size);
+        return 0;
+    }
+
+    Chunk* chunk = &cached->chunk;
+    initChunk(chunk);
+    chunk->code = (uint8_t*)mapping + layout.code;
+    chunk->count = header->code_count;
+    chunk->max_stack = header->max_stack;
+    chunk->frame_size = header->frame_size;
+
+    const uint32_t* constants = (const uint32_t*)((const char*)mapping + layout.constants);
+    chunk->constant_count = header->constant_count;
+    chunk->constants = malloc((chunk->constant_count > 0 ? chunk->constant_count : 1) * sizeof(Value));
+    for (int i = 0; i < chunk->constant_count; i++) {
+        chunk->constants[i].type = (ValueType)constants[2 * i];
+        memcpy(&chunk->constants[i].as, &constants[2 * i + 1], sizeof(uint32_t));
+    }
+
+    const int32_t* functions = (const int32_t*)((const char*)mapping + layout.functions);
+    chunk->function_count = header->function_count;
+    chunk->functions = malloc((chunk->function_count > 0 ? chunk->function_count : 1) * sizeof(FunctionEntry));
+    for (int i = 0; i < chunk->function_count; i++) {
+        chunk->functions[i] = (FunctionEntry){functions[3 * i], functions[3 * i + 1], functions[3 * i + 2]};
+    }
+
+    const uint32_t* inputs = (const uint32_t*)((const char*)mapping + layout.inputs);
+    const char* names = (const char*)mapping + layout.names;
+    size_t nameBytes = 0;
+    chunk->input_count = header->input_count;
+    chunk->inputs = calloc(chunk->input_count > 0 ? chunk->input_count : 1, sizeof(InputSlot));
+    for (int i = 0; i < chunk->input_count; i++) {
+        size_t length = inputs[2 * i + 1];
+        if (nameBytes + length > header->input_name_bytes) {
+            freeInputSlots(chunk->inputs, i);
+            free(chunk->constants);
+            free(chunk->functions);
+            munmap(mapping, size);
+            return 0;
+        }
+        chunk->inputs[i].type = (ValueType)inputs[2 * i];
+        chunk->inputs[i].name = malloc(length + 1);
+        memcpy(chunk->inputs[i].name, names + nameBytes, length);
+        chunk->inputs[i].name[length] = '\0';
+        nameBytes += length;
+    }
+
+    if (!validChunk(chunk)) {
+        freeInputSlots(chunk->inputs, chunk->input_count);
+        free(chunk->constants);
+        free(chunk->functions);
+        munmap(mapping, size);
+        return 0;
+    }
+
+    cached->mapping = mapping;
+    cached->mapping_size = size;
+    return 1;
+}
+
+void freeCachedProgram(CachedProgram* cached) {
+    free(cached->chunk.constants);
+    free(cached->chunk.functions);
+    freeInputSlots(cached->chunk.inputs, cached->chunk.input_count);
+    munmap(cached->mapping, cached->mapping_size);
+    cached->mapping = NULL;
+}
+
+int writeCache(CacheKey* key, Chunk* chunk) {
+    if (!isLittleEndian()) return 0;
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = CACHE_VERSION;
+    header.optimize_level = key->optimize_level;
+    header.source_hash = key->source_hash;
+    header.source_length = key->source_length;
+    header.code_count = chunk->count;
+    header.constant_count = chunk->constant_count;
+    header.function_count = chunk->function_count;
+    header.max_stack = chunk->max_stack;
+    header.frame_size = chunk->frame_size;
+    header.input_count = chunk->input_count;
+    for (int i = 0; i < chunk->input_count; i++) {
+        header.input_name_bytes += (uint32_t)strlen(chunk->inputs[i].name);
+    }
+
+    // The file is built in memory, padding zeroed, so the checksum can go in
+    // the header before anything is written.
+    Layout layout = layoutOf(&header);
+    char* file = calloc(layout.end, 1);
+    memcpy(file + layout.code, chunk->code, chunk->count);
+    uint32_t* constants = (uint32_t*)(file + layout.constants);
+    for (int i = 0; i < chunk->constant_count; i++) {
+        constants[2 * i] = chunk->constants[i].type;
+        memcpy(&constants[2 * i + 1], &chunk->constants[i].as, sizeof(uint32_t));
+    }
+    int32_t* functions = (int32_t*)(file + layout.functions);
+    for (int i = 0; i < chunk->function_count; i++) {
+        functions[3 * i] = chunk->functions[i].entry;
+        functions[3 * i + 1] = chunk->functions[i].arity;
+        functions[3 * i + 2] = chunk->functions[i].max_stack;
+    }
+    uint32_t* inputs = (uint32_t*)(file + layout.inputs);
+    size_t nameBytes = 0;
+    for (int i = 0; i < chunk->input_count; i++) {
+        inputs[2 * i] = chunk->inputs[i].type;
+        inputs[2 * i + 1] = (uint32_t)strlen(chunk->inputs[i].name);
+        memcpy(file + layout.names + nameBytes, chunk->inputs[i].name, inputs[2 * i + 1]);
+        nameBytes += inputs[2 * i + 1];
+    }
+    header.checksum = hashBytes(file + layout.code, layout.end - layout.code);
+    memcpy(file, &header, sizeof(header));
+
+    // Write under a temporary name and rename, so a concurrent run never maps
+    // a half-written file.
+    size_t length = strlen(key->path);
+    char* tempPath = malloc(length + 8);
+    memcpy(tempPath, key->path, length);
+    memcpy(tempPath + length, ".XXXXXX", 8);
+    int fd = mkstemp(tempPath);
+    if (fd != -1) fchmod(fd, 0644);
+    FILE* out = fd == -1 ? NULL : fdopen(fd, "wb");
+    int ok = out != NULL && fwrite(file, 1, layout.end, out) == layout.end;
+    if (out != NULL && fclose(out) != 0) ok = 0;
+    if (fd != -1 && !out) close(fd);
+    if (ok && rename(tempPath, key->path) != 0) ok = 0;
+    if (!ok && fd != -1) unlink(tempPath);
+
+    free(tempPath);
+    free(file);
+    return ok;
+}
@@ -0,0 +1,44 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "chunk.h"
+#include "source.h"
+
+#define CACHE_VERSION 5
+
+// Identifies the compiled form of one script: where its cache file lives and
+// what the cached bytecode was compiled from. A cache only matches a key with
+// the same source hash, source length and optimization level.
+typedef struct {
+    char* path;             // The script's path with ".tc" replaced by ".tcb"
+    uint64_t source_hash;
+    uint64_t source_length;
+    int optimize_level;
+} CacheKey;
+
+// Bytecode loaded from a cache file. The code is used in place from a
+// read-only mapping of the file; constants, function entries and inputs are
+// decoded into ordinary arrays.
+typedef struct {
+    Chunk chunk;
+    void* mapping;
+    size_t mapping_size;
+} CachedProgram;
+
+// Hashes the whole source, which must already be loaded.
+void initCacheKey(CacheKey* key, const char* scriptPath, Source* source, int optimizeLevel);
+void freeCacheKey(CacheKey* key);
+
+// Maps the cache file for key. Returns 0 if there is none, it was written by
+// another format version or from another source or optimization level, or it
+// is damaged.
+int loadCache(CacheKey* key, CachedProgram* cached);
+void freeCachedProgram(CachedProgram* cached);
+
+// Writes chunk as the cache for key, replacing any older one atomically.
+// Returns 0 if the file could not be written.
+int writeCache(CacheKey* key, Chunk* chunk);
+
+#endif
@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "chunk.h"
+
+void initChunk(Chunk* chunk) {
+    chunk->code = NULL;
+    chunk->count = 0;
+    chunk->capacity = 0;
+    chunk->constants = NULL;
+    chunk->constant_count = 0;
+    chunk->constant_capacity = 0;
+    chunk->max_stack = 0;
+    chunk->frame_size = 0;
+    chunk->functions = NULL;
+    chunk->function_count = 0;
+    chunk->inputs = NULL;
+    chunk->input_count = 0;
+    chunk->sealed = NULL;
+    chunk->sealed_size = 0;
+}
+
+void writeChunk(Chunk* chunk, uint8_t byte) {
+    if (chunk->count == chunk->capacity) {
+        chunk->capacity = chunk->capacity < 64 ? 64 : chunk->capacity * 2;
+        chunk->code = realloc(chunk->code, chunk->capacity);
+    }
+    chunk->code[chunk->count++] = byte;
+}
+
+int addConstant(Chunk* chunk, Value value) {
+    for (int i = 0; i < chunk->constant_count; i++) {
+        Value existing = chunk->constants[i];
+        if (existing.type == value.type && existing.as.int_value == value.as.int_value) {
+            return i;
+        }
+    }
+    if (chunk->constant_count == chunk->constant_capacity) {
+        chunk->constant_capacity = chunk->constant_capacity < 16 ? 16 : chunk->constant_capacity * 2;
+        chunk->constants = realloc(chunk->constants, chunk->constant_capacity * sizeof(Value));
+    }
+    chunk->constants[chunk->constant_count] = value;
+    return chunk->constant_count++;
+}
+
+// The function table and constants come first, so each stays aligned.
+void sealChunk(Chunk* chunk) {
+    if (chunk->sealed != NULL) return;
+    size_t functionBytes = chunk->function_count * sizeof(FunctionEntry);
+    size_t constantBytes = chunk->constant_count * sizeof(Value);
+    size_t size = functionBytes + constantBytes + chunk->count;
+    if (size == 0) return;
+
+    unsigned char* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return;
+    if (functionBytes > 0) memcpy(memory, chunk->functions, functionBytes);
+    if (constantBytes > 0) memcpy(memory + functionBytes, chunk->constants, constantBytes);
+    if (chunk->count > 0) memcpy(memory + functionBytes + constantBytes, chunk->code, chunk->count);
+    if (mprotect(memory, size, PROT_READ) != 0) {
+        munmap(memory, size);
+        return;
+    }
+
+    free(chunk->functions);
+    free(chunk->constants);
+    free(chunk->code);
+    chunk->functions = (FunctionEntry*)memory;
+    chunk->constants = (Value*)(memory + functionBytes);
+    chunk->code = memory + functionBytes + constantBytes;
+    chunk->capacity = chunk->count;
+    chunk->constant_capacity = chunk->constant_count;
+    chunk->sealed = memory;
+    chunk->sealed_size = size;
+}
+
+void freeChunk(Chunk* chunk) {
+    if (chunk->sealed != NULL) {
+        munmap(chunk->sealed, chunk->sealed_size);
+    } else {
+        free(chunk->code);
+        free(chunk->constants);
+        free(chunk->functions);
+    }
+    freeInputSlots(chunk->inputs, chunk->input_count);
+    initChunk(chunk);
+}
+
+void freeInputSlots(InputSlot* inputs, int count) {
+    for (int i = 0; i < count; i++) free(inputs[i].name);
+    free(inputs);
+}
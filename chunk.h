@@ -0,0 +1,120 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "value.h"
+
+// Bytecode instructions. Operands follow the opcode as big-endian 16-bit words.
+typedef enum {
+    OP_CONSTANT,        // [index]        push constants[index]
+    OP_VOID,            //                push void
+    OP_GET_LOCAL,       // [slot]         push frame[slot]
+    OP_SET_LOCAL,       // [slot]         frame[slot] = top, value stays on the stack
+    OP_INPUT,           // [index]        push the host's value for input slot index
+    OP_GET_GLOBAL,      // [slot]         push stack[slot], a slot of the program's frame
+    OP_SET_GLOBAL,      // [slot]         stack[slot] = top, value stays on the stack
+    OP_POP,             //                drop top
+    OP_POPN,            // [count]        drop count values (scope exit)
+    OP_ADD_INT,         //                arithmetic on operands the type checker
+    OP_SUBTRACT_INT,    //                proved are both ints or both floats
+    OP_MULTIPLY_INT,
+    OP_DIVIDE_INT,
+    OP_NEGATE_INT,
+    OP_ADD_FLOAT,
+    OP_SUBTRACT_FLOAT,
+    OP_MULTIPLY_FLOAT,
+    OP_DIVIDE_FLOAT,
+    OP_NEGATE_FLOAT,
+    OP_INT_TO_FLOAT,
+    OP_FLOAT_TO_INT,
+    OP_EQUAL_INT,       //                pop two operands of one type and push the
+    OP_NOT_EQUAL_INT,   //                int 1 if they compare true, or 0
+    OP_LESS_INT,
+    OP_LESS_EQUAL_INT,
+    OP_GREATER_INT,
+    OP_GREATER_EQUAL_INT,
+    OP_EQUAL_FLOAT,
+    OP_NOT_EQUAL_FLOAT,
+    OP_LESS_FLOAT,
+    OP_LESS_EQUAL_FLOAT,
+    OP_GREATER_FLOAT,
+    OP_GREATER_EQUAL_FLOAT,
+    OP_NOT_INT,         //                replace top with the int 1 if it is zero, or 0
+    OP_NOT_FLOAT,
+    OP_JUMP,            // [offset]       ip += offset
+    OP_JUMP_IF_FALSE,   // [offset]       pop an int, ip += offset if it is zero
+    OP_JUMP_IF_FALSE_FLOAT, // [offset]   pop a float, ip += offset if it is zero
+    OP_JUMP_IF_TRUE,    // [offset]       pop an int, ip += offset if it is not zero
+    OP_JUMP_IF_TRUE_FLOAT,  // [offset]   pop a float, ip += offset if it is not zero
+    // Superinstructions for int locals, each standing for a common sequence.
+    OP_ADD_LOCAL_CONSTANT,      // [slot][index]    push frame[slot] + constants[index]
+    OP_SUBTRACT_LOCAL_CONSTANT, // [slot][index]    push frame[slot] - constants[index]
+    OP_MULTIPLY_LOCAL_CONSTANT, // [slot][index]    push frame[slot] * constants[index]
+    OP_DIVIDE_LOCAL_CONSTANT,   // [slot][index]    push frame[slot] / constants[index]
+    OP_INCREMENT_LOCAL,         // [slot][index]    frame[slot] += constants[index], nothing pushed
+    OP_JUMP_IF_LOCAL_FALSE,     // [slot][offset]   ip += offset if frame[slot] is zero
+    // Compare and branch for conditions: pop two operands of one type and
+    // ip += offset unless they compare true, pushing nothing.
+    OP_JUMP_UNLESS_EQUAL_INT,   // [offset]
+    OP_JUMP_UNLESS_NOT_EQUAL_INT,
+    OP_JUMP_UNLESS_LESS_INT,
+    OP_JUMP_UNLESS_LESS_EQUAL_INT,
+    OP_JUMP_UNLESS_GREATER_INT,
+    OP_JUMP_UNLESS_GREATER_EQUAL_INT,
+    OP_JUMP_UNLESS_EQUAL_FLOAT,
+    OP_JUMP_UNLESS_NOT_EQUAL_FLOAT,
+    OP_JUMP_UNLESS_LESS_FLOAT,
+    OP_JUMP_UNLESS_LESS_EQUAL_FLOAT,
+    OP_JUMP_UNLESS_GREATER_FLOAT,
+    OP_JUMP_UNLESS_GREATER_EQUAL_FLOAT,
+    OP_LOOP,            // [offset]       ip -= offset
+    OP_CALL,            // [function]     call with the arguments on top of the stack as the new frame
+    OP_TAIL_CALL,       // [function]     move the arguments to the current frame and jump
+    OP_RETURN           //                pop, leave the frame and push the value; halt in the program's frame
+} OpCode;
+
+// Where a function's code starts in the chunk, and how much stack it needs
+// above its frame base, parameters included.
+typedef struct {
+    int entry;
+    int arity;
+    int max_stack;
+} FunctionEntry;
+
+// A variable the host supplies for each run, found by its index in the
+// chunk's inputs.
+typedef struct {
+    char* name;
+    ValueType type;
+} InputSlot;
+
+typedef struct {
+    uint8_t* code;
+    int count;
+    int capacity;
+    Value* constants;
+    int constant_count;
+    int constant_capacity;
+    int max_stack;
+    int frame_size;         // Program slots the VM zeroes and reserves before running
+    FunctionEntry* functions;
+    int function_count;
+    InputSlot* inputs;
+    int input_count;
+    void* sealed;           // Read-only mapping holding the code, constants and functions, once sealed
+    size_t sealed_size;
+} Chunk;
+
+void initChunk(Chunk* chunk);
+void writeChunk(Chunk* chunk, uint8_t byte);
+int addConstant(Chunk* chunk, Value value);
+// Moves the code, constants and function table into one read-only mapping, so
+// a stray write to a chunk that threads share faults instead of racing. Nothing
+// may be written to the chunk afterwards. If the mapping cannot be made the
+// chunk stays as it is.
+void sealChunk(Chunk* chunk);
+void freeChunk(Chunk* chunk);
+void freeInputSlots(InputSlot* inputs, int count);
+
+#endif
@@ -0,0 +1,476 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "codegen.h"
+
+typedef struct {
+    FILE* out;
+    float* floats;          // Float constants, emitted as .LF<index>
+    int float_count;
+    int float_capacity;
+    int label_count;
+    int hadError;
+} CodeGen;
+
+static void errorAt(CodeGen* gen, Token* token, const char* message) {
+    fprintf(stderr, "[line %d] Error at '%.*s': %s\n", token->line, token->length, token->lexeme, message);
+    gen->hadError = 1;
+}
+
+static void emit(CodeGen* gen, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    fputc('\t', gen->out);
+    vfprintf(gen->out, format, args);
+    fputc('\n', gen->out);
+    va_end(args);
+}
+
+static int newLabel(CodeGen* gen) {
+    return gen->label_count++;
+}
+
+static void emitLabel(CodeGen* gen, int label) {
+    fprintf(gen->out, ".L%d:\n", label);
+}
+
+static int floatConstant(CodeGen* gen, float value) {
+    for (int i = 0; i < gen->float_count; i++) {
+        if (memcmp(&gen->floats[i], &value, sizeof(float)) == 0) return i;
+    }
+    if (gen->float_count == gen->float_capacity) {
+        gen->float_capacity = gen->float_capacity < 16 ? 16 : gen->float_capacity * 2;
+        gen->floats = realloc(gen->floats, gen->float_capacity * sizeof(float));
+    }
+    gen->floats[gen->float_count] = value;
+    return gen->float_count++;
+}
+
+static int slotOffset(Node* identifier) {
+    return -4 * (identifier->as.identifier.slot + 1);
+}
+
+// Code generation -------------------------------------------------------------
+
+static ValueType generateExpression(CodeGen* gen, Node* node);
+
+static int isSimpleOperand(Node* node) {
+    return node->type == NODE_LITERAL || node->type == NODE_IDENTIFIER;
+}
+
+// Loads a literal or variable into %ecx or %xmm1 without touching %eax/%xmm0.
+static ValueType loadOperand(CodeGen* gen, Node* node) {
+    if (node->type == NODE_LITERAL) {
+        Value value = node->as.literal.value;
+        if (value.type == VALUE_INT) {
+            emit(gen, "movl $%d, %%ecx", value.as.int_value);
+        } else {
+            emit(gen, "movss .LF%d(%%rip), %%xmm1", floatConstant(gen, value.as.float_value));
+        }
+        return value.type;
+    }
+    if (node->value_type == VALUE_INT) {
+        emit(gen, "movl %d(%%rbp), %%ecx", slotOffset(node));
+    } else {
+        emit(gen, "movss %d(%%rbp), %%xmm1", slotOffset(node));
+    }
+    return node->value_type;
+}
+
+static void pushResult(CodeGen* gen, ValueType type) {
+    if (type == VALUE_INT) {
+        emit(gen, "pushq %%rax");
+    } else {
+        emit(gen, "subq $8, %%rsp");
+        emit(gen, "movss %%xmm0, (%%rsp)");
+    }
+}
+
+static void popResult(CodeGen* gen, ValueType type) {
+    if (type == VALUE_INT) {
+        emit(gen, "popq %%rax");
+    } else {
+        emit(gen, "movss (%%rsp), %%xmm0");
+        emit(gen, "addq $8, %%rsp");
+    }
+}
+
+// Both operands have the node's type; the type checker converted them.
+static ValueType generateOperands(CodeGen* gen, Node* node) {
+    // The left operand ends up in %eax/%xmm0 and the right one in %ecx/%xmm1.
+    ValueType type = generateExpression(gen, node->as.binary.left);
+    if (isSimpleOperand(node->as.binary.right)) {
+        loadOperand(gen, node->as.binary.right);
+    } else {
+        pushResult(gen, type);
+        generateExpression(gen, node->as.binary.right);
+        if (type == VALUE_INT) {
+            emit(gen, "movl %%eax, %%ecx");
+        } else {
+            emit(gen, "movaps %%xmm0, %%xmm1");
+        }
+        popResult(gen, type);
+    }
+    return type;
+}
+
+// Condition code suffixes for j<cc> and set<cc>, each paired with its
+// negation so that flipping the low bit of an index negates it.
+typedef enum {
+    CC_E, CC_NE, CC_L, CC_GE, CC_LE, CC_G, CC_A, CC_BE, CC_AE, CC_B
+} Condition;
+
+static const char* conditionNames[] = {"e", "ne", "l", "ge", "le", "g", "a", "be", "ae", "b"};
+
+static int isFloatEquality(Operation operation) {
+    return operation == OPERATION_EQUAL_FLOAT || operation == OPERATION_NOT_EQUAL_FLOAT;
+}
+
+// Compares the operands and returns the condition under which the comparison
+// holds. Float orderings compare the other way round where needed so each is
+// "above" or "above or equal", which an unordered (NaN) result fails, as in
+// C. Float == and != also need the parity flag checked.
+static Condition compareOperands(CodeGen* gen, Operation operation) {
+    if (operation < OPERATION_EQUAL_FLOAT) {
+        emit(gen, "cmpl %%ecx, %%eax");
+    } else if (operation == OPERATION_LESS_FLOAT || operation == OPERATION_LESS_EQUAL_FLOAT) {
+        emit(gen, "ucomiss %%xmm0, %%xmm1");
+    } else {
+        emit(gen, "ucomiss %%xmm1, %%xmm0");
+    }
+    switch (operation) {
+        case OPERATION_EQUAL_INT:           return CC_E;
+        case OPERATION_NOT_EQUAL_INT:       return CC_NE;
+        case OPERATION_LESS_INT:            return CC_L;
+        case OPERATION_LESS_EQUAL_INT:      return CC_LE;
+        case OPERATION_GREATER_INT:         return CC_G;
+        case OPERATION_GREATER_EQUAL_INT:   return CC_GE;
+        case OPERATION_EQUAL_FLOAT:         return CC_E;
+        case OPERATION_NOT_EQUAL_FLOAT:     return CC_NE;
+        case OPERATION_LESS_FLOAT:          return CC_A;
+        case OPERATION_LESS_EQUAL_FLOAT:    return CC_AE;
+        case OPERATION_GREATER_FLOAT:       return CC_A;
+        default:                            return CC_AE;
+    }
+}
+
+// Sets %eax to 1 if the condition holds, or 0. A float equality also needs
+// the result to be ordered, and a float inequality holds when it is not.
+static void setFlag(CodeGen* gen, Condition condition, int floatEquality) {
+    emit(gen, "set%s %%al", conditionNames[condition]);
+    if (floatEquality && condition == CC_E) {
+        emit(gen, "setnp %%cl");
+        emit(gen, "andb %%cl, %%al");
+    } else if (floatEquality) {
+        emit(gen, "setp %%cl");
+        emit(gen, "orb %%cl, %%al");
+    }
+    emit(gen, "movzbl %%al, %%eax");
+}
+
+// Jumps to label if the condition holds when sense is set, or if it does not.
+static void jumpOn(CodeGen* gen, Condition condition, int floatEquality, int sense, int label) {
+    if (!sense) condition ^= 1;
+    if (!floatEquality) {
+        emit(gen, "j%s .L%d", conditionNames[condition], label);
+    } else if (condition == CC_E) {
+        int unordered = newLabel(gen);
+        emit(gen, "jp .L%d", unordered);
+        emit(gen, "je .L%d", label);
+        emitLabel(gen, unordered);
+    } else {
+        emit(gen, "jp .L%d", label);
+        emit(gen, "jne .L%d", label);
+    }
+}
+
+static ValueType generateBinary(CodeGen* gen, Node* node) {
+    generateOperands(gen, node);
+    if (isComparison(node->operation)) {
+        setFlag(gen, compareOperands(gen, node->operation), isFloatEquality(node->operation));
+        return node->value_type;
+    }
+
+    switch (node->operation) {
+        case OPERATION_ADD_INT:         emit(gen, "addl %%ecx, %%eax"); break;
+        case OPERATION_SUBTRACT_INT:    emit(gen, "subl %%ecx, %%eax"); break;
+        case OPERATION_MULTIPLY_INT:    emit(gen, "imull %%ecx, %%eax"); break;
+        case OPERATION_DIVIDE_INT: {
+            // idivl faults on both of these, so they exit like the interpreters.
+            int checked = newLabel(gen);
+            emit(gen, "testl %%ecx, %%ecx");
+            emit(gen, "je .Ldivision_by_zero");
+            emit(gen, "cmpl $-1, %%ecx");
+            emit(gen, "jne .L%d", checked);
+            emit(gen, "cmpl $0x80000000, %%eax");
+            emit(gen, "je .Linteger_overflow");
+            emitLabel(gen, checked);
+            emit(gen, "cltd");
+            emit(gen, "idivl %%ecx");
+            break;
+        }
+        case OPERATION_ADD_FLOAT:       emit(gen, "addss %%xmm1, %%xmm0"); break;
+        case OPERATION_SUBTRACT_FLOAT:  emit(gen, "subss %%xmm1, %%xmm0"); break;
+        case OPERATION_MULTIPLY_FLOAT:  emit(gen, "mulss %%xmm1, %%xmm0"); break;
+        case OPERATION_DIVIDE_FLOAT:    emit(gen, "divss %%xmm1, %%xmm0"); break;
+        default:
+            errorAt(gen, &node->token, "Operator is not supported by the native backend.");
+            break;
+    }
+    return node->value_type;
+}
+
+static void jumpIf(CodeGen* gen, Node* condition, int sense, int label);
+
+static void storeVariable(CodeGen* gen, Node* identifier, ValueType type) {
+    if (type == VALUE_INT) {
+        emit(gen, "movl %%eax, %d(%%rbp)", slotOffset(identifier));
+    } else {
+        emit(gen, "movss %%xmm0, %d(%%rbp)", slotOffset(identifier));
+    }
+}
+
+static ValueType generateExpression(CodeGen* gen, Node* node) {
+    switch (node->type) {
+        case NODE_LITERAL:
+            if (node->as.literal.value.type == VALUE_INT) {
+                emit(gen, "movl $%d, %%eax", node->as.literal.value.as.int_value);
+            } else {
+                emit(gen, "movss .LF%d(%%rip), %%xmm0", floatConstant(gen, node->as.literal.value.as.float_value));
+            }
+            return node->as.literal.value.type;
+        case NODE_IDENTIFIER:
+            if (node->value_type == VALUE_INT) {
+                emit(gen, "movl %d(%%rbp), %%eax", slotOffset(node));
+            } else {
+                emit(gen, "movss %d(%%rbp), %%xmm0", slotOffset(node));
+            }
+            return node->value_type;
+        case NODE_ASSIGNMENT: {
+            ValueType type = generateExpression(gen, node->as.assignment.right);
+            storeVariable(gen, node->as.assignment.left, type);
+            return type;
+        }
+        case NODE_UNARY:
+            generateExpression(gen, node->as.unary.operand);
+            if (node->operation == OPERATION_NEGATE_INT) {
+                emit(gen, "negl %%eax");
+            } else if (node->operation == OPERATION_NEGATE_FLOAT) {
+                emit(gen, "xorps .Lsign(%%rip), %%xmm0");
+            } else if (node->operation == OPERATION_NOT_INT) {
+                emit(gen, "testl %%eax, %%eax");
+                setFlag(gen, CC_E, 0);
+            } else if (node->operation == OPERATION_NOT_FLOAT) {
+                emit(gen, "xorps %%xmm1, %%xmm1");
+                emit(gen, "ucomiss %%xmm1, %%xmm0");
+                setFlag(gen, CC_E, 1);
+            } else {
+                errorAt(gen, &node->token, "Operator is not supported by the native backend.");
+            }
+            return node->value_type;
+        case NODE_CONVERT:
+            generateExpression(gen, node->as.unary.operand);
+            if (node->operation == OPERATION_INT_TO_FLOAT) {
+                emit(gen, "cvtsi2ssl %%eax, %%xmm0");
+            } else {
+                emit(gen, "cvttss2si %%xmm0, %%eax");
+            }
+            return node->value_type;
+        case NODE_BINARY:
+            return generateBinary(gen, node);
+        case NODE_LOGICAL: {
+            int falseLabel = newLabel(gen);
+            int endLabel = newLabel(gen);
+            jumpIf(gen, node, 0, falseLabel);
+            emit(gen, "movl $1, %%eax");
+            emit(gen, "jmp .L%d", endLabel);
+            emitLabel(gen, falseLabel);
+            emit(gen, "xorl %%eax, %%eax");
+            emitLabel(gen, endLabel);
+            return VALUE_INT;
+        }
+        case NODE_CALL:
+            errorAt(gen, &node->token, "Function calls are not supported by the native backend.");
+            return VALUE_VOID;
+        default:
+            errorAt(gen, &node->token, "Expression is not supported by the native backend.");
+            return VALUE_VOID;
+    }
+}
+
+// Jumps to label when the condition is true if sense is set, or when it is
+// false. A comparison branches on the flags it sets, and && || ! become jumps
+// around the tests of their operands. A NaN float counts as true, as in the
+// interpreter.
+static void jumpIf(CodeGen* gen, Node* condition, int sense, int label) {
+    if (condition->type == NODE_LOGICAL) {
+        // The left operand alone decides && when false and || when true.
+        int decided = condition->operation == OPERATION_OR;
+        if (decided == sense) {
+            jumpIf(gen, condition->as.binary.left, sense, label);
+            jumpIf(gen, condition->as.binary.right, sense, label);
+        } else {
+            int skip = newLabel(gen);
+            jumpIf(gen, condition->as.binary.left, decided, skip);
+            jumpIf(gen, condition->as.binary.right, sense, label);
+            emitLabel(gen, skip);
+        }
+    } else if (condition->type == NODE_UNARY &&
+               (condition->operation == OPERATION_NOT_INT || condition->operation == OPERATION_NOT_FLOAT)) {
+        jumpIf(gen, condition->as.unary.operand, !sense, label);
+    } else if (condition->type == NODE_BINARY && isComparison(condition->operation)) {
+        generateOperands(gen, condition);
+        jumpOn(gen, compareOperands(gen, condition->operation), isFloatEquality(condition->operation), sense, label);
+    } else if (generateExpression(gen, condition) == VALUE_INT) {
+        emit(gen, "testl %%eax, %%eax");
+        emit(gen, "j%s .L%d", sense ? "ne" : "e", label);
+    } else {
+        emit(gen, "xorps %%xmm1, %%xmm1");
+        emit(gen, "ucomiss %%xmm1, %%xmm0");
+        jumpOn(gen, CC_NE, 1, sense, label);
+    }
+}
+
+static void printResult(CodeGen* gen, ValueType type) {
+    switch (type) {
+        case VALUE_INT:
+            emit(gen, "movl %%eax, %%esi");
+            emit(gen, "leaq .Lfmt_int(%%rip), %%rdi");
+            emit(gen, "xorl %%eax, %%eax");
+            break;
+        case VALUE_FLOAT:
+            emit(gen, "cvtss2sd %%xmm0, %%xmm0");
+            emit(gen, "leaq .Lfmt_float(%%rip), %%rdi");
+            emit(gen, "movl $1, %%eax");
+            break;
+        case VALUE_VOID:
+            emit(gen, "leaq .Lfmt_void(%%rip), %%rdi");
+            emit(gen, "xorl %%eax, %%eax");
+            break;
+    }
+    emit(gen, "call printf@PLT");
+    emit(gen, "xorl %%eax, %%eax");
+    emit(gen, "leave");
+    emit(gen, "ret");
+}
+
+// Shared exits for runtime errors: print the message on stderr and exit 70,
+// as the interpreters do.
+static void runtimeErrors(CodeGen* gen) {
+    fprintf(gen->out, ".Ldivision_by_zero:\n");
+    emit(gen, "leaq .Lmsg_division(%%rip), %%rdi");
+    emit(gen, "jmp .Lruntime_error");
+    fprintf(gen->out, ".Linteger_overflow:\n");
+    emit(gen, "leaq .Lmsg_overflow(%%rip), %%rdi");
+    fprintf(gen->out, ".Lruntime_error:\n");
+    emit(gen, "andq $-16, %%rsp");
+    emit(gen, "movq stderr@GOTPCREL(%%rip), %%rax");
+    emit(gen, "movq (%%rax), %%rsi");
+    emit(gen, "call fputs@PLT");
+    emit(gen, "movl $70, %%edi");
+    emit(gen, "call exit@PLT");
+}
+
+static void generateStatement(CodeGen* gen, Node* node) {
+    switch (node->type) {
+        case NODE_EXPRESSION_STATEMENT:
+            generateExpression(gen, node->as.expression_statement.expression);
+            break;
+        case NODE_VARIABLE_DECLARATION: {
+            Node* identifier = node->as.variable_declaration.identifier;
+            if (node->as.variable_declaration.input != -1) {
+                errorAt(gen, &identifier->token, "Inputs are not supported by the native backend.");
+            } else if (node->as.variable_declaration.initializer != NULL) {
+                storeVariable(gen, identifier, generateExpression(gen, node->as.variable_declaration.initializer));
+            } else {
+                emit(gen, "movl $0, %d(%%rbp)", slotOffset(identifier));
+            }
+            break;
+        }
+        case NODE_IF_STATEMENT: {
+            int elseLabel = newLabel(gen);
+            jumpIf(gen, node->as.if_statement.condition, 0, elseLabel);
+            generateStatement(gen, node->as.if_statement.then_branch);
+            if (node->as.if_statement.else_branch != NULL) {
+                int endLabel = newLabel(gen);
+                emit(gen, "jmp .L%d", endLabel);
+                emitLabel(gen, elseLabel);
+                generateStatement(gen, node->as.if_statement.else_branch);
+                emitLabel(gen, endLabel);
+            } else {
+                emitLabel(gen, elseLabel);
+            }
+            break;
+        }
+        case NODE_WHILE_STATEMENT: {
+            int loopLabel = newLabel(gen);
+            int exitLabel = newLabel(gen);
+            emitLabel(gen, loopLabel);
+            jumpIf(gen, node->as.while_statement.condition, 0, exitLabel);
+            generateStatement(gen, node->as.while_statement.body);
+            emit(gen, "jmp .L%d", loopLabel);
+            emitLabel(gen, exitLabel);
+            break;
+        }
+        case NODE_BLOCK:
+            for (int i = 0; i < node->as.block.statement_count; i++) {
+                generateStatement(gen, node->as.block.statements[i]);
+            }
+            break;
+        case NODE_RETURN_STATEMENT: {
+            ValueType type = VALUE_VOID;
+            if (node->as.return_statement.expression != NULL) {
+                type = generateExpression(gen, node->as.return_statement.expression);
+            }
+            printResult(gen, type);
+            break;
+        }
+        case NODE_FUNCTION_DECLARATION:
+            // Skipped: calls are rejected above, so no function body is ever reached.
+            break;
+        default:
+            errorAt(gen, &node->token, "Statement is not supported by the native backend.");
+            break;
+    }
+}
+
+int generateAssembly(Node* program, FILE* out) {
+    CodeGen gen;
+    gen.out = out;
+    gen.floats = NULL;
+    gen.float_count = 0;
+    gen.float_capacity = 0;
+    gen.label_count = 0;
+    gen.hadError = 0;
+
+    int frameBytes = (4 * program->as.program.frame_size + 15) & ~15;
+    fprintf(out, "\t.text\n\t.globl main\n\t.type main, @function\nmain:\n");
+    emit(&gen, "pushq %%rbp");
+    emit(&gen, "movq %%rsp, %%rbp");
+    if (frameBytes > 0) emit(&gen, "subq $%d, %%rsp", frameBytes);
+    for (int i = 0; i < program->as.program.declaration_count; i++) {
+        generateStatement(&gen, program->as.program.declarations[i]);
+    }
+    printResult(&gen, VALUE_VOID);
+    runtimeErrors(&gen);
+    fprintf(out, "\t.size main, .-main\n\n");
+
+    fprintf(out, "\t.section .rodata\n");
+    fprintf(out, ".Lfmt_int:\n\t.string \"%%d\\n\"\n");
+    fprintf(out, ".Lfmt_float:\n\t.string \"%%f\\n\"\n");
+    fprintf(out, ".Lfmt_void:\n\t.string \"void\\n\"\n");
+    fprintf(out, ".Lmsg_division:\n\t.string \"Division by zero.\\n\"\n");
+    fprintf(out, ".Lmsg_overflow:\n\t.string \"Integer overflow.\\n\"\n");
+    fprintf(out, "\t.align 4\n");
+    for (int i = 0; i < gen.float_count; i++) {
+        unsigned int bits;
+        memcpy(&bits, &gen.floats[i], sizeof(bits));
+        fprintf(out, ".LF%d:\n\t.long 0x%08x\n", i, bits);
+    }
+    fprintf(out, "\t.align 16\n.Lsign:\n\t.long 0x80000000, 0, 0, 0\n");
+    fprintf(out, "\t.section .note.GNU-stack,\"\",@progbits\n");
+
+    free(gen.floats);
+    return !gen.hadError;
+}
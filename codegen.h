@@ -0,0 +1,14 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include <stdio.h>
+#include "parser.h"
+
+// Emits x86-64 GNU assembly for a type-checked program as a standalone main()
+// that prints the program's result exactly like printValue. Ints are computed
+// in general-purpose registers and floats in SSE registers, chosen from each
+// expression's static type. Returns 0 and reports to stderr if the program
+// uses something the native backend does not support.
+int generateAssembly(Node* program, FILE* out);
+
+#endif
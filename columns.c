@@ -0,0 +1,793 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "columns.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNELS 1
+#endif
+
+// Step operations. Those before COLUMN_KERNEL_COUNT are elementwise kernels
+// with a version for each mode; runColumns does the rest itself. Masks are
+// int columns holding all ones for a record that is set and 0 otherwise.
+typedef enum {
+    COLUMN_ADD_INT,
+    COLUMN_SUBTRACT_INT,
+    COLUMN_MULTIPLY_INT,
+    COLUMN_NEGATE_INT,
+    COLUMN_ADD_FLOAT,
+    COLUMN_SUBTRACT_FLOAT,
+    COLUMN_MULTIPLY_FLOAT,
+    COLUMN_DIVIDE_FLOAT,
+    COLUMN_NEGATE_FLOAT,
+    COLUMN_INT_TO_FLOAT,
+    COLUMN_FLOAT_TO_INT,
+    COLUMN_TEST_INT,        // Mask of the nonzero values
+    COLUMN_TEST_FLOAT,
+    COLUMN_EQUAL_INT,       // Mask of the records where left op right
+    COLUMN_NOT_EQUAL_INT,
+    COLUMN_LESS_INT,
+    COLUMN_LESS_EQUAL_INT,
+    COLUMN_EQUAL_FLOAT,
+    COLUMN_NOT_EQUAL_FLOAT,
+    COLUMN_LESS_FLOAT,
+    COLUMN_LESS_EQUAL_FLOAT,
+    COLUMN_AND,
+    COLUMN_AND_NOT,         // left & ~right
+    COLUMN_OR,
+    COLUMN_SELECT,          // target = right ? left : target
+    COLUMN_COPY,
+    COLUMN_KERNEL_COUNT,
+    COLUMN_DIVIDE_INT = COLUMN_KERNEL_COUNT,
+    COLUMN_SKIP_IF_NONE     // Continues at step target if no record of mask left is set
+} ColumnOp;
+
+typedef void (*ColumnKernel)(void* target, const void* left, const void* right, int count);
+
+// Int arithmetic wraps, as it does on every other engine.
+#define SCALAR_KERNEL(name, type, result, expression) \
+    static void name(void* target, const void* left, const void* right, int count) { \
+        result* t = target; \
+        const type* a = left; \
+        const type* b = right; \
+        (void)b; \
+        for (int i = 0; i < count; i++) t[i] = expression; \
+    }
+
+SCALAR_KERNEL(scalarAddInt, int32_t, int32_t, (int32_t)((uint32_t)a[i] + (uint32_t)b[i]))
+SCALAR_KERNEL(scalarSubtractInt, int32_t, int32_t, (int32_t)((uint32_t)a[i] - (uint32_t)b[i]))
+SCALAR_KERNEL(scalarMultiplyInt, int32_t, int32_t, (int32_t)((uint32_t)a[i] * (uint32_t)b[i]))
+SCALAR_KERNEL(scalarNegateInt, int32_t, int32_t, (int32_t)(0u - (uint32_t)a[i]))
+SCALAR_KERNEL(scalarAddFloat, float, float, a[i] + b[i])
+SCALAR_KERNEL(scalarSubtractFloat, float, float, a[i] - b[i])
+SCALAR_KERNEL(scalarMultiplyFloat, float, float, a[i] * b[i])
+SCALAR_KERNEL(scalarDivideFloat, float, float, a[i] / b[i])
+SCALAR_KERNEL(scalarNegateFloat, float, float, -a[i])
+SCALAR_KERNEL(scalarIntToFloat, int32_t, float, (float)a[i])
+SCALAR_KERNEL(scalarFloatToInt, float, int32_t, floatToInt(a[i]))
+SCALAR_KERNEL(scalarTestInt, int32_t, int32_t, a[i] != 0 ? -1 : 0)
+SCALAR_KERNEL(scalarTestFloat, float, int32_t, a[i] != 0 ? -1 : 0)
+SCALAR_KERNEL(scalarEqualInt, int32_t, int32_t, a[i] == b[i] ? -1 : 0)
+SCALAR_KERNEL(scalarNotEqualInt, int32_t, int32_t, a[i] != b[i] ? -1 : 0)
+SCALAR_KERNEL(scalarLessInt, int32_t, int32_t, a[i] < b[i] ? -1 : 0)
+SCALAR_KERNEL(scalarLessEqualInt, int32_t, int32_t, a[i] <= b[i] ? -1 : 0)
+SCALAR_KERNEL(scalarEqualFloat, float, int32_t, a[i] == b[i] ? -1 : 0)
+SCALAR_KERNEL(scalarNotEqualFloat, float, int32_t, a[i] != b[i] ? -1 : 0)
+SCALAR_KERNEL(scalarLessFloat, float, int32_t, a[i] < b[i] ? -1 : 0)
+SCALAR_KERNEL(scalarLessEqualFloat, float, int32_t, a[i] <= b[i] ? -1 : 0)
+SCALAR_KERNEL(scalarAnd, uint32_t, uint32_t, a[i] & b[i])
+SCALAR_KERNEL(scalarAndNot, uint32_t, uint32_t, a[i] & ~b[i])
+SCALAR_KERNEL(scalarOr, uint32_t, uint32_t, a[i] | b[i])
+SCALAR_KERNEL(scalarSelect, uint32_t, uint32_t, (a[i] & b[i]) | (t[i] & ~b[i]))
+SCALAR_KERNEL(scalarCopy, uint32_t, uint32_t, a[i])
+
+#if defined(__SSE2__)
+static inline __m128i loadInt4(const int32_t* p) {
+    return _mm_loadu_si128((const __m128i*)p);
+}
+
+static inline __m128 loadFloat4(const int32_t* p) {
+    return _mm_loadu_ps((const float*)p);
+}
+
+static inline void storeInt4(int32_t* p, __m128i value) {
+    _mm_storeu_si128((__m128i*)p, value);
+}
+
+static inline void storeFloat4(int32_t* p, __m128 value) {
+    _mm_storeu_ps((float*)p, value);
+}
+
+// SSE2 has no 32-bit multiply keeping the low halves (pmulld is SSE4.1), so
+// even and odd lanes go through the 32x32->64 multiply separately.
+static inline __m128i multiply4(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// x and y are the operands' next 4 values, loaded as vector; the records
+// past the last whole vector go to tail.
+#define SSE2_KERNEL(name, vector, load, store, expression, tail) \
+    static void name(void* target, const void* left, const void* right, int count) { \
+        int32_t* t = target; \
+        const int32_t* a = left; \
+        const int32_t* b = right; \
+        int i = 0; \
+        for (; i + 4 <= count; i += 4) { \
+            vector x = load(a + i); \
+            vector y = load(b + i); \
+            (void)y; \
+            store(t + i, expression); \
+        } \
+        tail(t + i, a + i, b + i, count - i); \
+    }
+
+SSE2_KERNEL(sse2AddInt, __m128i, loadInt4, storeInt4, _mm_add_epi32(x, y), scalarAddInt)
+SSE2_KERNEL(sse2SubtractInt, __m128i, loadInt4, storeInt4, _mm_sub_epi32(x, y), scalarSubtractInt)
+SSE2_KERNEL(sse2MultiplyInt, __m128i, loadInt4, storeInt4, multiply4(x, y), scalarMultiplyInt)
+SSE2_KERNEL(sse2NegateInt, __m128i, loadInt4, storeInt4, _mm_sub_epi32(_mm_setzero_si128(), x), scalarNegateInt)
+SSE2_KERNEL(sse2AddFloat, __m128, loadFloat4, storeFloat4, _mm_add_ps(x, y), scalarAddFloat)
+SSE2_KERNEL(sse2SubtractFloat, __m128, loadFloat4, storeFloat4, _mm_sub_ps(x, y), scalarSubtractFloat)
+SSE2_KERNEL(sse2MultiplyFloat, __m128, loadFloat4, storeFloat4, _mm_mul_ps(x, y), scalarMultiplyFloat)
+SSE2_KERNEL(sse2DivideFloat, __m128, loadFloat4, storeFloat4, _mm_div_ps(x, y), scalarDivideFloat)
+SSE2_KERNEL(sse2NegateFloat, __m128, loadFloat4, storeFloat4, _mm_xor_ps(x, _mm_set1_ps(-0.0f)), scalarNegateFloat)
+SSE2_KERNEL(sse2IntToFloat, __m128i, loadInt4, storeFloat4, _mm_cvtepi32_ps(x), scalarIntToFloat)
+// cvttps2dq gives INT_MIN for NaN and out-of-range values, like floatToInt.
+SSE2_KERNEL(sse2FloatToInt, __m128, loadFloat4, storeInt4, _mm_cvttps_epi32(x), scalarFloatToInt)
+SSE2_KERNEL(sse2TestInt, __m128i, loadInt4, storeInt4,
+            _mm_xor_si128(_mm_cmpeq_epi32(x, _mm_setzero_si128()), _mm_set1_epi32(-1)), scalarTestInt)
+SSE2_KERNEL(sse2TestFloat, __m128, loadFloat4, storeInt4, _mm_castps_si128(_mm_cmpneq_ps(x, _mm_setzero_ps())),
+            scalarTestFloat)
+SSE2_KERNEL(sse2EqualInt, __m128i, loadInt4, storeInt4, _mm_cmpeq_epi32(x, y), scalarEqualInt)
+SSE2_KERNEL(sse2NotEqualInt, __m128i, loadInt4, storeInt4, _mm_xor_si128(_mm_cmpeq_epi32(x, y), _mm_set1_epi32(-1)),
+            scalarNotEqualInt)
+SSE2_KERNEL(sse2LessInt, __m128i, loadInt4, storeInt4, _mm_cmplt_epi32(x, y), scalarLessInt)
+SSE2_KERNEL(sse2LessEqualInt, __m128i, loadInt4, storeInt4,
+            _mm_xor_si128(_mm_cmpgt_epi32(x, y), _mm_set1_epi32(-1)), scalarLessEqualInt)
+// The ordered compares are false for NaN and cmpneq is true, as in C.
+SSE2_KERNEL(sse2EqualFloat, __m128, loadFloat4, storeInt4, _mm_castps_si128(_mm_cmpeq_ps(x, y)), scalarEqualFloat)
+SSE2_KERNEL(sse2NotEqualFloat, __m128, loadFloat4, storeInt4, _mm_castps_si128(_mm_cmpneq_ps(x, y)),
+            scalarNotEqualFloat)
+SSE2_KERNEL(sse2LessFloat, __m128, loadFloat4, storeInt4, _mm_castps_si128(_mm_cmplt_ps(x, y)), scalarLessFloat)
+SSE2_KERNEL(sse2LessEqualFloat, __m128, loadFloat4, storeInt4, _mm_castps_si128(_mm_cmple_ps(x, y)),
+            scalarLessEqualFloat)
+SSE2_KERNEL(sse2And, __m128i, loadInt4, storeInt4, _mm_and_si128(x, y), scalarAnd)
+SSE2_KERNEL(sse2AndNot, __m128i, loadInt4, storeInt4, _mm_andnot_si128(y, x), scalarAndNot)
+SSE2_KERNEL(sse2Or, __m128i, loadInt4, storeInt4, _mm_or_si128(x, y), scalarOr)
+SSE2_KERNEL(sse2Select, __m128i, loadInt4, storeInt4,
+            _mm_or_si128(_mm_and_si128(y, x), _mm_andnot_si128(y, loadInt4(t + i))), scalarSelect)
+SSE2_KERNEL(sse2Copy, __m128i, loadInt4, storeInt4, x, scalarCopy)
+#endif
+
+#if defined(HAVE_AVX2_KERNELS)
+#define AVX2 __attribute__((target("avx2")))
+
+static inline AVX2 __m256i loadInt8(const int32_t* p) {
+    return _mm256_loadu_si256((const __m256i*)p);
+}
+
+static inline AVX2 __m256 loadFloat8(const int32_t* p) {
+    return _mm256_loadu_ps((const float*)p);
+}
+
+static inline AVX2 void storeInt8(int32_t* p, __m256i value) {
+    _mm256_storeu_si256((__m256i*)p, value);
+}
+
+static inline AVX2 void storeFloat8(int32_t* p, __m256 value) {
+    _mm256_storeu_ps((float*)p, value);
+}
+
+#define AVX2_KERNEL(name, vector, load, store, expression, tail) \
+    static AVX2 void name(void* target, const void* left, const void* right, int count) { \
+        int32_t* t = target; \
+        const int32_t* a = left; \
+        const int32_t* b = right; \
+        int i = 0; \
+        for (; i + 8 <= count; i += 8) { \
+            vector x = load(a + i); \
+            vector y = load(b + i); \
+            (void)y; \
+            store(t + i, expression); \
+        } \
+        tail(t + i, a + i, b + i, count - i); \
+    }
+
+AVX2_KERNEL(avx2AddInt, __m256i, loadInt8, storeInt8, _mm256_add_epi32(x, y), sse2AddInt)
+AVX2_KERNEL(avx2SubtractInt, __m256i, loadInt8, storeInt8, _mm256_sub_epi32(x, y), sse2SubtractInt)
+AVX2_KERNEL(avx2MultiplyInt, __m256i, loadInt8, storeInt8, _mm256_mullo_epi32(x, y), sse2MultiplyInt)
+AVX2_KERNEL(avx2NegateInt, __m256i, loadInt8, storeInt8, _mm256_sub_epi32(_mm256_setzero_si256(), x),
+            sse2NegateInt)
+AVX2_KERNEL(avx2AddFloat, __m256, loadFloat8, storeFloat8, _mm256_add_ps(x, y), sse2AddFloat)
+AVX2_KERNEL(avx2SubtractFloat, __m256, loadFloat8, storeFloat8, _mm256_sub_ps(x, y), sse2SubtractFloat)
+AVX2_KERNEL(avx2MultiplyFloat, __m256, loadFloat8, storeFloat8, _mm256_mul_ps(x, y), sse2MultiplyFloat)
+AVX2_KERNEL(avx2DivideFloat, __m256, loadFloat8, storeFloat8, _mm256_div_ps(x, y), sse2DivideFloat)
+AVX2_KERNEL(avx2NegateFloat, __m256, loadFloat8, storeFloat8, _mm256_xor_ps(x, _mm256_set1_ps(-0.0f)),
+            sse2NegateFloat)
+AVX2_KERNEL(avx2IntToFloat, __m256i, loadInt8, storeFloat8, _mm256_cvtepi32_ps(x), sse2IntToFloat)
+AVX2_KERNEL(avx2FloatToInt, __m256, loadFloat8, storeInt8, _mm256_cvttps_epi32(x), sse2FloatToInt)
+AVX2_KERNEL(avx2TestInt, __m256i, loadInt8, storeInt8,
+            _mm256_xor_si256(_mm256_cmpeq_epi32(x, _mm256_setzero_si256()), _mm256_set1_epi32(-1)), sse2TestInt)
+AVX2_KERNEL(avx2TestFloat, __m256, loadFloat8, storeInt8,
+            _mm256_castps_si256(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_NEQ_UQ)), sse2TestFloat)
+AVX2_KERNEL(avx2EqualInt, __m256i, loadInt8, storeInt8, _mm256_cmpeq_epi32(x, y), sse2EqualInt)
+AVX2_KERNEL(avx2NotEqualInt, __m256i, loadInt8, storeInt8,
+            _mm256_xor_si256(_mm256_cmpeq_epi32(x, y), _mm256_set1_epi32(-1)), sse2NotEqualInt)
+AVX2_KERNEL(avx2LessInt, __m256i, loadInt8, storeInt8, _mm256_cmpgt_epi32(y, x), sse2LessInt)
+AVX2_KERNEL(avx2LessEqualInt, __m256i, loadInt8, storeInt8,
+            _mm256_xor_si256(_mm256_cmpgt_epi32(x, y), _mm256_set1_epi32(-1)), sse2LessEqualInt)
+AVX2_KERNEL(avx2EqualFloat, __m256, loadFloat8, storeInt8, _mm256_castps_si256(_mm256_cmp_ps(x, y, _CMP_EQ_OQ)),
+            sse2EqualFloat)
+AVX2_KERNEL(avx2NotEqualFloat, __m256, loadFloat8, storeInt8, _mm256_castps_si256(_mm256_cmp_ps(x, y, _CMP_NEQ_UQ)),
+            sse2NotEqualFloat)
+AVX2_KERNEL(avx2LessFloat, __m256, loadFloat8, storeInt8, _mm256_castps_si256(_mm256_cmp_ps(x, y, _CMP_LT_OQ)),
+            sse2LessFloat)
+AVX2_KERNEL(avx2LessEqualFloat, __m256, loadFloat8, storeInt8, _mm256_castps_si256(_mm256_cmp_ps(x, y, _CMP_LE_OQ)),
+            sse2LessEqualFloat)
+AVX2_KERNEL(avx2And, __m256i, loadInt8, storeInt8, _mm256_and_si256(x, y), sse2And)
+AVX2_KERNEL(avx2AndNot, __m256i, loadInt8, storeInt8, _mm256_andnot_si256(y, x), sse2AndNot)
+AVX2_KERNEL(avx2Or, __m256i, loadInt8, storeInt8, _mm256_or_si256(x, y), sse2Or)
+AVX2_KERNEL(avx2Select, __m256i, loadInt8, storeInt8, _mm256_blendv_epi8(loadInt8(t + i), x, y), sse2Select)
+AVX2_KERNEL(avx2Copy, __m256i, loadInt8, storeInt8, x, sse2Copy)
+#endif
+
+static const ColumnKernel kernels[][COLUMN_KERNEL_COUNT] = {
+    [COLUMN_SCALAR] = {scalarAddInt, scalarSubtractInt, scalarMultiplyInt, scalarNegateInt, scalarAddFloat,
+                       scalarSubtractFloat, scalarMultiplyFloat, scalarDivideFloat, scalarNegateFloat,
+                       scalarIntToFloat, scalarFloatToInt, scalarTestInt, scalarTestFloat, scalarEqualInt,
+                       scalarNotEqualInt, scalarLessInt, scalarLessEqualInt, scalarEqualFloat, scalarNotEqualFloat,
+                       scalarLessFloat, scalarLessEqualFloat, scalarAnd, scalarAndNot, scalarOr, scalarSelect,
+                       scalarCopy},
+#if defined(__SSE2__)
+    [COLUMN_SSE2] = {sse2AddInt, sse2SubtractInt, sse2MultiplyInt, sse2NegateInt, sse2AddFloat, sse2SubtractFloat,
+                     sse2MultiplyFloat, sse2DivideFloat, sse2NegateFloat, sse2IntToFloat, sse2FloatToInt,
+                     sse2TestInt, sse2TestFloat, sse2EqualInt, sse2NotEqualInt, sse2LessInt, sse2LessEqualInt,
+                     sse2EqualFloat, sse2NotEqualFloat, sse2LessFloat, sse2LessEqualFloat, sse2And, sse2AndNot,
+                     sse2Or, sse2Select, sse2Copy},
+#endif
+#if defined(HAVE_AVX2_KERNELS)
+    [COLUMN_AVX2] = {avx2AddInt, avx2SubtractInt, avx2MultiplyInt, avx2NegateInt, avx2AddFloat, avx2SubtractFloat,
+                     avx2MultiplyFloat, avx2DivideFloat, avx2NegateFloat, avx2IntToFloat, avx2FloatToInt,
+                     avx2TestInt, avx2TestFloat, avx2EqualInt, avx2NotEqualInt, avx2LessInt, avx2LessEqualInt,
+                     avx2EqualFloat, avx2NotEqualFloat, avx2LessFloat, avx2LessEqualFloat, avx2And, avx2AndNot,
+                     avx2Or, avx2Select, avx2Copy},
+#endif
+};
+
+ColumnMode bestColumnMode(void) {
+#if defined(HAVE_AVX2_KERNELS)
+    if (__builtin_cpu_supports("avx2")) return COLUMN_AVX2;
+#endif
+#if defined(__SSE2__)
+    return COLUMN_SSE2;
+#else
+    return COLUMN_SCALAR;
+#endif
+}
+
+int columnModeSupported(ColumnMode mode) {
+    switch (mode) {
+        case COLUMN_SCALAR:
+            return 1;
+        case COLUMN_SSE2:
+#if defined(__SSE2__)
+            return 1;
+#else
+            return 0;
+#endif
+        case COLUMN_AVX2:
+#if defined(HAVE_AVX2_KERNELS)
+            return __builtin_cpu_supports("avx2");
+#else
+            return 0;
+#endif
+    }
+    return 0;
+}
+
+typedef struct {
+    ColumnProgram* program;
+    int step_capacity;
+    int constant_capacity;
+    int* variables;         // Column of each program variable, -1 until declared
+    char* assigned;         // Variables some assignment writes
+    char* temporary;        // Columns holding an intermediate value, by column
+    int* spare;             // Temporary columns no longer in use
+    int spare_count;
+    int all;                // Mask of every record
+    int live;               // Mask of the records that have not returned, or -1
+    int returns;            // Returns under a mask so far
+    const char* unsupported;
+} ColumnCompiler;
+
+static void unsupported(ColumnCompiler* compiler, const char* reason) {
+    if (compiler->unsupported == NULL) compiler->unsupported = reason;
+}
+
+static int addColumn(ColumnCompiler* compiler, int isTemporary) {
+    int column = compiler->program->column_count++;
+    compiler->temporary = realloc(compiler->temporary, compiler->program->column_count);
+    compiler->spare = realloc(compiler->spare, compiler->program->column_count * sizeof(int));
+    compiler->temporary[column] = (char)isTemporary;
+    return column;
+}
+
+// Intermediate values reuse columns freed by earlier ones, so a slice of
+// every column stays small enough for the cache.
+static int temporary(ColumnCompiler* compiler) {
+    if (compiler->spare_count > 0) return compiler->spare[--compiler->spare_count];
+    return addColumn(compiler, 1);
+}
+
+static void release(ColumnCompiler* compiler, int column) {
+    if (compiler->temporary[column]) compiler->spare[compiler->spare_count++] = column;
+}
+
+static int constant(ColumnCompiler* compiler, Value value) {
+    ColumnProgram* program = compiler->program;
+    for (int i = 0; i < program->constant_count; i++) {
+        ColumnConstant* existing = &program->constants[i];
+        if (existing->value.type == value.type && existing->value.as.int_value == value.as.int_value) {
+            return existing->column;
+        }
+    }
+    if (program->constant_count == compiler->constant_capacity) {
+        compiler->constant_capacity = compiler->constant_capacity < 8 ? 8 : compiler->constant_capacity * 2;
+        program->constants = realloc(program->constants, compiler->constant_capacity * sizeof(ColumnConstant));
+    }
+    int column = addColumn(compiler, 0);
+    program->constants[program->constant_count].column = column;
+    program->constants[program->constant_count].value = value;
+    program->constant_count++;
+    return column;
+}
+
+static int emit(ColumnCompiler* compiler, int op, int target, int left, int right) {
+    ColumnProgram* program = compiler->program;
+    if (program->step_count == compiler->step_capacity) {
+        compiler->step_capacity = compiler->step_capacity < 16 ? 16 : compiler->step_capacity * 2;
+        program->steps = realloc(program->steps, compiler->step_capacity * sizeof(ColumnStep));
+    }
+    ColumnStep* step = &program->steps[program->step_count];
+    step->op = op;
+    step->target = target;
+    step->left = left;
+    step->right = right;
+    step->mask = -1;
+    return program->step_count++;
+}
+
+// Stores value into a variable's column for the records in active, or for
+// every record if none are masked off.
+static void assign(ColumnCompiler* compiler, int variable, int value, int active, int masked) {
+    if (variable == value) return;
+    if (masked) {
+        emit(compiler, COLUMN_SELECT, variable, value, active);
+    } else {
+        emit(compiler, COLUMN_COPY, variable, value, value);
+    }
+}
+
+// The step for a typed operation, or -1 if there is none.
+static int stepFor(Operation operation) {
+    switch (operation) {
+        case OPERATION_ADD_INT: return COLUMN_ADD_INT;
+        case OPERATION_SUBTRACT_INT: return COLUMN_SUBTRACT_INT;
+        case OPERATION_MULTIPLY_INT: return COLUMN_MULTIPLY_INT;
+        case OPERATION_DIVIDE_INT: return COLUMN_DIVIDE_INT;
+        case OPERATION_NEGATE_INT: return COLUMN_NEGATE_INT;
+        case OPERATION_ADD_FLOAT: return COLUMN_ADD_FLOAT;
+        case OPERATION_SUBTRACT_FLOAT: return COLUMN_SUBTRACT_FLOAT;
+        case OPERATION_MULTIPLY_FLOAT: return COLUMN_MULTIPLY_FLOAT;
+        case OPERATION_DIVIDE_FLOAT: return COLUMN_DIVIDE_FLOAT;
+        case OPERATION_NEGATE_FLOAT: return COLUMN_NEGATE_FLOAT;
+        case OPERATION_INT_TO_FLOAT: return COLUMN_INT_TO_FLOAT;
+        case OPERATION_FLOAT_TO_INT: return COLUMN_FLOAT_TO_INT;
+        default: return -1;
+    }
+}
+
+// The comparison step for a comparison, with *swap set when it takes the
+// operands the other way round: a > b is b < a.
+static int compareStep(Operation operation, int* swap) {
+    *swap = 0;
+    switch (operation) {
+        case OPERATION_EQUAL_INT: return COLUMN_EQUAL_INT;
+        case OPERATION_NOT_EQUAL_INT: return COLUMN_NOT_EQUAL_INT;
+        case OPERATION_LESS_INT: return COLUMN_LESS_INT;
+        case OPERATION_LESS_EQUAL_INT: return COLUMN_LESS_EQUAL_INT;
+        case OPERATION_GREATER_INT: *swap = 1; return COLUMN_LESS_INT;
+        case OPERATION_GREATER_EQUAL_INT: *swap = 1; return COLUMN_LESS_EQUAL_INT;
+        case OPERATION_EQUAL_FLOAT: return COLUMN_EQUAL_FLOAT;
+        case OPERATION_NOT_EQUAL_FLOAT: return COLUMN_NOT_EQUAL_FLOAT;
+        case OPERATION_LESS_FLOAT: return COLUMN_LESS_FLOAT;
+        case OPERATION_LESS_EQUAL_FLOAT: return COLUMN_LESS_EQUAL_FLOAT;
+        case OPERATION_GREATER_FLOAT: *swap = 1; return COLUMN_LESS_FLOAT;
+        default: *swap = 1; return COLUMN_LESS_EQUAL_FLOAT;
+    }
+}
+
+static int isNot(Node* node) {
+    return node->type == NODE_UNARY &&
+           (node->operation == OPERATION_NOT_INT || node->operation == OPERATION_NOT_FLOAT);
+}
+
+// Whether the node is a comparison, logical operator or !, whose value is the
+// truth of a condition.
+static int isTruth(Node* node) {
+    return node->type == NODE_LOGICAL || isNot(node) || (node->type == NODE_BINARY && isComparison(node->operation));
+}
+
+static int expression(ColumnCompiler* compiler, Node* node, int active, int masked);
+
+// Returns a new temporary mask of the records for which the condition holds.
+// Comparisons produce their masks directly. The right operand of && and ||
+// only runs for the records in active that the left leaves undecided, and its
+// steps are skipped for a slice where there are none; a record outside
+// active may get any value.
+static int condition(ColumnCompiler* compiler, Node* node, int active, int masked) {
+    ColumnProgram* program = compiler->program;
+    int target;
+    if (node->type == NODE_LOGICAL) {
+        int isAnd = node->operation == OPERATION_AND;
+        int left = condition(compiler, node->as.binary.left, active, masked);
+        int undecided = temporary(compiler);
+        if (isAnd) {
+            emit(compiler, COLUMN_AND, undecided, left, active);
+        } else {
+            emit(compiler, COLUMN_AND_NOT, undecided, active, left);
+        }
+        int skip = emit(compiler, COLUMN_SKIP_IF_NONE, 0, undecided, undecided);
+        int right = condition(compiler, node->as.binary.right, undecided, 1);
+        program->steps[skip].target = program->step_count;
+        release(compiler, undecided);
+        release(compiler, left);
+        release(compiler, right);
+        target = temporary(compiler);
+        emit(compiler, isAnd ? COLUMN_AND : COLUMN_OR, target, left, right);
+    } else if (isNot(node)) {
+        int operand = condition(compiler, node->as.unary.operand, active, masked);
+        release(compiler, operand);
+        target = temporary(compiler);
+        emit(compiler, COLUMN_AND_NOT, target, compiler->all, operand);
+    } else if (node->type == NODE_BINARY && isComparison(node->operation)) {
+        int swap;
+        int op = compareStep(node->operation, &swap);
+        int left = expression(compiler, node->as.binary.left, active, masked);
+        int right = expression(compiler, node->as.binary.right, active, masked);
+        release(compiler, left);
+        if (right != left) release(compiler, right);
+        target = temporary(compiler);
+        emit(compiler, op, target, swap ? right : left, swap ? left : right);
+    } else {
+        int value = expression(compiler, node, active, masked);
+        release(compiler, value);
+        target = temporary(compiler);
+        emit(compiler, node->value_type == VALUE_FLOAT ? COLUMN_TEST_FLOAT : COLUMN_TEST_INT, target, value, value);
+    }
+    return target;
+}
+
+// Every record computes every expression, so only integer division, which
+// can fail, and the right operands of && and || look at which records are
+// active.
+static int expression(ColumnCompiler* compiler, Node* node, int active, int masked) {
+    if (isTruth(node)) {
+        // Masks are all ones for true, and a truth value is 1.
+        int mask = condition(compiler, node, active, masked);
+        release(compiler, mask);
+        int target = temporary(compiler);
+        emit(compiler, COLUMN_AND, target, mask, constant(compiler, (Value){VALUE_INT, {.int_value = 1}}));
+        return target;
+    }
+    switch (node->type) {
+        case NODE_LITERAL:
+            return constant(compiler, node->as.literal.value);
+        case NODE_IDENTIFIER:
+            return compiler->variables[node->as.identifier.variable];
+        case NODE_BINARY:
+        case NODE_UNARY:
+        case NODE_CONVERT: {
+            int op = stepFor(node->operation);
+            int left = expression(compiler, node->type == NODE_BINARY ? node->as.binary.left : node->as.unary.operand,
+                                  active, masked);
+            int right = node->type == NODE_BINARY ? expression(compiler, node->as.binary.right, active, masked) : left;
+            if (op == -1) unsupported(compiler, "an operator has no column kernel");
+            release(compiler, left);
+            if (right != left) release(compiler, right);
+            int target = temporary(compiler);
+            int step = emit(compiler, op, target, left, right);
+            compiler->program->steps[step].mask = active;
+            return target;
+        }
+        case NODE_ASSIGNMENT: {
+            int value = expression(compiler, node->as.assignment.right, active, masked);
+            int variable = compiler->variables[node->as.assignment.left->as.identifier.variable];
+            assign(compiler, variable, value, active, masked);
+            release(compiler, value);
+            return variable;
+        }
+        case NODE_CALL:
+            unsupported(compiler, "function calls cannot run over columns");
+            return compiler->all;
+        default:
+            unsupported(compiler, "an expression cannot run over columns");
+            return compiler->all;
+    }
+}
+
+// Returns 1 if every record in active has returned by the end of node.
+static int statement(ColumnCompiler* compiler, Node* node, int active, int masked) {
+    ColumnProgram* program = compiler->program;
+    switch (node->type) {
+        case NODE_VARIABLE_DECLARATION: {
+            int variable = node->as.variable_declaration.identifier->as.identifier.variable;
+            Node* initializer = node->as.variable_declaration.initializer;
+            int input = node->as.variable_declaration.input;
+            int value;
+            if (input != -1) {
+                // An input nothing assigns is read straight from the host's column.
+                if (!compiler->assigned[variable]) {
+                    compiler->variables[variable] = input;
+                    return 0;
+                }
+                value = input;
+            } else if (initializer != NULL) {
+                value = expression(compiler, initializer, active, masked);
+                if (compiler->temporary[value]) {
+                    compiler->temporary[value] = 0;
+                    compiler->variables[variable] = value;
+                    return 0;
+                }
+            } else {
+                Value zero = {node->as.variable_declaration.type->value_type, {0}};
+                value = constant(compiler, zero);
+            }
+            // A declaration's scope only runs for the records in active, so
+            // the other records' values are never read.
+            compiler->variables[variable] = addColumn(compiler, 0);
+            assign(compiler, compiler->variables[variable], value, active, 0);
+            return 0;
+        }
+        case NODE_FUNCTION_DECLARATION:
+            return 0;
+        case NODE_EXPRESSION_STATEMENT:
+            release(compiler, expression(compiler, node->as.expression_statement.expression, active, masked));
+            return 0;
+        case NODE_BLOCK:
+            for (int i = 0; i < node->as.block.statement_count; i++) {
+                if (statement(compiler, node->as.block.statements[i], active, masked)) return 1;
+            }
+            return 0;
+        case NODE_IF_STATEMENT: {
+            Node* test = node->as.if_statement.condition;
+            Node* elseBranch = node->as.if_statement.else_branch;
+            int truth = condition(compiler, test, active, masked);
+            int thenMask = temporary(compiler);
+            emit(compiler, COLUMN_AND, thenMask, truth, active);
+            int elseMask = -1;
+            if (elseBranch != NULL) {
+                elseMask = temporary(compiler);
+                emit(compiler, COLUMN_AND_NOT, elseMask, active, truth);
+            }
+            release(compiler, truth);
+
+            int returns = compiler->returns;
+            int skip = emit(compiler, COLUMN_SKIP_IF_NONE, 0, thenMask, thenMask);
+            int ended = statement(compiler, node->as.if_statement.then_branch, thenMask, 1);
+            program->steps[skip].target = program->step_count;
+            if (elseBranch != NULL) {
+                skip = emit(compiler, COLUMN_SKIP_IF_NONE, 0, elseMask, elseMask);
+                ended &= statement(compiler, elseBranch, elseMask, 1);
+                program->steps[skip].target = program->step_count;
+                release(compiler, elseMask);
+            } else {
+                ended = 0;
+            }
+            release(compiler, thenMask);
+
+            // Records that returned in a branch must not fail a division
+            // after it.
+            if (compiler->returns != returns && active != compiler->live) {
+                emit(compiler, COLUMN_AND, active, active, compiler->live);
+            }
+            return ended;
+        }
+        case NODE_RETURN_STATEMENT: {
+            Node* value = node->as.return_statement.expression;
+            if (value == NULL) {
+                unsupported(compiler, "a return without a value cannot fill a result column");
+                return 1;
+            }
+            if (program->result_type == VALUE_VOID) {
+                program->result_type = value->value_type;
+            } else if (program->result_type != value->value_type) {
+                unsupported(compiler, "returns of different types cannot fill one result column");
+            }
+            int column = expression(compiler, value, active, masked);
+            int result = program->input_count;
+            if (masked) {
+                emit(compiler, COLUMN_SELECT, result, column, active);
+                emit(compiler, COLUMN_AND_NOT, compiler->live, compiler->live, active);
+                compiler->returns++;
+            } else if (compiler->live != -1) {
+                emit(compiler, COLUMN_SELECT, result, column, compiler->live);
+            } else {
+                emit(compiler, COLUMN_COPY, result, column, column);
+            }
+            release(compiler, column);
+            return 1;
+        }
+        case NODE_WHILE_STATEMENT:
+            unsupported(compiler, "loops cannot run over columns");
+            return 0;
+        default:
+            unsupported(compiler, "a statement cannot run over columns");
+            return 0;
+    }
+}
+
+// Marks every variable an assignment writes, and returns whether a return
+// runs under an if.
+static int scan(ColumnCompiler* compiler, Node* node, int conditional) {
+    if (node == NULL) return 0;
+    switch (node->type) {
+        case NODE_BLOCK: {
+            int found = 0;
+            for (int i = 0; i < node->as.block.statement_count; i++) {
+                found |= scan(compiler, node->as.block.statements[i], conditional);
+            }
+            return found;
+        }
+        case NODE_IF_STATEMENT:
+            scan(compiler, node->as.if_statement.condition, conditional);
+            return scan(compiler, node->as.if_statement.then_branch, 1) |
+                   scan(compiler, node->as.if_statement.else_branch, 1);
+        case NODE_WHILE_STATEMENT:
+            scan(compiler, node->as.while_statement.condition, 1);
+            return scan(compiler, node->as.while_statement.body, 1);
+        case NODE_RETURN_STATEMENT:
+            scan(compiler, node->as.return_statement.expression, conditional);
+            return conditional;
+        case NODE_VARIABLE_DECLARATION:
+            return scan(compiler, node->as.variable_declaration.initializer, conditional);
+        case NODE_EXPRESSION_STATEMENT:
+            return scan(compiler, node->as.expression_statement.expression, conditional);
+        case NODE_BINARY:
+        case NODE_LOGICAL:
+            return scan(compiler, node->as.binary.left, conditional) |
+                   scan(compiler, node->as.binary.right, conditional);
+        case NODE_UNARY:
+        case NODE_CONVERT:
+            return scan(compiler, node->as.unary.operand, conditional);
+        case NODE_ASSIGNMENT:
+            compiler->assigned[node->as.assignment.left->as.identifier.variable] = 1;
+            return scan(compiler, node->as.assignment.right, conditional);
+        default:
+            return 0;
+    }
+}
+
+int compileColumns(Node* program, ColumnProgram* columns, const char** reason) {
+    memset(columns, 0, sizeof(ColumnProgram));
+    columns->input_count = program->as.program.input_count;
+    columns->column_count = columns->input_count + 1;
+    columns->result_type = VALUE_VOID;
+
+    ColumnCompiler compiler;
+    memset(&compiler, 0, sizeof(compiler));
+    compiler.program = columns;
+    int variableCount = program->as.program.variable_count;
+    compiler.variables = malloc((variableCount > 0 ? variableCount : 1) * sizeof(int));
+    compiler.assigned = calloc(variableCount > 0 ? variableCount : 1, 1);
+    compiler.temporary = calloc(columns->column_count, 1);
+    compiler.spare = malloc(columns->column_count * sizeof(int));
+    for (int i = 0; i < variableCount; i++) compiler.variables[i] = -1;
+
+    int conditionalReturns = 0;
+    for (int i = 0; i < program->as.program.declaration_count; i++) {
+        Node* declaration = program->as.program.declarations[i];
+        if (declaration->type == NODE_FUNCTION_DECLARATION) continue;
+        conditionalReturns |= scan(&compiler, declaration, 0);
+    }
+    compiler.all = constant(&compiler, (Value){VALUE_INT, {.int_value = -1}});
+    compiler.live = -1;
+    if (conditionalReturns) {
+        compiler.live = addColumn(&compiler, 0);
+        emit(&compiler, COLUMN_COPY, compiler.live, compiler.all, compiler.all);
+    }
+
+    int active = compiler.live != -1 ? compiler.live : compiler.all;
+    int ended = 0;
+    for (int i = 0; i < program->as.program.declaration_count && !ended; i++) {
+        ended = statement(&compiler, program->as.program.declarations[i], active, 0);
+    }
+    if (!ended) unsupported(&compiler, "the program can finish without returning a value");
+
+    free(compiler.variables);
+    free(compiler.assigned);
+    free(compiler.temporary);
+    free(compiler.spare);
+    *reason = compiler.unsupported;
+    if (compiler.unsupported != NULL) {
+        freeColumns(columns);
+        return 0;
+    }
+    return 1;
+}
+
+// Checks only the records in mask, so one that returned or took the other
+// branch cannot fail; the others get 0.
+static const char* divideInt(int32_t* target, const int32_t* left, const int32_t* right, const int32_t* mask,
+                             int count) {
+    for (int i = 0; i < count; i++) {
+        if (!mask[i]) {
+            target[i] = 0;
+            continue;
+        }
+        if (right[i] == 0) return "Division by zero.";
+        if (right[i] == -1 && left[i] == INT_MIN) return "Integer overflow.";
+        target[i] = left[i] / right[i];
+    }
+    return NULL;
+}
+
+static int anySet(const int32_t* mask, int count) {
+    int32_t any = 0;
+    for (int i = 0; i < count; i++) any |= mask[i];
+    return any != 0;
+}
+
+const char* runColumns(const ColumnProgram* program, ColumnMode mode, const void* const* inputs, long count,
+                       void* results) {
+    const ColumnKernel* kernel = kernels[mode];
+    int first = program->input_count + 1;
+    int32_t* storage = malloc(((size_t)program->column_count - first + 1) * COLUMN_LANES * sizeof(int32_t));
+    int32_t** columns = malloc(program->column_count * sizeof(int32_t*));
+    for (int i = first; i < program->column_count; i++) {
+        columns[i] = storage + (size_t)(i - first) * COLUMN_LANES;
+    }
+    for (int i = 0; i < program->constant_count; i++) {
+        int32_t* column = columns[program->constants[i].column];
+        for (int lane = 0; lane < COLUMN_LANES; lane++) column[lane] = program->constants[i].value.as.int_value;
+    }
+
+    const char* error = NULL;
+    for (long start = 0; start < count && error == NULL; start += COLUMN_LANES) {
+        int lanes = count - start < COLUMN_LANES ? (int)(count - start) : COLUMN_LANES;
+        // Kernels never write input columns.
+        for (int i = 0; i < program->input_count; i++) columns[i] = (int32_t*)inputs[i] + start;
+        columns[program->input_count] = (int32_t*)results + start;
+
+        for (int i = 0; i < program->step_count && error == NULL; i++) {
+            const ColumnStep* step = &program->steps[i];
+            if (step->op < COLUMN_KERNEL_COUNT) {
+                kernel[step->op](columns[step->target], columns[step->left], columns[step->right], lanes);
+            } else if (step->op == COLUMN_DIVIDE_INT) {
+                error = divideInt(columns[step->target], columns[step->left], columns[step->right],
+                                  columns[step->mask], lanes);
+            } else if (!anySet(columns[step->left], lanes)) {
+                i = step->target - 1;
+            }
+        }
+    }
+
+    free(columns);
+    free(storage);
+    return error;
+}
+
+void freeColumns(ColumnProgram* columns) {
+    free(columns->steps);
+    free(columns->constants);
+    columns->steps = NULL;
+    columns->constants = NULL;
+    columns->step_count = 0;
+    columns->constant_count = 0;
+}
@@ -0,0 +1,62 @@
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include "parser.h"
+
+// Records are evaluated this many at a time, each variable and intermediate
+// result holding one value per record in a column of this length.
+#define COLUMN_LANES 1024
+
+// How the kernels step through a column.
+typedef enum {
+    COLUMN_SCALAR,      // One record at a time
+    COLUMN_SSE2,        // 4 records at a time
+    COLUMN_AVX2         // 8 records at a time
+} ColumnMode;
+
+// One kernel call over every record of a slice. The operands are column
+// numbers: the program's inputs come first, then its result, then columns
+// the steps keep constants, variables and intermediate values in.
+typedef struct {
+    int op;
+    int target;
+    int left;
+    int right;
+    int mask;           // Records a division must check, for COLUMN_DIVIDE_INT
+} ColumnStep;
+
+typedef struct {
+    int column;
+    Value value;
+} ColumnConstant;
+
+typedef struct {
+    ColumnStep* steps;
+    int step_count;
+    ColumnConstant* constants;
+    int constant_count;
+    int column_count;
+    int input_count;
+    ValueType result_type;
+} ColumnProgram;
+
+ColumnMode bestColumnMode(void);
+// Whether this build and CPU can run kernels in mode.
+int columnModeSupported(ColumnMode mode);
+
+// Translates a resolved, type-checked program into steps that run it over
+// many records at once, with ifs running both branches under a mask of the
+// records that take each one. Returns 0 if the program uses something that
+// cannot run that way, with *reason saying what: loops, calls, or a path
+// that does not return a value.
+int compileColumns(Node* program, ColumnProgram* columns, const char** reason);
+
+// Runs the program once for each of count records. inputs[i] holds count
+// values of input i's declared type, as int or float, and results receives
+// count values of the program's result type. Returns NULL, or a runtime
+// error message, in which case results is partly written.
+const char* runColumns(const ColumnProgram* columns, ColumnMode mode, const void* const* inputs, long count,
+                       void* results);
+void freeColumns(ColumnProgram* columns);
+
+#endif
@@ -0,0 +1,520 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compiler.h"
+
+typedef struct {
+    Chunk* chunk;
+    int local_count;
+    int reserved;           // Frame slots that exist before the code runs; 0 in functions
+    int stack_depth;        // Values above the frame base at this point
+    int max_depth;          // Highest stack_depth in the code being compiled
+    int hadError;
+    FILE* errors;
+} Compiler;
+
+static void errorAt(Compiler* compiler, Token* token, const char* message) {
+    fprintf(compiler->errors, "[line %d] Error at '%.*s': %s\n", token->line, token->length, token->lexeme, message);
+    compiler->hadError = 1;
+}
+
+static void emitByte(Compiler* compiler, uint8_t byte) {
+    writeChunk(compiler->chunk, byte);
+}
+
+static void emitShort(Compiler* compiler, int value) {
+    emitByte(compiler, (value >> 8) & 0xff);
+    emitByte(compiler, value & 0xff);
+}
+
+// Tracks the operand stack height so the VM can check each frame's stack
+// needs once, when the frame is entered.
+static void adjustStack(Compiler* compiler, int effect) {
+    compiler->stack_depth += effect;
+    if (compiler->stack_depth > compiler->max_depth) {
+        compiler->max_depth = compiler->stack_depth;
+    }
+}
+
+static void emitOp(Compiler* compiler, OpCode op, int effect) {
+    emitByte(compiler, op);
+    adjustStack(compiler, effect);
+}
+
+static void emitOpShort(Compiler* compiler, OpCode op, int operand, int effect) {
+    emitOp(compiler, op, effect);
+    emitShort(compiler, operand);
+}
+
+static int makeConstant(Compiler* compiler, Node* node, Value value) {
+    int index = addConstant(compiler->chunk, value);
+    if (index > UINT16_MAX) {
+        errorAt(compiler, &node->token, "Too many constants in one program.");
+        return 0;
+    }
+    return index;
+}
+
+static void emitConstant(Compiler* compiler, Node* node, Value value) {
+    emitOpShort(compiler, OP_CONSTANT, makeConstant(compiler, node, value), 1);
+}
+
+static int emitJump(Compiler* compiler, OpCode op, int effect) {
+    emitOpShort(compiler, op, 0xffff, effect);
+    return compiler->chunk->count - 2;
+}
+
+static void patchJump(Compiler* compiler, Node* node, int offset) {
+    int jump = compiler->chunk->count - offset - 2;
+    if (jump > UINT16_MAX) {
+        errorAt(compiler, &node->token, "Too much code to jump over.");
+        return;
+    }
+    compiler->chunk->code[offset] = (jump >> 8) & 0xff;
+    compiler->chunk->code[offset + 1] = jump & 0xff;
+}
+
+// Jumps still to be patched to one target, from a condition that can leave
+// from several places.
+typedef struct {
+    int* offsets;
+    int count;
+    int capacity;
+} JumpList;
+
+static void addJump(JumpList* jumps, int offset) {
+    if (jumps->count == jumps->capacity) {
+        jumps->capacity = jumps->capacity < 4 ? 4 : jumps->capacity * 2;
+        jumps->offsets = realloc(jumps->offsets, jumps->capacity * sizeof(int));
+    }
+    jumps->offsets[jumps->count++] = offset;
+}
+
+static void patchJumps(Compiler* compiler, Node* node, JumpList* jumps) {
+    for (int i = 0; i < jumps->count; i++) patchJump(compiler, node, jumps->offsets[i]);
+    free(jumps->offsets);
+    jumps->offsets = NULL;
+    jumps->count = 0;
+    jumps->capacity = 0;
+}
+
+static void emitLoop(Compiler* compiler, Node* node, int loopStart) {
+    emitOp(compiler, OP_LOOP, 0);
+    int offset = compiler->chunk->count - loopStart + 2;
+    if (offset > UINT16_MAX) {
+        errorAt(compiler, &node->token, "Loop body too large.");
+        return;
+    }
+    emitShort(compiler, offset);
+}
+
+// Locals sit at the bottom of their frame in declaration order, so a
+// variable's frame slot is also its stack index relative to the frame base.
+static int localSlot(Node* identifier) {
+    return identifier->as.identifier.slot;
+}
+
+static OpCode getOp(Node* identifier) {
+    return identifier->as.identifier.global ? OP_GET_GLOBAL : OP_GET_LOCAL;
+}
+
+static OpCode setOp(Node* identifier) {
+    return identifier->as.identifier.global ? OP_SET_GLOBAL : OP_SET_LOCAL;
+}
+
+static void endScope(Compiler* compiler, Node* block) {
+    int popped = block->as.block.local_count;
+    compiler->local_count -= popped;
+    // Reserved slots are reused by later declarations rather than popped.
+    if (compiler->reserved > 0) return;
+    if (popped == 1) {
+        emitOp(compiler, OP_POP, -1);
+    } else if (popped > 1) {
+        emitOpShort(compiler, OP_POPN, popped, -popped);
+    }
+}
+
+static Value defaultValue(Node* type) {
+    return (Value){type->value_type, {0}};
+}
+
+static OpCode operationOp(Operation operation) {
+    switch (operation) {
+        case OPERATION_ADD_INT:             return OP_ADD_INT;
+        case OPERATION_SUBTRACT_INT:        return OP_SUBTRACT_INT;
+        case OPERATION_MULTIPLY_INT:        return OP_MULTIPLY_INT;
+        case OPERATION_DIVIDE_INT:          return OP_DIVIDE_INT;
+        case OPERATION_NEGATE_INT:          return OP_NEGATE_INT;
+        case OPERATION_ADD_FLOAT:           return OP_ADD_FLOAT;
+        case OPERATION_SUBTRACT_FLOAT:      return OP_SUBTRACT_FLOAT;
+        case OPERATION_MULTIPLY_FLOAT:      return OP_MULTIPLY_FLOAT;
+        case OPERATION_DIVIDE_FLOAT:        return OP_DIVIDE_FLOAT;
+        case OPERATION_NEGATE_FLOAT:        return OP_NEGATE_FLOAT;
+        case OPERATION_INT_TO_FLOAT:        return OP_INT_TO_FLOAT;
+        case OPERATION_EQUAL_INT:           return OP_EQUAL_INT;
+        case OPERATION_NOT_EQUAL_INT:       return OP_NOT_EQUAL_INT;
+        case OPERATION_LESS_INT:            return OP_LESS_INT;
+        case OPERATION_LESS_EQUAL_INT:      return OP_LESS_EQUAL_INT;
+        case OPERATION_GREATER_INT:         return OP_GREATER_INT;
+        case OPERATION_GREATER_EQUAL_INT:   return OP_GREATER_EQUAL_INT;
+        case OPERATION_EQUAL_FLOAT:         return OP_EQUAL_FLOAT;
+        case OPERATION_NOT_EQUAL_FLOAT:     return OP_NOT_EQUAL_FLOAT;
+        case OPERATION_LESS_FLOAT:          return OP_LESS_FLOAT;
+        case OPERATION_LESS_EQUAL_FLOAT:    return OP_LESS_EQUAL_FLOAT;
+        case OPERATION_GREATER_FLOAT:       return OP_GREATER_FLOAT;
+        case OPERATION_GREATER_EQUAL_FLOAT: return OP_GREATER_EQUAL_FLOAT;
+        case OPERATION_NOT_INT:             return OP_NOT_INT;
+        case OPERATION_NOT_FLOAT:           return OP_NOT_FLOAT;
+        default:                            return OP_FLOAT_TO_INT;
+    }
+}
+
+// The compare-and-branch instructions are in the same order as the
+// comparison operations.
+static OpCode jumpUnlessOp(Operation comparison) {
+    return (OpCode)(OP_JUMP_UNLESS_EQUAL_INT + (comparison - OPERATION_EQUAL_INT));
+}
+
+// The comparison that holds exactly when this one does not, or
+// OPERATION_NONE for a float ordering, which NaN makes false both ways.
+static Operation negatedComparison(Operation comparison) {
+    switch (comparison) {
+        case OPERATION_EQUAL_INT:           return OPERATION_NOT_EQUAL_INT;
+        case OPERATION_NOT_EQUAL_INT:       return OPERATION_EQUAL_INT;
+        case OPERATION_LESS_INT:            return OPERATION_GREATER_EQUAL_INT;
+        case OPERATION_LESS_EQUAL_INT:      return OPERATION_GREATER_INT;
+        case OPERATION_GREATER_INT:         return OPERATION_LESS_EQUAL_INT;
+        case OPERATION_GREATER_EQUAL_INT:   return OPERATION_LESS_INT;
+        case OPERATION_EQUAL_FLOAT:         return OPERATION_NOT_EQUAL_FLOAT;
+        case OPERATION_NOT_EQUAL_FLOAT:     return OPERATION_EQUAL_FLOAT;
+        default:                            return OPERATION_NONE;
+    }
+}
+
+static void expression(Compiler* compiler, Node* node);
+static void statement(Compiler* compiler, Node* node);
+
+static int isIntLocal(Node* node) {
+    return node->type == NODE_IDENTIFIER && !node->as.identifier.global && node->value_type == VALUE_INT;
+}
+
+static int isIntLiteral(Node* node) {
+    return node->type == NODE_LITERAL && node->value_type == VALUE_INT;
+}
+
+// Compiles a condition into jumps to one target, taken when the condition is
+// true if sense is set and when it is false otherwise; the other case falls
+// through. A comparison branches on its operands and && || ! become jumps
+// around the tests of their operands, so no truth value is ever pushed.
+// Anything else is tested by its static type, an int local in place.
+static void jumpIf(Compiler* compiler, Node* condition, int sense, JumpList* jumps) {
+    switch (condition->type) {
+        case NODE_LOGICAL: {
+            // The left operand alone decides && when false and || when true.
+            int decided = condition->operation == OPERATION_OR;
+            if (decided == sense) {
+                jumpIf(compiler, condition->as.binary.left, sense, jumps);
+                jumpIf(compiler, condition->as.binary.right, sense, jumps);
+            } else {
+                JumpList skip = {NULL, 0, 0};
+                jumpIf(compiler, condition->as.binary.left, decided, &skip);
+                jumpIf(compiler, condition->as.binary.right, sense, jumps);
+                patchJumps(compiler, condition, &skip);
+            }
+            return;
+        }
+        case NODE_UNARY:
+            if (condition->operation == OPERATION_NOT_INT || condition->operation == OPERATION_NOT_FLOAT) {
+                jumpIf(compiler, condition->as.unary.operand, !sense, jumps);
+                return;
+            }
+            break;
+        case NODE_BINARY: {
+            if (!isComparison(condition->operation)) break;
+            Operation comparison = sense ? negatedComparison(condition->operation) : condition->operation;
+            expression(compiler, condition->as.binary.left);
+            expression(compiler, condition->as.binary.right);
+            if (comparison != OPERATION_NONE) {
+                addJump(jumps, emitJump(compiler, jumpUnlessOp(comparison), -2));
+                return;
+            }
+            int skip = emitJump(compiler, jumpUnlessOp(condition->operation), -2);
+            addJump(jumps, emitJump(compiler, OP_JUMP, 0));
+            patchJump(compiler, condition, skip);
+            return;
+        }
+        case NODE_IDENTIFIER:
+            if (!sense && isIntLocal(condition)) {
+                emitOpShort(compiler, OP_JUMP_IF_LOCAL_FALSE, localSlot(condition), 0);
+                emitShort(compiler, 0xffff);
+                addJump(jumps, compiler->chunk->count - 2);
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+    expression(compiler, condition);
+    OpCode op;
+    if (condition->value_type == VALUE_FLOAT) {
+        op = sense ? OP_JUMP_IF_TRUE_FLOAT : OP_JUMP_IF_FALSE_FLOAT;
+    } else {
+        op = sense ? OP_JUMP_IF_TRUE : OP_JUMP_IF_FALSE;
+    }
+    addJump(jumps, emitJump(compiler, op, -1));
+}
+
+// Compiles int local op int constant as one superinstruction. Returns 0 if
+// the node does not have that shape.
+static int localConstant(Compiler* compiler, Node* node) {
+    Node* left = node->as.binary.left;
+    Node* right = node->as.binary.right;
+    if (!isIntLocal(left) || !isIntLiteral(right)) return 0;
+    OpCode op;
+    switch (node->operation) {
+        case OPERATION_ADD_INT:      op = OP_ADD_LOCAL_CONSTANT; break;
+        case OPERATION_SUBTRACT_INT: op = OP_SUBTRACT_LOCAL_CONSTANT; break;
+        case OPERATION_MULTIPLY_INT: op = OP_MULTIPLY_LOCAL_CONSTANT; break;
+        case OPERATION_DIVIDE_INT:
+            // Dividing by these can fail, which OP_DIVIDE_INT checks for.
+            if (right->as.literal.value.as.int_value == 0 || right->as.literal.value.as.int_value == -1) return 0;
+            op = OP_DIVIDE_LOCAL_CONSTANT;
+            break;
+        default:                     return 0;
+    }
+    emitOpShort(compiler, op, localSlot(left), 1);
+    emitShort(compiler, makeConstant(compiler, right, right->as.literal.value));
+    return 1;
+}
+
+// Compiles the statement x = x + c or x = x - c on an int local as one
+// in-place increment. Returns 0 if the expression does not have that shape.
+static int incrementLocal(Compiler* compiler, Node* node) {
+    if (node->type != NODE_ASSIGNMENT || !isIntLocal(node->as.assignment.left)) return 0;
+    Node* value = node->as.assignment.right;
+    if (value->type != NODE_BINARY || value->as.binary.left->type != NODE_IDENTIFIER ||
+        value->as.binary.left->as.identifier.variable != node->as.assignment.left->as.identifier.variable ||
+        !isIntLiteral(value->as.binary.right)) {
+        return 0;
+    }
+    Value step = value->as.binary.right->as.literal.value;
+    if (value->operation == OPERATION_SUBTRACT_INT) {
+        step.as.int_value = (int)(0u - (unsigned int)step.as.int_value);
+    } else if (value->operation != OPERATION_ADD_INT) {
+        return 0;
+    }
+    emitOpShort(compiler, OP_INCREMENT_LOCAL, localSlot(node->as.assignment.left), 0);
+    emitShort(compiler, makeConstant(compiler, value, step));
+    return 1;
+}
+
+static void expression(Compiler* compiler, Node* node) {
+    switch (node->type) {
+        case NODE_BINARY:
+            if (localConstant(compiler, node)) break;
+            expression(compiler, node->as.binary.left);
+            expression(compiler, node->as.binary.right);
+            emitOp(compiler, operationOp(node->operation), -1);
+            break;
+        case NODE_UNARY:
+        case NODE_CONVERT:
+            expression(compiler, node->as.unary.operand);
+            emitOp(compiler, operationOp(node->operation), 0);
+            break;
+        case NODE_LOGICAL: {
+            // Only one of the two constants is pushed, whichever way it goes.
+            JumpList falseJumps = {NULL, 0, 0};
+            jumpIf(compiler, node, 0, &falseJumps);
+            emitConstant(compiler, node, (Value){VALUE_INT, {.int_value = 1}});
+            int endJump = emitJump(compiler, OP_JUMP, 0);
+            patchJumps(compiler, node, &falseJumps);
+            adjustStack(compiler, -1);
+            emitConstant(compiler, node, (Value){VALUE_INT, {.int_value = 0}});
+            patchJump(compiler, node, endJump);
+            break;
+        }
+        case NODE_LITERAL:
+            emitConstant(compiler, node, node->as.literal.value);
+            break;
+        case NODE_IDENTIFIER:
+            emitOpShort(compiler, getOp(node), localSlot(node), 1);
+            break;
+        case NODE_ASSIGNMENT: {
+            expression(compiler, node->as.assignment.right);
+            Node* target = node->as.assignment.left;
+            emitOpShort(compiler, setOp(target), localSlot(target), 0);
+            break;
+        }
+        case NODE_CALL: {
+            int count = node->as.call.argument_count;
+            for (int i = 0; i < count; i++) {
+                expression(compiler, node->as.call.arguments[i]);
+            }
+            int function = node->as.call.function->as.function_declaration.index;
+            if (node->as.call.tail) {
+                // Never falls through: the callee's OP_RETURN leaves this frame.
+                emitOpShort(compiler, OP_TAIL_CALL, function, -count);
+            } else {
+                emitOpShort(compiler, OP_CALL, function, 1 - count);
+            }
+            break;
+        }
+        default:
+            errorAt(compiler, &node->token, "Unknown node type in expression.");
+            break;
+    }
+}
+
+static void statement(Compiler* compiler, Node* node) {
+    switch (node->type) {
+        case NODE_EXPRESSION_STATEMENT:
+            if (incrementLocal(compiler, node->as.expression_statement.expression)) break;
+            expression(compiler, node->as.expression_statement.expression);
+            emitOp(compiler, OP_POP, -1);
+            break;
+        case NODE_VARIABLE_DECLARATION: {
+            Node* initializer = node->as.variable_declaration.initializer;
+            if (node->as.variable_declaration.input != -1) {
+                emitOpShort(compiler, OP_INPUT, node->as.variable_declaration.input, 1);
+            } else if (initializer != NULL) {
+                expression(compiler, initializer);
+            } else {
+                emitConstant(compiler, node->as.variable_declaration.identifier,
+                             defaultValue(node->as.variable_declaration.type));
+            }
+            if (compiler->local_count == UINT16_MAX) {
+                errorAt(compiler, &node->as.variable_declaration.identifier->token, "Too many variables in one program.");
+            }
+            if (compiler->reserved > 0) {
+                emitOpShort(compiler, OP_SET_LOCAL, localSlot(node->as.variable_declaration.identifier), 0);
+                emitOp(compiler, OP_POP, -1);
+            }
+            compiler->local_count++;
+            break;
+        }
+        case NODE_IF_STATEMENT: {
+            JumpList thenJumps = {NULL, 0, 0};
+            jumpIf(compiler, node->as.if_statement.condition, 0, &thenJumps);
+            statement(compiler, node->as.if_statement.then_branch);
+            if (node->as.if_statement.else_branch != NULL) {
+                int elseJump = emitJump(compiler, OP_JUMP, 0);
+                patchJumps(compiler, node->as.if_statement.condition, &thenJumps);
+                statement(compiler, node->as.if_statement.else_branch);
+                patchJump(compiler, node->as.if_statement.condition, elseJump);
+            } else {
+                patchJumps(compiler, node->as.if_statement.condition, &thenJumps);
+            }
+            break;
+        }
+        case NODE_WHILE_STATEMENT: {
+            int loopStart = compiler->chunk->count;
+            JumpList exitJumps = {NULL, 0, 0};
+            jumpIf(compiler, node->as.while_statement.condition, 0, &exitJumps);
+            statement(compiler, node->as.while_statement.body);
+            emitLoop(compiler, node->as.while_statement.condition, loopStart);
+            patchJumps(compiler, node->as.while_statement.condition, &exitJumps);
+            break;
+        }
+        case NODE_BLOCK:
+            for (int i = 0; i < node->as.block.statement_count; i++) {
+                statement(compiler, node->as.block.statements[i]);
+            }
+            endScope(compiler, node);
+            break;
+        case NODE_RETURN_STATEMENT: {
+            Node* value = node->as.return_statement.expression;
+            if (value != NULL && value->type == NODE_CALL && value->as.call.tail) {
+                expression(compiler, value);
+                break;
+            }
+            if (value != NULL) {
+                expression(compiler, value);
+            } else {
+                emitOp(compiler, OP_VOID, 1);
+            }
+            emitOp(compiler, OP_RETURN, -1);
+            break;
+        }
+        case NODE_FUNCTION_DECLARATION:
+            // Function bodies are compiled after the top-level code.
+            break;
+        default:
+            errorAt(compiler, &node->token, "Unknown statement type.");
+            break;
+    }
+}
+
+// Parameters are already on the stack when the body starts. Falling off the
+// end returns the zero value of the declared return type.
+static void function(Compiler* compiler, Node* node) {
+    if (node->as.function_declaration.index > UINT16_MAX) {
+        errorAt(compiler, &node->as.function_declaration.identifier->token, "Too many functions in one program.");
+        return;
+    }
+    FunctionEntry* entry = &compiler->chunk->functions[node->as.function_declaration.index];
+    int arity = node->as.function_declaration.parameter_count;
+    entry->entry = compiler->chunk->count;
+    entry->arity = arity;
+    compiler->local_count = arity;
+    compiler->reserved = 0;
+    compiler->stack_depth = arity;
+    compiler->max_depth = arity;
+
+    statement(compiler, node->as.function_declaration.body);
+    emitConstant(compiler, node->as.function_declaration.identifier,
+                 defaultValue(node->as.function_declaration.type));
+    emitOp(compiler, OP_RETURN, -1);
+    entry->max_stack = compiler->max_depth;
+}
+
+InputSlot* listInputs(Node* program) {
+    int count = program->as.program.input_count;
+    InputSlot* inputs = calloc(count > 0 ? count : 1, sizeof(InputSlot));
+    for (int i = 0; i < program->as.program.declaration_count; i++) {
+        Node* declaration = program->as.program.declarations[i];
+        if (declaration->type != NODE_VARIABLE_DECLARATION || declaration->as.variable_declaration.input == -1) {
+            continue;
+        }
+        Token* name = &declaration->as.variable_declaration.identifier->token;
+        InputSlot* input = &inputs[declaration->as.variable_declaration.input];
+        input->name = malloc(name->length + 1);
+        memcpy(input->name, name->lexeme, name->length);
+        input->name[name->length] = '\0';
+        input->type = declaration->as.variable_declaration.type->value_type;
+    }
+    return inputs;
+}
+
+int compileProgram(Node* program, Chunk* chunk, FILE* errors) {
+    Compiler compiler;
+    compiler.chunk = chunk;
+    compiler.errors = errors;
+    // The program's frame is reserved up front, as the tree-walker does, so a
+    // function called before a global is declared still finds its frame above
+    // every global rather than on top of their slots.
+    compiler.local_count = 0;
+    compiler.reserved = program->as.program.frame_size;
+    compiler.stack_depth = compiler.reserved;
+    compiler.max_depth = compiler.reserved;
+    compiler.hadError = 0;
+
+    for (int i = 0; i < program->as.program.declaration_count; i++) {
+        statement(&compiler, program->as.program.declarations[i]);
+    }
+    emitOp(&compiler, OP_VOID, 1);
+    emitOp(&compiler, OP_RETURN, -1);
+    chunk->max_stack = compiler.max_depth;
+    chunk->frame_size = compiler.reserved;
+    chunk->inputs = listInputs(program);
+    chunk->input_count = program->as.program.input_count;
+
+    int count = program->as.program.function_count;
+    chunk->functions = calloc(count > 0 ? count : 1, sizeof(FunctionEntry));
+    chunk->function_count = count;
+    for (int i = 0; i < program->as.program.declaration_count; i++) {
+        Node* declaration = program->as.program.declarations[i];
+        if (declaration->type == NODE_FUNCTION_DECLARATION) function(&compiler, declaration);
+    }
+
+    return !compiler.hadError;
+}
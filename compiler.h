@@ -0,0 +1,16 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <stdio.h>
+#include "chunk.h"
+#include "parser.h"
+
+// Lowers a resolved NODE_PROGRAM tree into bytecode. Returns 0 and reports to
+// errors if the program uses a construct the bytecode engine cannot express.
+int compileProgram(Node* program, Chunk* chunk, FILE* errors);
+
+// Describes a type-checked program's inputs, by index, as an array of
+// program->as.program.input_count slots to release with freeInputSlots.
+InputSlot* listInputs(Node* program);
+
+#endif
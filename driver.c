@@ -0,0 +1,223 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "driver.h"
+#include "interner.h"
+#include "lexer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "source.h"
+#include "tokenbuffer.h"
+#include "typecheck.h"
+
+typedef struct {
+    const char* path;
+    int status;             // 0, 65 or 74, as the process exit status would be
+    int token_count;
+    int node_count;
+    char* diagnostics;      // Everything the phases reported for this file
+    size_t diagnostics_length;
+    int done;
+} FileResult;
+
+typedef struct {
+    FileResult* results;
+    int count;
+    atomic_int next;        // Index of the next file nobody has claimed
+    pthread_mutex_t lock;   // Guards done flags
+    pthread_cond_t finished;
+} Batch;
+
+static void* allocOrDie(void* pointer, size_t size) {
+    void* result = realloc(pointer, size);
+    if (result == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(74);
+    }
+    return result;
+}
+
+void initFileList(FileList* files) {
+    files->paths = NULL;
+    files->count = 0;
+    files->capacity = 0;
+}
+
+void freeFileList(FileList* files) {
+    for (int i = 0; i < files->count; i++) free(files->paths[i]);
+    free(files->paths);
+    initFileList(files);
+}
+
+static void addFileLength(FileList* files, const char* path, size_t length) {
+    if (files->count == files->capacity) {
+        files->capacity = files->capacity < 64 ? 64 : files->capacity * 2;
+        files->paths = allocOrDie(files->paths, files->capacity * sizeof(char*));
+    }
+    char* copy = allocOrDie(NULL, length + 1);
+    memcpy(copy, path, length);
+    copy[length] = '\0';
+    files->paths[files->count++] = copy;
+}
+
+void addFile(FileList* files, const char* path) {
+    addFileLength(files, path, strlen(path));
+}
+
+int addManifest(FileList* files, const char* path, FILE* errors) {
+    Source source;
+    if (!openSource(&source, path, errors)) return 0;
+    loadSource(&source);
+
+    const char* end = source.data + source.length;
+    for (const char* line = source.data; line < end;) {
+        const char* newline = memchr(line, '\n', end - line);
+        const char* stop = newline != NULL ? newline : end;
+        const char* last = stop;
+        while (last > line && (last[-1] == '\r' || last[-1] == ' ' || last[-1] == '\t')) last--;
+        if (last > line && line[0] != '#') addFileLength(files, line, last - line);
+        line = stop + 1;
+    }
+
+    closeSource(&source);
+    return 1;
+}
+
+static void checkFile(FileResult* result) {
+    FILE* errors = open_memstream(&result->diagnostics, &result->diagnostics_length);
+    if (errors == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(74);
+    }
+
+    Source source;
+    if (!openSource(&source, result->path, errors)) {
+        result->status = 74;
+        fclose(errors);
+        return;
+    }
+
+    Interner interner;
+    initInterner(&interner);
+
+    Lexer lexer;
+    initLexerSource(&lexer, &source, &interner);
+
+    TokenBuffer tokens;
+    initTokenBuffer(&tokens);
+    tokenize(&tokens, &lexer);
+    result->token_count = tokens.count;
+
+    Arena arena;
+    initArena(&arena);
+
+    Parser parser;
+    initParser(&parser, &tokens, &arena);
+    parser.errors = errors;
+
+    Node* program = parseProgram(&parser);
+    result->node_count = parser.node_count;
+    if (parser.hadError || !resolveProgram(program, errors) || !typeCheckProgram(program, &arena, errors)) {
+        result->status = 65;
+    }
+
+    freeArena(&arena);
+    freeTokenBuffer(&tokens);
+    freeInterner(&interner);
+    closeSource(&source);
+    fclose(errors);
+}
+
+static void* worker(void* argument) {
+    Batch* batch = argument;
+    for (;;) {
+        int index = atomic_fetch_add(&batch->next, 1);
+        if (index >= batch->count) return NULL;
+
+        checkFile(&batch->results[index]);
+
+        pthread_mutex_lock(&batch->lock);
+        batch->results[index].done = 1;
+        pthread_cond_broadcast(&batch->finished);
+        pthread_mutex_unlock(&batch->lock);
+    }
+}
+
+static void report(FileResult* result, FILE* out) {
+    if (result->status == 0) {
+        fprintf(out, "ok    %s (%d tokens, %d nodes)\n", result->path, result->token_count, result->node_count);
+    } else {
+        fprintf(out, "FAIL  %s\n", result->path);
+    }
+    // Indent diagnostics under their file.
+    const char* text = result->diagnostics;
+    const char* end = text + result->diagnostics_length;
+    while (text < end) {
+        const char* newline = memchr(text, '\n', end - text);
+        const char* stop = newline != NULL ? newline + 1 : end;
+        fprintf(out, "      %.*s", (int)(stop - text), text);
+        if (newline == NULL) fputc('\n', out);
+        text = stop;
+    }
+}
+
+int checkFiles(FileList* files, int jobs, FILE* out) {
+    struct timespec start, finish;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (jobs <= 0) jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs > files->count) jobs = files->count;
+    if (jobs < 1) jobs = 1;
+
+    Batch batch;
+    batch.results = allocOrDie(NULL, (files->count > 0 ? files->count : 1) * sizeof(FileResult));
+    batch.count = files->count;
+    atomic_init(&batch.next, 0);
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.finished, NULL);
+    for (int i = 0; i < files->count; i++) {
+        FileResult* result = &batch.results[i];
+        result->path = files->paths[i];
+        result->status = 0;
+        result->token_count = 0;
+        result->node_count = 0;
+        result->diagnostics = NULL;
+        result->diagnostics_length = 0;
+        result->done = 0;
+    }
+
+    pthread_t* threads = allocOrDie(NULL, jobs * sizeof(pthread_t));
+    int started = 0;
+    while (started < jobs && pthread_create(&threads[started], NULL, worker, &batch) == 0) started++;
+    if (started == 0) worker(&batch);
+
+    // Report each file as soon as it and everything before it is done.
+    int status = 0;
+    int failed = 0;
+    for (int i = 0; i < files->count; i++) {
+        FileResult* result = &batch.results[i];
+        pthread_mutex_lock(&batch.lock);
+        while (!result->done) pthread_cond_wait(&batch.finished, &batch.lock);
+        pthread_mutex_unlock(&batch.lock);
+
+        report(result, out);
+        free(result->diagnostics);
+        if (result->status != 0) failed++;
+        if (result->status > status) status = result->status;
+    }
+
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+    fprintf(stderr, "checked %d files on %d thread%s in %.3f s: %d ok, %d failed\n", files->count,
+            started > 0 ? started : 1, started > 1 ? "s" : "", (finish.tv_sec - start.tv_sec) + (finish.tv_nsec - start.tv_nsec) / 1e9,
+            files->count - failed, failed);
+
+    free(threads);
+    free(batch.results);
+    pthread_mutex_destroy(&batch.lock);
+    pthread_cond_destroy(&batch.finished);
+    return status;
+}
@@ -0,0 +1,30 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include <stdio.h>
+
+// Scripts to check in batch mode, in the order their results are reported.
+typedef struct {
+    char** paths;
+    int count;
+    int capacity;
+} FileList;
+
+void initFileList(FileList* files);
+void freeFileList(FileList* files);
+void addFile(FileList* files, const char* path);
+
+// Adds every path listed in a manifest, one per line; blank lines and lines
+// starting with '#' are skipped. "-" reads the manifest from stdin. Returns 0
+// and reports to errors if the manifest cannot be read.
+int addManifest(FileList* files, const char* path, FILE* errors);
+
+// Lexes, parses, resolves and type checks each file on a pool of jobs worker
+// threads (one per CPU when jobs is 0). Every file gets its own source,
+// interner, tokens and arena, and its diagnostics are collected separately, so
+// workers share nothing but the queue. Results are written to out in list
+// order as they become available. Returns 0 if every file checked cleanly, 65
+// if any had errors, 74 if any could not be read.
+int checkFiles(FileList* files, int jobs, FILE* out);
+
+#endif
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interner.h"
+
+void initInterner(Interner* interner) {
+    interner->chars = NULL;
+    interner->chars_used = 0;
+    interner->chars_capacity = 0;
+    interner->offsets = NULL;
+    interner->lengths = NULL;
+    interner->hashes = NULL;
+    interner->count = 0;
+    interner->capacity = 0;
+    interner->table = NULL;
+    interner->table_capacity = 0;
+}
+
+void freeInterner(Interner* interner) {
+    free(interner->chars);
+    free(interner->offsets);
+    free(interner->lengths);
+    free(interner->hashes);
+    free(interner->table);
+    initInterner(interner);
+}
+
+static void* reallocOrDie(void* pointer, size_t size) {
+    void* result = realloc(pointer, size);
+    if (result == NULL) {
+        fprintf(stderr, "Out of memory interning identifiers.\n");
+        exit(74);
+    }
+    return result;
+}
+
+// FNV-1a.
+static unsigned int hashName(const char* name, int length) {
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void growTable(Interner* interner) {
+    int capacity = interner->table_capacity < 64 ? 64 : interner->table_capacity * 2;
+    free(interner->table);
+    interner->table = reallocOrDie(NULL, capacity * sizeof(int));
+    for (int i = 0; i < capacity; i++) interner->table[i] = -1;
+    interner->table_capacity = capacity;
+
+    for (int symbol = 0; symbol < interner->count; symbol++) {
+        int bucket = interner->hashes[symbol] & (capacity - 1);
+        while (interner->table[bucket] != -1) bucket = (bucket + 1) & (capacity - 1);
+        interner->table[bucket] = symbol;
+    }
+}
+
+int internSymbol(Interner* interner, const char* name, int length) {
+    unsigned int hash = hashName(name, length);
+
+    if (interner->table_capacity != 0) {
+        int mask = interner->table_capacity - 1;
+        for (int bucket = hash & mask; interner->table[bucket] != -1; bucket = (bucket + 1) & mask) {
+            int symbol = interner->table[bucket];
+            if (interner->hashes[symbol] == hash && interner->lengths[symbol] == length &&
+                memcmp(interner->chars + interner->offsets[symbol], name, length) == 0) {
+                return symbol;
+            }
+        }
+    }
+
+    // Keep the table at most half full.
+    if ((interner->count + 1) * 2 > interner->table_capacity) growTable(interner);
+
+    if (interner->count == interner->capacity) {
+        interner->capacity = interner->capacity < 64 ? 64 : interner->capacity * 2;
+        interner->offsets = reallocOrDie(interner->offsets, interner->capacity * sizeof(size_t));
+        interner->lengths = reallocOrDie(interner->lengths, interner->capacity * sizeof(int));
+        interner->hashes = reallocOrDie(interner->hashes, interner->capacity * sizeof(unsigned int));
+    }
+    if (interner->chars_used + length + 1 > interner->chars_capacity) {
+        size_t capacity = interner->chars_capacity < 1024 ? 1024 : interner->chars_capacity;
+        while (interner->chars_used + length + 1 > capacity) capacity *= 2;
+        interner->chars = reallocOrDie(interner->chars, capacity);
+        interner->chars_capacity = capacity;
+    }
+
+    int symbol = interner->count++;
+    interner->offsets[symbol] = interner->chars_used;
+    interner->lengths[symbol] = length;
+    interner->hashes[symbol] = hash;
+    memcpy(interner->chars + interner->chars_used, name, length);
+    interner->chars[interner->chars_used + length] = '\0';
+    interner->chars_used += length + 1;
+
+    int mask = interner->table_capacity - 1;
+    int bucket = hash & mask;
+    while (interner->table[bucket] != -1) bucket = (bucket + 1) & mask;
+    interner->table[bucket] = symbol;
+    return symbol;
+}
+
+const char* symbolName(Interner* interner, int symbol) {
+    return interner->chars + interner->offsets[symbol];
+}
+
+int symbolLength(Interner* interner, int symbol) {
+    return interner->lengths[symbol];
+}
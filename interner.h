@@ -0,0 +1,28 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <stddef.h>
+
+// Maps each distinct identifier spelling to a small integer symbol, so later
+// passes compare names with == instead of memcmp. Symbols are numbered from 0
+// in order of first appearance. Names are copied, so they outlive the source.
+typedef struct {
+    char* chars;            // Every name, each followed by '\0'
+    size_t chars_used;
+    size_t chars_capacity;
+    size_t* offsets;        // Symbol -> offset of its name in chars
+    int* lengths;
+    unsigned int* hashes;
+    int count;
+    int capacity;
+    int* table;             // Open-addressed; -1 marks an empty bucket
+    int table_capacity;
+} Interner;
+
+void initInterner(Interner* interner);
+void freeInterner(Interner* interner);
+int internSymbol(Interner* interner, const char* name, int length);
+const char* symbolName(Interner* interner, int symbol);
+int symbolLength(Interner* interner, int symbol);
+
+#endif
@@ -1,3 +1,4 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,99 +6,257 @@
 #include "parser.h"
 #include "token.h"
 
-static Environment* createEnvironment(Environment* enclosing) {
-    Environment* env = malloc(sizeof(Environment));
-    env->variables = NULL;
-    env->variable_count = 0;
-    env->enclosing = enclosing;
-    return env;
+static inline Value* getVariable(Interpreter* interpreter, Node* identifier) {
+    Value* frame = identifier->as.identifier.global ? interpreter->stack : interpreter->frame;
+    return &frame[identifier->as.identifier.slot];
 }
 
-static void defineVariable(Environment* env, const char* name, Value value) {
-    env->variable_count++;
-    env->variables = realloc(env->variables, env->variable_count * sizeof(Variable));
-    env->variables[env->variable_count - 1].name = strdup(name);
-    env->variables[env->variable_count - 1].value = value;
+static void runtimeError(const char* message) {
+    fprintf(stderr, "%s\n", message);
+    exit(70);
 }
 
-static Value* getVariable(Environment* env, const char* name) {
-    for (int i = 0; i < env->variable_count; i++) {
-        if (strcmp(env->variables[i].name, name) == 0) {
-            return &env->variables[i].value;
+void initInterpreter(Interpreter* interpreter, Node* program) {
+    int size = program->as.program.frame_size > STACK_MAX ? program->as.program.frame_size : STACK_MAX;
+    interpreter->stack = calloc(size, sizeof(Value));
+    interpreter->frame = interpreter->stack;
+    interpreter->top = interpreter->stack + program->as.program.frame_size;
+    interpreter->depth = 0;
+    interpreter->returning = 0;
+    interpreter->return_value = (Value){VALUE_VOID, {0}};
+    interpreter->tail_call = NULL;
+    for (int i = 0; i < FUSED_FORM_COUNT; i++) interpreter->fused[i] = 0;
+    interpreter->profile = NULL;
+    interpreter->inputs = NULL;
+}
+
+void freeInterpreter(Interpreter* interpreter) {
+    free(interpreter->stack);
+    interpreter->stack = NULL;
+    interpreter->frame = NULL;
+    interpreter->top = NULL;
+}
+
+static Value defaultValue(Node* type) {
+    return (Value){type->value_type, {0}};
+}
+
+// Conditions are tested by their static type, not the value's tag.
+static inline int isTrue(Node* condition, Value value) {
+    return condition->value_type == VALUE_INT ? value.as.int_value != 0 : value.as.float_value != 0;
+}
+
+// Applies a comparison to two operands of the type it was checked with. A
+// comparison with NaN is false, except !=, as in C.
+static inline int compare(Operation operation, Value left, Value right) {
+    switch (operation) {
+        case OPERATION_EQUAL_INT:           return left.as.int_value == right.as.int_value;
+        case OPERATION_NOT_EQUAL_INT:       return left.as.int_value != right.as.int_value;
+        case OPERATION_LESS_INT:            return left.as.int_value < right.as.int_value;
+        case OPERATION_LESS_EQUAL_INT:      return left.as.int_value <= right.as.int_value;
+        case OPERATION_GREATER_INT:         return left.as.int_value > right.as.int_value;
+        case OPERATION_GREATER_EQUAL_INT:   return left.as.int_value >= right.as.int_value;
+        case OPERATION_EQUAL_FLOAT:         return left.as.float_value == right.as.float_value;
+        case OPERATION_NOT_EQUAL_FLOAT:     return left.as.float_value != right.as.float_value;
+        case OPERATION_LESS_FLOAT:          return left.as.float_value < right.as.float_value;
+        case OPERATION_LESS_EQUAL_FLOAT:    return left.as.float_value <= right.as.float_value;
+        case OPERATION_GREATER_FLOAT:       return left.as.float_value > right.as.float_value;
+        case OPERATION_GREATER_EQUAL_FLOAT: return left.as.float_value >= right.as.float_value;
+        default:
+            fprintf(stderr, "Unknown comparison operator\n");
+            exit(1);
+    }
+}
+
+// Operands a binary node fuses into one step once it has been quickened.
+static int isVariableConstant(Node* node) {
+    return node->as.binary.left->type == NODE_IDENTIFIER && node->as.binary.right->type == NODE_LITERAL;
+}
+
+static Value evaluateExpression(Interpreter* interpreter, Node* node);
+static inline Value arithmetic(Node* node, Value left, Value right);
+
+// Tests an if or while condition. A variable or a quickened x op constant is
+// evaluated right here rather than through a call per node, a comparison
+// branches on its operands without building a Value for its result, and
+// &&, || and ! become control flow over the tests of their operands.
+static int testCondition(Interpreter* interpreter, Node* condition) {
+    switch (condition->type) {
+        case NODE_IDENTIFIER:
+            interpreter->fused[FUSED_TEST_BRANCH]++;
+            return isTrue(condition, *getVariable(interpreter, condition));
+        case NODE_VARIABLE_CONSTANT: {
+            Value variable = *getVariable(interpreter, condition->as.binary.left);
+            Value constant = condition->as.binary.right->as.literal.value;
+            if (isComparison(condition->operation)) {
+                interpreter->fused[FUSED_COMPARE_BRANCH]++;
+                return compare(condition->operation, variable, constant);
+            }
+            interpreter->fused[FUSED_TEST_BRANCH]++;
+            return isTrue(condition, arithmetic(condition, variable, constant));
         }
+        case NODE_BINARY: {
+            if (!isComparison(condition->operation)) break;
+            if (isVariableConstant(condition)) {
+                condition->type = NODE_VARIABLE_CONSTANT;
+                return testCondition(interpreter, condition);
+            }
+            interpreter->fused[FUSED_COMPARE_BRANCH]++;
+            Value left = evaluateExpression(interpreter, condition->as.binary.left);
+            return compare(condition->operation, left, evaluateExpression(interpreter, condition->as.binary.right));
+        }
+        case NODE_LOGICAL:
+            if (condition->operation == OPERATION_AND) {
+                return testCondition(interpreter, condition->as.binary.left) &&
+                       testCondition(interpreter, condition->as.binary.right);
+            }
+            return testCondition(interpreter, condition->as.binary.left) ||
+                   testCondition(interpreter, condition->as.binary.right);
+        case NODE_UNARY:
+            if (condition->operation == OPERATION_NOT_INT || condition->operation == OPERATION_NOT_FLOAT) {
+                return !testCondition(interpreter, condition->as.unary.operand);
+            }
+            break;
+        default:
+            break;
     }
-    if (env->enclosing) {
-        return getVariable(env->enclosing, name);
+    return isTrue(condition, evaluateExpression(interpreter, condition));
+}
+
+static void executeStatement(Interpreter* interpreter, Node* node);
+
+// Evaluates a call's arguments into the slots just past the running frame.
+static Value* pushArguments(Interpreter* interpreter, Node* call) {
+    Value* arguments = interpreter->top;
+    for (int i = 0; i < call->as.call.argument_count; i++) {
+        Value value = evaluateExpression(interpreter, call->as.call.arguments[i]);
+        if (interpreter->top == interpreter->stack + STACK_MAX) runtimeError("Stack overflow.");
+        *interpreter->top++ = value;
     }
-    return NULL;
+    return arguments;
 }
 
-void initInterpreter(Interpreter* interpreter) {
-    interpreter->global_env = createEnvironment(NULL);
-    interpreter->current_env = interpreter->global_env;
+// The callee's frame starts at its arguments, which become its first slots.
+// A tail call inside the body leaves its arguments at the bottom of the same
+// frame and the loop runs the next function there, so tail recursion does
+// not grow either stack.
+static Value callFunction(Interpreter* interpreter, Node* call) {
+    if (interpreter->depth == FRAMES_MAX) runtimeError("Stack overflow.");
+    Value* callerFrame = interpreter->frame;
+    Value* frame = pushArguments(interpreter, call);
+    Node* function = call->as.call.function;
+    interpreter->depth++;
+    interpreter->frame = frame;
+    if (interpreter->profile != NULL) profileCall(interpreter->profile, function);
+
+    for (;;) {
+        if (frame + function->as.function_declaration.frame_size > interpreter->stack + STACK_MAX) {
+            runtimeError("Stack overflow.");
+        }
+        interpreter->top = frame + function->as.function_declaration.frame_size;
+        executeStatement(interpreter, function->as.function_declaration.body);
+        if (interpreter->tail_call == NULL) break;
+        function = interpreter->tail_call;
+        interpreter->tail_call = NULL;
+        interpreter->returning = 0;
+        if (interpreter->profile != NULL) profileTailCall(interpreter->profile, function);
+    }
+
+    Value result = defaultValue(function->as.function_declaration.type);
+    if (interpreter->returning) result = interpreter->return_value;
+    interpreter->returning = 0;
+    interpreter->frame = callerFrame;
+    interpreter->top = frame;
+    interpreter->depth--;
+    if (interpreter->profile != NULL) profileReturn(interpreter->profile);
+    return result;
+}
+
+// Applies a binary node's typed operation to two operand values.
+static inline Value arithmetic(Node* node, Value left, Value right) {
+    Value result = {node->value_type, {0}};
+    if (isComparison(node->operation)) {
+        result.as.int_value = compare(node->operation, left, right);
+        return result;
+    }
+
+    // Split by type so each switch is small enough to become a
+    // chain of direct branches rather than one shared indirect jump.
+    if (node->value_type == VALUE_INT) {
+        switch (node->operation) {
+            case OPERATION_ADD_INT:
+                result.as.int_value = (int)((unsigned int)left.as.int_value + (unsigned int)right.as.int_value);
+                break;
+            case OPERATION_SUBTRACT_INT:
+                result.as.int_value = (int)((unsigned int)left.as.int_value - (unsigned int)right.as.int_value);
+                break;
+            case OPERATION_MULTIPLY_INT:
+                result.as.int_value = (int)((unsigned int)left.as.int_value * (unsigned int)right.as.int_value);
+                break;
+            case OPERATION_DIVIDE_INT:
+                if (right.as.int_value == 0) runtimeError("Division by zero.");
+                if (right.as.int_value == -1 && left.as.int_value == INT_MIN) runtimeError("Integer overflow.");
+                result.as.int_value = left.as.int_value / right.as.int_value;
+                break;
+            default:
+                fprintf(stderr, "Unknown operator for int operation\n");
+                exit(1);
+        }
+    } else {
+        switch (node->operation) {
+            case OPERATION_ADD_FLOAT:
+                result.as.float_value = left.as.float_value + right.as.float_value;
+                break;
+            case OPERATION_SUBTRACT_FLOAT:
+                result.as.float_value = left.as.float_value - right.as.float_value;
+                break;
+            case OPERATION_MULTIPLY_FLOAT:
+                result.as.float_value = left.as.float_value * right.as.float_value;
+                break;
+            case OPERATION_DIVIDE_FLOAT:
+                result.as.float_value = left.as.float_value / right.as.float_value;
+                break;
+            default:
+                fprintf(stderr, "Unknown operator for float operation\n");
+                exit(1);
+        }
+    }
+    return result;
 }
 
 static Value evaluateExpression(Interpreter* interpreter, Node* node) {
     switch (node->type) {
         case NODE_BINARY: {
+            // The first run of x op constant rewrites the node, so later runs
+            // read the variable directly instead of recursing into both sides.
+            if (isVariableConstant(node)) {
+                node->type = NODE_VARIABLE_CONSTANT;
+                return evaluateExpression(interpreter, node);
+            }
             Value left = evaluateExpression(interpreter, node->as.binary.left);
             Value right = evaluateExpression(interpreter, node->as.binary.right);
-            Value result = {VALUE_INT, {0}};
-
-            if (left.type == VALUE_FLOAT || right.type == VALUE_FLOAT) {
-                result.type = VALUE_FLOAT;
-                float left_val = (left.type == VALUE_FLOAT) ? left.as.float_value : (float)left.as.int_value;
-                float right_val = (right.type == VALUE_FLOAT) ? right.as.float_value : (float)right.as.int_value;
-
-                switch (node->token.type) {
-                    case TOKEN_PLUS:
-                        result.as.float_value = left_val + right_val;
-                        break;
-                    case TOKEN_MINUS:
-                        result.as.float_value = left_val - right_val;
-                        break;
-                    case TOKEN_ASTERISK:
-                        result.as.float_value = left_val * right_val;
-                        break;
-                    case TOKEN_SLASH:
-                        result.as.float_value = left_val / right_val;
-                        break;
-                    default:
-                        fprintf(stderr, "Unknown operator for float operation\n");
-                        exit(1);
-                }
-            } else {
-                switch (node->token.type) {
-                    case TOKEN_PLUS:
-                        result.as.int_value = left.as.int_value + right.as.int_value;
-                        break;
-                    case TOKEN_MINUS:
-                        result.as.int_value = left.as.int_value - right.as.int_value;
-                        break;
-                    case TOKEN_ASTERISK:
-                        result.as.int_value = left.as.int_value * right.as.int_value;
-                        break;
-                    case TOKEN_SLASH:
-                        result.as.int_value = left.as.int_value / right.as.int_value;
-                        break;
-                    default:
-                        fprintf(stderr, "Unknown operator for int operation\n");
-                        exit(1);
-                }
-            }
-            return result;
+            return arithmetic(node, left, right);
         }
+        case NODE_VARIABLE_CONSTANT:
+            interpreter->fused[FUSED_VARIABLE_CONSTANT]++;
+            return arithmetic(node, *getVariable(interpreter, node->as.binary.left),
+                              node->as.binary.right->as.literal.value);
         case NODE_UNARY: {
             Value operand = evaluateExpression(interpreter, node->as.unary.operand);
-            Value result = {operand.type, {0}};
-
-            switch (node->token.type) {
-                case TOKEN_MINUS:
-                    if (operand.type == VALUE_INT) {
-                        result.as.int_value = -operand.as.int_value;
-                    } else {
-                        result.as.float_value = -operand.as.float_value;
-                    }
+            Value result = {node->value_type, {0}};
+
+            switch (node->operation) {
+                case OPERATION_NEGATE_INT:
+                    result.as.int_value = (int)-(unsigned int)operand.as.int_value;
+                    break;
+                case OPERATION_NEGATE_FLOAT:
+                    result.as.float_value = -operand.as.float_value;
+                    break;
+                case OPERATION_NOT_INT:
+                    result.as.int_value = operand.as.int_value == 0;
+                    break;
+                case OPERATION_NOT_FLOAT:
+                    result.as.int_value = operand.as.float_value == 0;
                     break;
                 default:
                     fprintf(stderr, "Unknown unary operator\n");
@@ -105,35 +264,42 @@ static Value evaluateExpression(Interpreter* interpreter, Node* node) {
             }
             return result;
         }
-        case NODE_LITERAL: {
-            Value result;
-            if (node->token.type == TOKEN_INTEGER_LITERAL) {
-                result.type = VALUE_INT;
-                result.as.int_value = atoi(node->token.lexeme);
-            } else if (node->token.type == TOKEN_FLOAT_LITERAL) {
-                result.type = VALUE_FLOAT;
-                result.as.float_value = atof(node->token.lexeme);
+        case NODE_CONVERT: {
+            Value operand = evaluateExpression(interpreter, node->as.unary.operand);
+            Value result = {node->value_type, {0}};
+            if (node->operation == OPERATION_INT_TO_FLOAT) {
+                result.as.float_value = (float)operand.as.int_value;
+            } else {
+                result.as.int_value = floatToInt(operand.as.float_value);
             }
             return result;
         }
-        case NODE_IDENTIFIER: {
-            Value* value = getVariable(interpreter->current_env, node->token.lexeme);
-            if (value == NULL) {
-                fprintf(stderr, "Undefined variable: %s\n", node->token.lexeme);
-                exit(1);
-            }
-            return *value;
-        }
+        case NODE_LOGICAL:
+            return (Value){VALUE_INT, {.int_value = testCondition(interpreter, node)}};
+        case NODE_LITERAL:
+            return node->as.literal.value;
+        case NODE_IDENTIFIER:
+            return *getVariable(interpreter, node);
         case NODE_ASSIGNMENT: {
-            Value value = evaluateExpression(interpreter, node->as.assignment.right);
-            Value* variable = getVariable(interpreter->current_env, node->as.assignment.left->token.lexeme);
-            if (variable == NULL) {
-                fprintf(stderr, "Undefined variable: %s\n", node->as.assignment.left->token.lexeme);
-                exit(1);
+            Node* right = node->as.assignment.right;
+            if ((right->type == NODE_BINARY || right->type == NODE_VARIABLE_CONSTANT) && isVariableConstant(right) &&
+                right->as.binary.left->as.identifier.variable == node->as.assignment.left->as.identifier.variable) {
+                node->type = NODE_UPDATE;
+                return evaluateExpression(interpreter, node);
             }
-            *variable = value;
+            Value value = evaluateExpression(interpreter, right);
+            *getVariable(interpreter, node->as.assignment.left) = value;
             return value;
         }
+        case NODE_UPDATE: {
+            Value* variable = getVariable(interpreter, node->as.assignment.left);
+            Node* right = node->as.assignment.right;
+            interpreter->fused[FUSED_UPDATE]++;
+            *variable = arithmetic(right, *variable, right->as.binary.right->as.literal.value);
+            return *variable;
+        }
+        case NODE_CALL:
+            return callFunction(interpreter, node);
         default:
             fprintf(stderr, "Unknown node type in expression\n");
             exit(1);
@@ -141,25 +307,28 @@ static Value evaluateExpression(Interpreter* interpreter, Node* node) {
 }
 
 static void executeStatement(Interpreter* interpreter, Node* node) {
+    // A while statement counts once per test of its condition, and a block
+    // is just its statements.
+    if (interpreter->profile != NULL && node->type != NODE_BLOCK && node->type != NODE_WHILE_STATEMENT) {
+        profileStatement(interpreter->profile, node);
+    }
     switch (node->type) {
         case NODE_EXPRESSION_STATEMENT: {
             evaluateExpression(interpreter, node->as.expression_statement.expression);
             break;
         }
         case NODE_VARIABLE_DECLARATION: {
-            Value value = {VALUE_INT, {0}};  // Default initialization
-            if (node->as.variable_declaration.type->token.type == TOKEN_FLOAT) {
-                value.type = VALUE_FLOAT;
-            }
-            if (node->as.variable_declaration.initializer != NULL) {
+            Value value = defaultValue(node->as.variable_declaration.type);
+            if (node->as.variable_declaration.input != -1) {
+                value = interpreter->inputs[node->as.variable_declaration.input];
+            } else if (node->as.variable_declaration.initializer != NULL) {
                 value = evaluateExpression(interpreter, node->as.variable_declaration.initializer);
             }
-            defineVariable(interpreter->current_env, node->as.variable_declaration.identifier->token.lexeme, value);
+            *getVariable(interpreter, node->as.variable_declaration.identifier) = value;
             break;
         }
         case NODE_IF_STATEMENT: {
-            Value condition = evaluateExpression(interpreter, node->as.if_statement.condition);
-            if (condition.type == VALUE_INT ? condition.as.int_value : condition.as.float_value) {
+            if (testCondition(interpreter, node->as.if_statement.condition)) {
                 executeStatement(interpreter, node->as.if_statement.then_branch);
             } else if (node->as.if_statement.else_branch != NULL) {
                 executeStatement(interpreter, node->as.if_statement.else_branch);
@@ -168,25 +337,34 @@ static void executeStatement(Interpreter* interpreter, Node* node) {
         }
         case NODE_WHILE_STATEMENT: {
             while (1) {
-                Value condition = evaluateExpression(interpreter, node->as.while_statement.condition);
-                if (!(condition.type == VALUE_INT ? condition.as.int_value : condition.as.float_value)) {
-                    break;
-                }
+                if (interpreter->profile != NULL) profileStatement(interpreter->profile, node);
+                if (!testCondition(interpreter, node->as.while_statement.condition)) break;
                 executeStatement(interpreter, node->as.while_statement.body);
+                if (interpreter->returning) break;
             }
             break;
         }
         case NODE_BLOCK: {
-            Environment* previous = interpreter->current_env;
-            interpreter->current_env = createEnvironment(previous);
             for (int i = 0; i < node->as.block.statement_count; i++) {
                 executeStatement(interpreter, node->as.block.statements[i]);
+                if (interpreter->returning) break;
             }
-            interpreter->current_env = previous;
             break;
         }
         case NODE_RETURN_STATEMENT: {
-            // This will be handled in evaluateNode
+            Node* value = node->as.return_statement.expression;
+            if (value != NULL && value->type == NODE_CALL && value->as.call.tail) {
+                Value* arguments = pushArguments(interpreter, value);
+                memmove(interpreter->frame, arguments, value->as.call.argument_count * sizeof(Value));
+                interpreter->tail_call = value->as.call.function;
+                interpreter->returning = 1;
+                break;
+            }
+            interpreter->return_value = (Value){VALUE_VOID, {0}};
+            if (node->as.return_statement.expression != NULL) {
+                interpreter->return_value = evaluateExpression(interpreter, node->as.return_statement.expression);
+            }
+            interpreter->returning = 1;
             break;
         }
         default:
@@ -200,29 +378,30 @@ Value evaluateNode(Interpreter* interpreter, Node* node) {
         case NODE_PROGRAM:
             for (int i = 0; i < node->as.program.declaration_count; i++) {
                 evaluateNode(interpreter, node->as.program.declarations[i]);
+                if (interpreter->returning) return interpreter->return_value;
             }
             return (Value){VALUE_VOID, {0}};
         case NODE_FUNCTION_DECLARATION:
-            // Handle function declaration (if implemented)
+            // Functions run when called.
             return (Value){VALUE_VOID, {0}};
         case NODE_VARIABLE_DECLARATION:
         case NODE_IF_STATEMENT:
         case NODE_WHILE_STATEMENT:
         case NODE_BLOCK:
         case NODE_EXPRESSION_STATEMENT:
+        case NODE_RETURN_STATEMENT:
             executeStatement(interpreter, node);
             return (Value){VALUE_VOID, {0}};
-        case NODE_RETURN_STATEMENT:
-            if (node->as.return_statement.expression != NULL) {
-                return evaluateExpression(interpreter, node->as.return_statement.expression);
-            } else {
-                return (Value){VALUE_VOID, {0}};
-            }
         case NODE_BINARY:
         case NODE_UNARY:
         case NODE_LITERAL:
         case NODE_IDENTIFIER:
         case NODE_ASSIGNMENT:
+        case NODE_CALL:
+        case NODE_CONVERT:
+        case NODE_LOGICAL:
+        case NODE_VARIABLE_CONSTANT:
+        case NODE_UPDATE:
             return evaluateExpression(interpreter, node);
         default:
             fprintf(stderr, "Unknown node type in evaluateNode\n");
@@ -2,38 +2,27 @@
 #define INTERPRETER_H
 
 #include "parser.h"
+#include "profile.h"
+#include "value.h"
 
-typedef enum {
-    VALUE_INT,
-    VALUE_FLOAT,
-    VALUE_VOID
-} ValueType;
-
-typedef struct {
-    ValueType type;
-    union {
-        int int_value;
-        float float_value;
-    } as;
-} Value;
-
-typedef struct {
-    char* name;
-    Value value;
-} Variable;
-
-typedef struct Environment {
-    Variable* variables;
-    int variable_count;
-    struct Environment* enclosing;
-} Environment;
-
+// Variables live in frames on one preallocated stack of slots. The resolver
+// has already assigned every variable its offset, so entering and leaving a
+// block costs nothing at runtime, and a call only moves the frame pointer.
 typedef struct {
-    Environment* global_env;
-    Environment* current_env;
+    Value* stack;
+    Value* frame;           // Slots of the running function, or of the program
+    Value* top;             // First slot past the running frame
+    int depth;              // Calls in progress
+    int returning;
+    Value return_value;
+    Node* tail_call;        // Function a pending tail call continues with
+    long fused[FUSED_FORM_COUNT];   // Runs of each fused form
+    Profile* profile;       // Where statements and calls are recorded, or NULL
+    const Value* inputs;    // Values of the program's input slots, by index; set by the host
 } Interpreter;
 
-void initInterpreter(Interpreter* interpreter);
+void initInterpreter(Interpreter* interpreter, Node* program);
+void freeInterpreter(Interpreter* interpreter);
 void interpret(Interpreter* interpreter, Node* program);
 Value evaluateNode(Interpreter* interpreter, Node* node);
 void printValue(Value value);
@@ -0,0 +1,558 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "jit.h"
+
+// Generated code has the signature int (int32_t* slots, Value* result) and
+// returns 0 or a runtime error index into runtimeErrors.
+// %rbx holds the slot array and %r12 the result for the whole function; the
+// register conventions otherwise match codegen.c: ints in %eax/%ecx, floats
+// in %xmm0/%xmm1.
+typedef int (*JitEntry)(int32_t* slots, Value* result);
+
+enum { ERROR_NONE, ERROR_DIVISION_BY_ZERO, ERROR_INTEGER_OVERFLOW };
+
+static const char* const runtimeErrors[] = {
+    [ERROR_DIVISION_BY_ZERO] = "Division by zero.",
+    [ERROR_INTEGER_OVERFLOW] = "Integer overflow.",
+};
+
+_Static_assert(offsetof(Value, type) == 0 && offsetof(Value, as) == 4 && sizeof(ValueType) == 4,
+               "generated code stores Value fields at fixed offsets");
+
+typedef struct {
+    int position;
+    int label;
+} Fixup;
+
+typedef struct {
+    unsigned char* code;
+    int count;
+    int capacity;
+    int* labels;            // Code offset of each label, -1 until bound
+    int label_count;
+    int label_capacity;
+    Fixup* fixups;          // rel32 fields waiting for a label
+    int fixup_count;
+    int fixup_capacity;
+    int exit_label;
+    int error_labels[3];    // Indexed by runtime error, each loads its index
+    const char* unsupported;
+} Jit;
+
+static void unsupported(Jit* jit, const char* reason) {
+    if (jit->unsupported == NULL) jit->unsupported = reason;
+}
+
+static void byte(Jit* jit, int value) {
+    if (jit->count == jit->capacity) {
+        jit->capacity = jit->capacity < 256 ? 256 : jit->capacity * 2;
+        jit->code = realloc(jit->code, jit->capacity);
+    }
+    jit->code[jit->count++] = (unsigned char)value;
+}
+
+static void bytes(Jit* jit, const char* sequence, int length) {
+    for (int i = 0; i < length; i++) byte(jit, (unsigned char)sequence[i]);
+}
+
+#define EMIT(jit, literal) bytes(jit, literal, sizeof(literal) - 1)
+
+static void imm32(Jit* jit, uint32_t value) {
+    byte(jit, value & 0xff);
+    byte(jit, (value >> 8) & 0xff);
+    byte(jit, (value >> 16) & 0xff);
+    byte(jit, (value >> 24) & 0xff);
+}
+
+static int newLabel(Jit* jit) {
+    if (jit->label_count == jit->label_capacity) {
+        jit->label_capacity = jit->label_capacity < 16 ? 16 : jit->label_capacity * 2;
+        jit->labels = realloc(jit->labels, jit->label_capacity * sizeof(int));
+    }
+    jit->labels[jit->label_count] = -1;
+    return jit->label_count++;
+}
+
+static void bindLabel(Jit* jit, int label) {
+    jit->labels[label] = jit->count;
+}
+
+// Emits the rel32 operand of a jump whose opcode bytes were just written.
+static void rel32(Jit* jit, int label) {
+    if (jit->fixup_count == jit->fixup_capacity) {
+        jit->fixup_capacity = jit->fixup_capacity < 16 ? 16 : jit->fixup_capacity * 2;
+        jit->fixups = realloc(jit->fixups, jit->fixup_capacity * sizeof(Fixup));
+    }
+    jit->fixups[jit->fixup_count].position = jit->count;
+    jit->fixups[jit->fixup_count].label = label;
+    jit->fixup_count++;
+    imm32(jit, 0);
+}
+
+// Condition codes, the low nibble of jcc (0x0f 0x80+cc) and setcc (0x0f
+// 0x90+cc). Flipping the low bit negates one.
+enum {
+    CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7,
+    CC_P = 0xa, CC_NP = 0xb, CC_L = 0xc, CC_GE = 0xd, CC_LE = 0xe, CC_G = 0xf
+};
+
+static void jmp(Jit* jit, int label) { EMIT(jit, "\xe9"); rel32(jit, label); }
+static void jcc(Jit* jit, int cc, int label) { byte(jit, 0x0f); byte(jit, 0x80 + cc); rel32(jit, label); }
+
+static void resolveFixups(Jit* jit) {
+    for (int i = 0; i < jit->fixup_count; i++) {
+        int position = jit->fixups[i].position;
+        int32_t offset = jit->labels[jit->fixups[i].label] - (position + 4);
+        memcpy(jit->code + position, &offset, sizeof(offset));
+    }
+}
+
+static uint32_t slotOffset(Node* identifier) {
+    return 4u * identifier->as.identifier.slot;
+}
+
+static uint32_t floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static void loadEaxImmediate(Jit* jit, uint32_t value) { EMIT(jit, "\xb8"); imm32(jit, value); }
+static void loadEcxImmediate(Jit* jit, uint32_t value) { EMIT(jit, "\xb9"); imm32(jit, value); }
+static void loadEaxSlot(Jit* jit, Node* id) { EMIT(jit, "\x8b\x83"); imm32(jit, slotOffset(id)); }
+static void loadEcxSlot(Jit* jit, Node* id) { EMIT(jit, "\x8b\x8b"); imm32(jit, slotOffset(id)); }
+static void storeEaxSlot(Jit* jit, Node* id) { EMIT(jit, "\x89\x83"); imm32(jit, slotOffset(id)); }
+static void loadXmm0Slot(Jit* jit, Node* id) { EMIT(jit, "\xf3\x0f\x10\x83"); imm32(jit, slotOffset(id)); }
+static void loadXmm1Slot(Jit* jit, Node* id) { EMIT(jit, "\xf3\x0f\x10\x8b"); imm32(jit, slotOffset(id)); }
+static void storeXmm0Slot(Jit* jit, Node* id) { EMIT(jit, "\xf3\x0f\x11\x83"); imm32(jit, slotOffset(id)); }
+
+static void loadXmm0Immediate(Jit* jit, float value) {
+    loadEaxImmediate(jit, floatBits(value));
+    EMIT(jit, "\x66\x0f\x6e\xc0");              // movd %eax, %xmm0
+}
+
+static void loadXmm1Immediate(Jit* jit, float value) {
+    loadEcxImmediate(jit, floatBits(value));
+    EMIT(jit, "\x66\x0f\x6e\xc9");              // movd %ecx, %xmm1
+}
+
+static ValueType expression(Jit* jit, Node* node);
+
+static int isSimpleOperand(Node* node) {
+    return node->type == NODE_LITERAL || node->type == NODE_IDENTIFIER;
+}
+
+static ValueType loadOperand(Jit* jit, Node* node) {
+    ValueType type = node->value_type;
+    if (node->type == NODE_LITERAL) {
+        if (type == VALUE_INT) {
+            loadEcxImmediate(jit, (uint32_t)node->as.literal.value.as.int_value);
+        } else {
+            loadXmm1Immediate(jit, node->as.literal.value.as.float_value);
+        }
+    } else if (type == VALUE_INT) {
+        loadEcxSlot(jit, node);
+    } else {
+        loadXmm1Slot(jit, node);
+    }
+    return type;
+}
+
+// Leaves the left operand in eax or xmm0 and the right in ecx or xmm1. Both
+// have the same type; the type checker converted them.
+static ValueType operands(Jit* jit, Node* node) {
+    ValueType type = expression(jit, node->as.binary.left);
+    if (isSimpleOperand(node->as.binary.right)) {
+        loadOperand(jit, node->as.binary.right);
+    } else {
+        if (type == VALUE_INT) {
+            EMIT(jit, "\x50");                      // push %rax
+        } else {
+            EMIT(jit, "\x48\x83\xec\x08");          // sub $8, %rsp
+            EMIT(jit, "\xf3\x0f\x11\x04\x24");      // movss %xmm0, (%rsp)
+        }
+        expression(jit, node->as.binary.right);
+        if (type == VALUE_INT) {
+            EMIT(jit, "\x89\xc1");                  // mov %eax, %ecx
+            EMIT(jit, "\x58");                      // pop %rax
+        } else {
+            EMIT(jit, "\x0f\x28\xc8");              // movaps %xmm0, %xmm1
+            EMIT(jit, "\xf3\x0f\x10\x04\x24");      // movss (%rsp), %xmm0
+            EMIT(jit, "\x48\x83\xc4\x08");          // add $8, %rsp
+        }
+    }
+    return type;
+}
+
+static int isFloatEquality(Operation operation) {
+    return operation == OPERATION_EQUAL_FLOAT || operation == OPERATION_NOT_EQUAL_FLOAT;
+}
+
+// Compares the loaded operands and returns the condition code under which the
+// comparison holds. Float orderings compare the other way round where needed
+// so each is "above" or "above or equal", which an unordered (NaN) result
+// fails, as in C. Float == and != also need the parity flag checked.
+static int compareOperands(Jit* jit, Operation operation) {
+    if (operation < OPERATION_EQUAL_FLOAT) {
+        EMIT(jit, "\x39\xc8");                                      // cmp %ecx, %eax
+    } else if (operation == OPERATION_LESS_FLOAT || operation == OPERATION_LESS_EQUAL_FLOAT) {
+        EMIT(jit, "\x0f\x2e\xc8");                                  // ucomiss %xmm0, %xmm1
+    } else {
+        EMIT(jit, "\x0f\x2e\xc1");                                  // ucomiss %xmm1, %xmm0
+    }
+    switch (operation) {
+        case OPERATION_EQUAL_INT:           return CC_E;
+        case OPERATION_NOT_EQUAL_INT:       return CC_NE;
+        case OPERATION_LESS_INT:            return CC_L;
+        case OPERATION_LESS_EQUAL_INT:      return CC_LE;
+        case OPERATION_GREATER_INT:         return CC_G;
+        case OPERATION_GREATER_EQUAL_INT:   return CC_GE;
+        case OPERATION_EQUAL_FLOAT:         return CC_E;
+        case OPERATION_NOT_EQUAL_FLOAT:     return CC_NE;
+        case OPERATION_LESS_FLOAT:          return CC_A;
+        case OPERATION_LESS_EQUAL_FLOAT:    return CC_AE;
+        case OPERATION_GREATER_FLOAT:       return CC_A;
+        default:                            return CC_AE;
+    }
+}
+
+// Sets eax to 1 if condition cc holds, or 0. A float equality also needs the
+// result to be ordered, and a float inequality holds when it is not.
+static void setFlag(Jit* jit, int cc, int floatEquality) {
+    byte(jit, 0x0f);
+    byte(jit, 0x90 + cc);
+    byte(jit, 0xc0);                                                // setcc %al
+    if (floatEquality && cc == CC_E) {
+        EMIT(jit, "\x0f\x9b\xc1");                                  // setnp %cl
+        EMIT(jit, "\x20\xc8");                                      // and %cl, %al
+    } else if (floatEquality) {
+        EMIT(jit, "\x0f\x9a\xc1");                                  // setp %cl
+        EMIT(jit, "\x08\xc8");                                      // or %cl, %al
+    }
+    EMIT(jit, "\x0f\xb6\xc0");                                      // movzbl %al, %eax
+}
+
+// Jumps to label if condition cc holds when sense is set, or if it does not.
+static void jumpOn(Jit* jit, int cc, int floatEquality, int sense, int label) {
+    if (!sense) cc ^= 1;
+    if (!floatEquality) {
+        jcc(jit, cc, label);
+    } else if (cc == CC_E) {
+        int unordered = newLabel(jit);
+        jcc(jit, CC_P, unordered);
+        jcc(jit, CC_E, label);
+        bindLabel(jit, unordered);
+    } else {
+        jcc(jit, CC_P, label);
+        jcc(jit, CC_NE, label);
+    }
+}
+
+// idiv faults on a zero divisor and on INT_MIN / -1, so both branch to the
+// error exits the interpreters report instead.
+static void divide(Jit* jit) {
+    int checked = newLabel(jit);
+    EMIT(jit, "\x85\xc9");                                          // test %ecx, %ecx
+    jcc(jit, CC_E, jit->error_labels[ERROR_DIVISION_BY_ZERO]);
+    EMIT(jit, "\x83\xf9\xff");                                      // cmp $-1, %ecx
+    jcc(jit, CC_NE, checked);
+    EMIT(jit, "\x3d"); imm32(jit, 0x80000000u);                     // cmp $INT_MIN, %eax
+    jcc(jit, CC_E, jit->error_labels[ERROR_INTEGER_OVERFLOW]);
+    bindLabel(jit, checked);
+    EMIT(jit, "\x99\xf7\xf9");                                      // cltd; idiv %ecx
+}
+
+static ValueType binary(Jit* jit, Node* node) {
+    operands(jit, node);
+    if (isComparison(node->operation)) {
+        setFlag(jit, compareOperands(jit, node->operation), isFloatEquality(node->operation));
+        return node->value_type;
+    }
+    switch (node->operation) {
+        case OPERATION_ADD_INT:         EMIT(jit, "\x01\xc8"); break;         // add %ecx, %eax
+        case OPERATION_SUBTRACT_INT:    EMIT(jit, "\x29\xc8"); break;         // sub %ecx, %eax
+        case OPERATION_MULTIPLY_INT:    EMIT(jit, "\x0f\xaf\xc1"); break;     // imul %ecx, %eax
+        case OPERATION_DIVIDE_INT:      divide(jit); break;
+        case OPERATION_ADD_FLOAT:       EMIT(jit, "\xf3\x0f\x58\xc1"); break; // addss %xmm1, %xmm0
+        case OPERATION_SUBTRACT_FLOAT:  EMIT(jit, "\xf3\x0f\x5c\xc1"); break; // subss %xmm1, %xmm0
+        case OPERATION_MULTIPLY_FLOAT:  EMIT(jit, "\xf3\x0f\x59\xc1"); break; // mulss %xmm1, %xmm0
+        case OPERATION_DIVIDE_FLOAT:    EMIT(jit, "\xf3\x0f\x5e\xc1"); break; // divss %xmm1, %xmm0
+        default:
+            unsupported(jit, "operator not supported by the JIT");
+            break;
+    }
+    return node->value_type;
+}
+
+static void jumpIf(Jit* jit, Node* condition, int sense, int label);
+
+static void storeVariable(Jit* jit, Node* identifier, ValueType type) {
+    if (type == VALUE_INT) {
+        storeEaxSlot(jit, identifier);
+    } else {
+        storeXmm0Slot(jit, identifier);
+    }
+}
+
+static ValueType expression(Jit* jit, Node* node) {
+    switch (node->type) {
+        case NODE_LITERAL:
+            if (node->as.literal.value.type == VALUE_INT) {
+                loadEaxImmediate(jit, (uint32_t)node->as.literal.value.as.int_value);
+            } else {
+                loadXmm0Immediate(jit, node->as.literal.value.as.float_value);
+            }
+            return node->as.literal.value.type;
+        case NODE_IDENTIFIER:
+            if (node->value_type == VALUE_INT) {
+                loadEaxSlot(jit, node);
+            } else {
+                loadXmm0Slot(jit, node);
+            }
+            return node->value_type;
+        case NODE_ASSIGNMENT: {
+            ValueType type = expression(jit, node->as.assignment.right);
+            storeVariable(jit, node->as.assignment.left, type);
+            return type;
+        }
+        case NODE_UNARY:
+            expression(jit, node->as.unary.operand);
+            if (node->operation == OPERATION_NEGATE_INT) {
+                EMIT(jit, "\xf7\xd8");                              // neg %eax
+            } else if (node->operation == OPERATION_NEGATE_FLOAT) {
+                EMIT(jit, "\x66\x0f\x7e\xc0");                      // movd %xmm0, %eax
+                EMIT(jit, "\x35\x00\x00\x00\x80");                  // xor $0x80000000, %eax
+                EMIT(jit, "\x66\x0f\x6e\xc0");                      // movd %eax, %xmm0
+            } else if (node->operation == OPERATION_NOT_INT) {
+                EMIT(jit, "\x85\xc0");                              // test %eax, %eax
+                setFlag(jit, CC_E, 0);
+            } else if (node->operation == OPERATION_NOT_FLOAT) {
+                EMIT(jit, "\x0f\x57\xc9");                          // xorps %xmm1, %xmm1
+                EMIT(jit, "\x0f\x2e\xc1");                          // ucomiss %xmm1, %xmm0
+                setFlag(jit, CC_E, 1);
+            } else {
+                unsupported(jit, "operator not supported by the JIT");
+            }
+            return node->value_type;
+        case NODE_CONVERT:
+            expression(jit, node->as.unary.operand);
+            if (node->operation == OPERATION_INT_TO_FLOAT) {
+                EMIT(jit, "\xf3\x0f\x2a\xc0");                      // cvtsi2ss %eax, %xmm0
+            } else {
+                EMIT(jit, "\xf3\x0f\x2c\xc0");                      // cvttss2si %xmm0, %eax
+            }
+            return node->value_type;
+        case NODE_BINARY:
+            return binary(jit, node);
+        case NODE_LOGICAL: {
+            int falseLabel = newLabel(jit);
+            int endLabel = newLabel(jit);
+            jumpIf(jit, node, 0, falseLabel);
+            loadEaxImmediate(jit, 1);
+            jmp(jit, endLabel);
+            bindLabel(jit, falseLabel);
+            loadEaxImmediate(jit, 0);
+            bindLabel(jit, endLabel);
+            return VALUE_INT;
+        }
+        case NODE_CALL:
+            unsupported(jit, "function calls are not supported by the JIT");
+            return VALUE_VOID;
+        default:
+            unsupported(jit, "expression not supported by the JIT");
+            return VALUE_VOID;
+    }
+}
+
+// Jumps to label when the condition is true if sense is set, or when it is
+// false. A comparison branches on the flags it sets, and && || ! become jumps
+// around the tests of their operands, so no truth value is computed.
+static void jumpIf(Jit* jit, Node* condition, int sense, int label) {
+    if (condition->type == NODE_LOGICAL) {
+        // The left operand alone decides && when false and || when true.
+        int decided = condition->operation == OPERATION_OR;
+        if (decided == sense) {
+            jumpIf(jit, condition->as.binary.left, sense, label);
+            jumpIf(jit, condition->as.binary.right, sense, label);
+        } else {
+            int skip = newLabel(jit);
+            jumpIf(jit, condition->as.binary.left, decided, skip);
+            jumpIf(jit, condition->as.binary.right, sense, label);
+            bindLabel(jit, skip);
+        }
+    } else if (condition->type == NODE_UNARY &&
+               (condition->operation == OPERATION_NOT_INT || condition->operation == OPERATION_NOT_FLOAT)) {
+        jumpIf(jit, condition->as.unary.operand, !sense, label);
+    } else if (condition->type == NODE_BINARY && isComparison(condition->operation)) {
+        operands(jit, condition);
+        jumpOn(jit, compareOperands(jit, condition->operation), isFloatEquality(condition->operation), sense, label);
+    } else if (expression(jit, condition) == VALUE_INT) {
+        EMIT(jit, "\x85\xc0");                                      // test %eax, %eax
+        jcc(jit, sense ? CC_NE : CC_E, label);
+    } else {
+        EMIT(jit, "\x0f\x57\xc9");                                  // xorps %xmm1, %xmm1
+        EMIT(jit, "\x0f\x2e\xc1");                                  // ucomiss %xmm1, %xmm0
+        jumpOn(jit, CC_NE, 1, sense, label);
+    }
+}
+
+static void storeResult(Jit* jit, ValueType type) {
+    EMIT(jit, "\x41\xc7\x04\x24");                                  // movl $type, (%r12)
+    imm32(jit, (uint32_t)type);
+    if (type == VALUE_INT) {
+        EMIT(jit, "\x41\x89\x44\x24\x04");                          // mov %eax, 4(%r12)
+    } else if (type == VALUE_FLOAT) {
+        EMIT(jit, "\xf3\x41\x0f\x11\x44\x24\x04");                  // movss %xmm0, 4(%r12)
+    }
+}
+
+static void statement(Jit* jit, Node* node) {
+    switch (node->type) {
+        case NODE_EXPRESSION_STATEMENT:
+            expression(jit, node->as.expression_statement.expression);
+            break;
+        case NODE_VARIABLE_DECLARATION: {
+            Node* identifier = node->as.variable_declaration.identifier;
+            if (node->as.variable_declaration.input != -1) {
+                unsupported(jit, "inputs are not supported by the JIT");
+            } else if (node->as.variable_declaration.initializer != NULL) {
+                storeVariable(jit, identifier, expression(jit, node->as.variable_declaration.initializer));
+            } else {
+                EMIT(jit, "\xc7\x83");                              // movl $0, slot(%rbx)
+                imm32(jit, slotOffset(identifier));
+                imm32(jit, 0);
+            }
+            break;
+        }
+        case NODE_IF_STATEMENT: {
+            int elseLabel = newLabel(jit);
+            jumpIf(jit, node->as.if_statement.condition, 0, elseLabel);
+            statement(jit, node->as.if_statement.then_branch);
+            if (node->as.if_statement.else_branch != NULL) {
+                int endLabel = newLabel(jit);
+                jmp(jit, endLabel);
+                bindLabel(jit, elseLabel);
+                statement(jit, node->as.if_statement.else_branch);
+                bindLabel(jit, endLabel);
+            } else {
+                bindLabel(jit, elseLabel);
+            }
+            break;
+        }
+        case NODE_WHILE_STATEMENT: {
+            int loopLabel = newLabel(jit);
+            int exitLabel = newLabel(jit);
+            bindLabel(jit, loopLabel);
+            jumpIf(jit, node->as.while_statement.condition, 0, exitLabel);
+            statement(jit, node->as.while_statement.body);
+            jmp(jit, loopLabel);
+            bindLabel(jit, exitLabel);
+            break;
+        }
+        case NODE_BLOCK:
+            for (int i = 0; i < node->as.block.statement_count; i++) {
+                statement(jit, node->as.block.statements[i]);
+            }
+            break;
+        case NODE_RETURN_STATEMENT: {
+            ValueType type = VALUE_VOID;
+            if (node->as.return_statement.expression != NULL) {
+                type = expression(jit, node->as.return_statement.expression);
+            }
+            storeResult(jit, type);
+            jmp(jit, jit->exit_label);
+            break;
+        }
+        case NODE_FUNCTION_DECLARATION:
+            // Skipped, since the JIT rejects calls and so never runs a function.
+            break;
+        default:
+            unsupported(jit, "statement not supported by the JIT");
+            break;
+    }
+}
+
+int compileJit(Node* program, JitProgram* result, const char** reason) {
+    result->code = NULL;
+    result->size = 0;
+    result->frame_size = program->as.program.frame_size;
+
+#if !defined(__x86_64__)
+    *reason = "the JIT only targets x86-64";
+    return 0;
+#else
+    Jit jit;
+    memset(&jit, 0, sizeof(jit));
+    jit.exit_label = newLabel(&jit);
+    int returnLabel = newLabel(&jit);
+    jit.error_labels[ERROR_DIVISION_BY_ZERO] = newLabel(&jit);
+    jit.error_labels[ERROR_INTEGER_OVERFLOW] = newLabel(&jit);
+    EMIT(&jit, "\x55");                                         // push %rbp
+    EMIT(&jit, "\x48\x89\xe5");                                 // mov %rsp, %rbp
+    EMIT(&jit, "\x53");                                         // push %rbx
+    EMIT(&jit, "\x41\x54");                                     // push %r12
+    EMIT(&jit, "\x48\x89\xfb");                                 // mov %rdi, %rbx
+    EMIT(&jit, "\x49\x89\xf4");                                 // mov %rsi, %r12
+    for (int i = 0; i < program->as.program.declaration_count; i++) {
+        statement(&jit, program->as.program.declarations[i]);
+    }
+    storeResult(&jit, VALUE_VOID);
+    bindLabel(&jit, jit.exit_label);
+    EMIT(&jit, "\x31\xc0");                                     // xor %eax, %eax
+    bindLabel(&jit, returnLabel);
+    EMIT(&jit, "\x48\x8d\x65\xf0");                             // lea -16(%rbp), %rsp
+    EMIT(&jit, "\x41\x5c");                                     // pop %r12
+    EMIT(&jit, "\x5b");                                         // pop %rbx
+    EMIT(&jit, "\x5d");                                         // pop %rbp
+    EMIT(&jit, "\xc3");                                         // ret
+    for (int error = ERROR_DIVISION_BY_ZERO; error <= ERROR_INTEGER_OVERFLOW; error++) {
+        bindLabel(&jit, jit.error_labels[error]);
+        loadEaxImmediate(&jit, (uint32_t)error);
+        jmp(&jit, returnLabel);
+    }
+    resolveFixups(&jit);
+
+    // Code is written while the mapping is writable and only then made
+    // executable, so no page is ever writable and executable at once.
+    if (jit.unsupported == NULL) {
+        void* memory = mmap(NULL, jit.count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            unsupported(&jit, "could not map memory for generated code");
+        } else {
+            memcpy(memory, jit.code, jit.count);
+            if (mprotect(memory, jit.count, PROT_READ | PROT_EXEC) != 0) {
+                munmap(memory, jit.count);
+                unsupported(&jit, "could not make generated code executable");
+            } else {
+                result->code = memory;
+                result->size = jit.count;
+            }
+        }
+    }
+
+    free(jit.code);
+    free(jit.labels);
+    free(jit.fixups);
+    *reason = jit.unsupported;
+    return jit.unsupported == NULL;
+#endif
+}
+
+Value runJit(JitProgram* jit, const char** error) {
+    int32_t* slots = calloc(jit->frame_size > 0 ? jit->frame_size : 1, sizeof(int32_t));
+    Value result = {VALUE_VOID, {0}};
+    JitEntry entry;
+    memcpy(&entry, &jit->code, sizeof(entry));
+    *error = runtimeErrors[entry(slots, &result)];
+    free(slots);
+    return result;
+}
+
+void freeJit(JitProgram* jit) {
+    if (jit->code != NULL) munmap(jit->code, jit->size);
+    jit->code = NULL;
+    jit->size = 0;
+}
@@ -0,0 +1,22 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stddef.h>
+#include "parser.h"
+
+typedef struct {
+    unsigned char* code;    // Read-only, executable mapping
+    size_t size;
+    int frame_size;
+} JitProgram;
+
+// Translates a resolved program straight to x86-64 machine code in memory.
+// Returns 0 without printing anything if the program uses something the JIT
+// cannot translate; *reason then says what, and the caller should run the
+// program on an interpreter instead.
+int compileJit(Node* program, JitProgram* jit, const char** reason);
+// Sets *error to the runtime error message, or NULL if the program finished.
+Value runJit(JitProgram* jit, const char** error);
+void freeJit(JitProgram* jit);
+
+#endif
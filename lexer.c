@@ -4,17 +4,105 @@
 #include "lexer.h"
 #include "token.h"
 
-void initLexer(Lexer *lexer, const char *source)
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_SCAN 1
+#endif
+
+#define CHAR_BLANK   1      // ' ', '\t', '\r'
+#define CHAR_NEWLINE 2
+#define CHAR_DIGIT   4
+#define CHAR_ALPHA   8      // Letters and '_'
+#define CHAR_COMMENT 16     // Anything but '\n' and '\0'
+#define CHAR_IDENT   (CHAR_DIGIT | CHAR_ALPHA)
+
+// Character classes for the fast paths. Unlike isalpha/isdigit this does not
+// depend on the C locale; bytes >= 0x80 are never part of a token.
+static const unsigned char charClass[256] = {
+     0, 16, 16, 16, 16, 16, 16, 16, 16, 17,  2, 16, 16, 17, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    17, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 16, 16, 16, 16, 16, 16,
+    16, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24,
+    24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 16, 16, 16, 16, 24,
+    16, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24,
+    24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+};
+
+LexerMode bestLexerMode(void)
+{
+#if defined(HAVE_AVX2_SCAN)
+    if(__builtin_cpu_supports("avx2")) return LEXER_AVX2;
+#endif
+#if defined(__SSE2__)
+    return LEXER_SSE2;
+#else
+    return LEXER_TABLE;
+#endif
+}
+
+void initLexer(Lexer *lexer, const char *source, Interner *interner)
 {
     lexer->start = source;
     lexer->current = source;
+    lexer->end = source + strlen(source);
     lexer->line = 1;
     lexer->column = 1;
+    lexer->source = NULL;
+    lexer->mode = bestLexerMode();
+    lexer->interner = interner;
+}
+
+void initLexerSource(Lexer *lexer, Source *source, Interner *interner)
+{
+    lexer->start = source->data;
+    lexer->current = source->data;
+    lexer->end = source->data + source->length;
+    lexer->line = 1;
+    lexer->column = 1;
+    lexer->source = source;
+    lexer->mode = bestLexerMode();
+    lexer->interner = interner;
+}
+
+// Streamed sources grow in place, so refilling only moves end; tokens
+// already handed out stay valid.
+static int refill(Lexer *lexer)
+{
+    if(lexer->source == NULL || !fillSource(lexer->source)) return 0;
+    lexer->end = lexer->source->data + lexer->source->length;
+    return 1;
+}
+
+static char peek(Lexer *lexer)
+{
+    if(lexer->current >= lexer->end && !refill(lexer)) return '\0';
+    return *lexer->current;
+}
+
+static char peekNext(Lexer *lexer)
+{
+    while(lexer->current + 1 >= lexer->end)
+    {
+        if(!refill(lexer)) return '\0';
+    }
+    return lexer->current[1];
 }
 
 static int isAtEnd(Lexer *lexer)
 {
-    return *lexer->current == '\0';
+    return peek(lexer) == '\0';
 }
 
 static char advance(Lexer *lexer)
@@ -27,7 +115,7 @@ static char advance(Lexer *lexer)
 static int match(Lexer *lexer, char expected)
 {
     if(isAtEnd(lexer)) return 0;
-    if(*lexer->current != expected) return 0;
+    if(peek(lexer) != expected) return 0;
     lexer->current++;
     lexer->column++;
     return 1;
@@ -38,8 +126,10 @@ static Token makeToken(Lexer *lexer, TokenType type)
     Token token;
     token.type = type;
     token.lexeme = lexer->start;
+    token.length = (int)(lexer->current - lexer->start);
     token.line = lexer->line;
     token.column = lexer->column - (lexer->current - lexer->start);
+    token.symbol = -1;
     return token;
 }
 
@@ -48,16 +138,211 @@ static Token errorToken(Lexer *lexer, const char *message)
     Token token;
     token.type = TOKEN_ERROR;
     token.lexeme = message;
+    token.length = (int)strlen(message);
     token.line = lexer->line;
     token.column = lexer->column;
+    token.symbol = -1;
     return token;
 }
 
+// Run scanners: each returns the first byte in [p, end) that does not
+// continue the run, or end. The vector versions test 16 or 32 bytes at a
+// time and finish the tail with the class table.
+
+typedef enum {
+    RUN_BLANKS,             // ' ', '\t', '\r'
+    RUN_IDENTIFIER,         // Letters, digits and '_'
+    RUN_DIGITS,
+    RUN_LINE,               // Everything up to the next '\n' or '\0'
+    RUN_KIND_COUNT
+} RunKind;
+
+typedef const char *(*RunScanner)(const char *p, const char *end);
+
+static const char *tableBlanks(const char *p, const char *end)
+{
+    while(p < end && (charClass[(unsigned char)*p] & CHAR_BLANK)) p++;
+    return p;
+}
+
+static const char *tableIdentifier(const char *p, const char *end)
+{
+    while(p < end && (charClass[(unsigned char)*p] & CHAR_IDENT)) p++;
+    return p;
+}
+
+static const char *tableDigits(const char *p, const char *end)
+{
+    while(p < end && (charClass[(unsigned char)*p] & CHAR_DIGIT)) p++;
+    return p;
+}
+
+static const char *tableLine(const char *p, const char *end)
+{
+    while(p < end && (charClass[(unsigned char)*p] & CHAR_COMMENT)) p++;
+    return p;
+}
+
+#if defined(__SSE2__)
+// Bytes >= 0x80 are negative as signed chars, so the signed range compares
+// below never accept them.
+static inline __m128i inRange16(__m128i c, char low, char high)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(low - 1)),
+                         _mm_cmplt_epi8(c, _mm_set1_epi8(high + 1)));
+}
+
+static inline __m128i blanks16(__m128i c)
+{
+    return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')),
+                                     _mm_cmpeq_epi8(c, _mm_set1_epi8('\t'))),
+                        _mm_cmpeq_epi8(c, _mm_set1_epi8('\r')));
+}
+
+static inline __m128i identifier16(__m128i c)
+{
+    __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    return _mm_or_si128(_mm_or_si128(inRange16(lower, 'a', 'z'), inRange16(c, '0', '9')),
+                        _mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+}
+
+static inline __m128i comment16(__m128i c)
+{
+    __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('\n')),
+                                _mm_cmpeq_epi8(c, _mm_setzero_si128()));
+    return _mm_xor_si128(stop, _mm_set1_epi8(-1));
+}
+
+#define SSE2_SCANNER(name, classify, tail) \
+    static const char *name(const char *p, const char *end) \
+    { \
+        while(end - p >= 16) \
+        { \
+            __m128i c = _mm_loadu_si128((const __m128i *)p); \
+            unsigned int stop = ~(unsigned int)_mm_movemask_epi8(classify) & 0xffffu; \
+            if(stop) return p + __builtin_ctz(stop); \
+            p += 16; \
+        } \
+        return tail(p, end); \
+    }
+
+SSE2_SCANNER(sse2Blanks, blanks16(c), tableBlanks)
+SSE2_SCANNER(sse2Identifier, identifier16(c), tableIdentifier)
+SSE2_SCANNER(sse2Digits, inRange16(c, '0', '9'), tableDigits)
+SSE2_SCANNER(sse2Line, comment16(c), tableLine)
+#endif
+
+#if defined(HAVE_AVX2_SCAN)
+#define AVX2 __attribute__((target("avx2")))
+
+static inline AVX2 __m256i inRange32(__m256i c, char low, char high)
+{
+    return _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8(low - 1)),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(high + 1), c));
+}
+
+static inline AVX2 __m256i blanks32(__m256i c)
+{
+    return _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')),
+                                           _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\t'))),
+                           _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\r')));
+}
+
+static inline AVX2 __m256i identifier32(__m256i c)
+{
+    __m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+    return _mm256_or_si256(_mm256_or_si256(inRange32(lower, 'a', 'z'), inRange32(c, '0', '9')),
+                           _mm256_cmpeq_epi8(c, _mm256_set1_epi8('_')));
+}
+
+static inline AVX2 __m256i comment32(__m256i c)
+{
+    __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n')),
+                                   _mm256_cmpeq_epi8(c, _mm256_setzero_si256()));
+    return _mm256_xor_si256(stop, _mm256_set1_epi8(-1));
+}
+
+#define AVX2_SCANNER(name, classify, tail) \
+    static AVX2 const char *name(const char *p, const char *end) \
+    { \
+        while(end - p >= 32) \
+        { \
+            __m256i c = _mm256_loadu_si256((const __m256i *)p); \
+            unsigned int stop = ~(unsigned int)_mm256_movemask_epi8(classify); \
+            if(stop) return p + __builtin_ctz(stop); \
+            p += 32; \
+        } \
+        return tail(p, end); \
+    }
+
+AVX2_SCANNER(avx2Blanks, blanks32(c), sse2Blanks)
+AVX2_SCANNER(avx2Identifier, identifier32(c), sse2Identifier)
+AVX2_SCANNER(avx2Digits, inRange32(c, '0', '9'), sse2Digits)
+AVX2_SCANNER(avx2Line, comment32(c), sse2Line)
+#endif
+
+static const RunScanner scanners[][RUN_KIND_COUNT] = {
+    [LEXER_TABLE] = {tableBlanks, tableIdentifier, tableDigits, tableLine},
+#if defined(__SSE2__)
+    [LEXER_SSE2] = {sse2Blanks, sse2Identifier, sse2Digits, sse2Line},
+#endif
+#if defined(HAVE_AVX2_SCAN)
+    [LEXER_AVX2] = {avx2Blanks, avx2Identifier, avx2Digits, avx2Line},
+#endif
+};
+
+static const unsigned char runClass[RUN_KIND_COUNT] = {
+    CHAR_BLANK, CHAR_IDENT, CHAR_DIGIT, CHAR_COMMENT
+};
+
+// Consumes a run within one line, pulling in more input if it reaches the
+// end of what has been read so far. Most runs are a few bytes long, so the
+// first few go through the table and only longer runs reach the scanner.
+static inline void skipRun(Lexer *lexer, RunKind kind)
+{
+    unsigned char mask = runClass[kind];
+    for(;;)
+    {
+        const char *p = lexer->current;
+        const char *end = lexer->end;
+        const char *probe = end - p > 8 ? p + 8 : end;
+        while(p < probe && (charClass[(unsigned char)*p] & mask)) p++;
+        if(p == probe && p < end) p = scanners[lexer->mode][kind](p, end);
+
+        lexer->column += (int)(p - lexer->current);
+        lexer->current = p;
+        if(p < end || !refill(lexer)) return;
+    }
+}
+
+static void skipWhitespaceFast(Lexer *lexer)
+{
+    for(;;)
+    {
+        skipRun(lexer, RUN_BLANKS);
+        char c = peek(lexer);
+        if(c == '\n')
+        {
+            advance(lexer);
+            lexer->line++;
+            lexer->column = 1;
+        }
+        else if(c == '/' && peekNext(lexer) == '/')
+        {
+            skipRun(lexer, RUN_LINE);
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
 static void skipWhitespace(Lexer *lexer)
 {
     for(;;)
     {
-        char c = *lexer->current;
+        char c = peek(lexer);
         switch(c)
         {
             case ' ':
@@ -66,14 +351,14 @@ static void skipWhitespace(Lexer *lexer)
                 advance(lexer);
                 break;
             case '\n':
+                advance(lexer);
                 lexer->line++;
                 lexer->column = 1;
-                advance(lexer);
                 break;
             case '/':
-                if(match(lexer, '/'))
+                if(peekNext(lexer) == '/')
                 {
-                    while(*lexer->current != '\n' && !isAtEnd(lexer)) advance(lexer);
+                    while(peek(lexer) != '\n' && !isAtEnd(lexer)) advance(lexer);
                 }
                 else {
                     return;
@@ -85,54 +370,77 @@ static void skipWhitespace(Lexer *lexer)
     }
 }
 
-static TokenType checkKeyword(Lexer *lexer, int start, int length, const char *rest, TokenType type)
+// Keywords are found with a perfect hash over the first two characters and
+// the length: every keyword lands in its own bucket, so one memcmp decides.
+typedef struct {
+    const char *text;
+    int length;
+    TokenType type;
+} Keyword;
+
+#define KEYWORD_HASH(c0, c1, length) (((unsigned char)(c0) + 2 * (unsigned char)(c1) + (length)) & 15)
+
+static const Keyword keywords[16] = {
+    [KEYWORD_HASH('i', 'n', 3)] = {"int", 3, TOKEN_INT},
+    [KEYWORD_HASH('f', 'l', 5)] = {"float", 5, TOKEN_FLOAT},
+    [KEYWORD_HASH('i', 'f', 2)] = {"if", 2, TOKEN_IF},
+    [KEYWORD_HASH('e', 'l', 4)] = {"else", 4, TOKEN_ELSE},
+    [KEYWORD_HASH('w', 'h', 5)] = {"while", 5, TOKEN_WHILE},
+    [KEYWORD_HASH('r', 'e', 6)] = {"return", 6, TOKEN_RETURN},
+    [KEYWORD_HASH('i', 'n', 5)] = {"input", 5, TOKEN_INPUT},
+};
+
+static TokenType identifierType(Lexer *lexer)
 {
-    if(lexer->current - lexer->start == start + length &&
-       memcmp(lexer->start + start, rest, length) == 0) {
-        return type;
+    int length = (int)(lexer->current - lexer->start);
+    if(length < 2 || length > 6) return TOKEN_IDENTIFIER;
+
+    const Keyword *keyword = &keywords[KEYWORD_HASH(lexer->start[0], lexer->start[1], length)];
+    if(keyword->length == length && memcmp(lexer->start, keyword->text, length) == 0)
+    {
+        return keyword->type;
     }
     return TOKEN_IDENTIFIER;
 }
 
-static TokenType identifierType(Lexer *lexer)
+static Token identifier(Lexer *lexer)
 {
-    switch(lexer->start[0]) {
-        case 'i':
-            if(lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'f': return checkKeyword(lexer, 2, 0, "", TOKEN_IF);
-                    case 'n': return checkKeyword(lexer, 2, 1, "t", TOKEN_INT);
-                }
-            }
-            break;
-        case 'f':
-            if(lexer->current - lexer->start > 1) {
-                switch(lexer->start[1]) {
-                    case 'l': return checkKeyword(lexer, 2, 3, "oat", TOKEN_FLOAT);
-                }
-            }
-            break;
-        case 'r': return checkKeyword(lexer, 1, 5, "eturn", TOKEN_RETURN);
-        case 'w': return checkKeyword(lexer, 1, 4, "hile", TOKEN_WHILE);
-        case 'e': return checkKeyword(lexer, 1, 3, "lse", TOKEN_ELSE);
+    if(lexer->mode == LEXER_SCALAR)
+    {
+        while (isalnum((unsigned char)peek(lexer)) || peek(lexer) == '_') advance(lexer);
     }
-    return TOKEN_IDENTIFIER;
+    else
+    {
+        skipRun(lexer, RUN_IDENTIFIER);
+    }
+    Token token = makeToken(lexer, identifierType(lexer));
+    if(token.type == TOKEN_IDENTIFIER)
+    {
+        token.symbol = internSymbol(lexer->interner, token.lexeme, token.length);
+    }
+    return token;
 }
 
-static Token identifier(Lexer *lexer)
+static void digits(Lexer *lexer)
 {
-    while (isalnum(*lexer->current) || *lexer->current == '_') advance(lexer);
-    return makeToken(lexer, identifierType(lexer));
+    if(lexer->mode == LEXER_SCALAR)
+    {
+        while(isdigit((unsigned char)peek(lexer))) advance(lexer);
+    }
+    else
+    {
+        skipRun(lexer, RUN_DIGITS);
+    }
 }
 
 static Token number(Lexer *lexer)
 {
-    while(isdigit(*lexer->current)) advance(lexer);
+    digits(lexer);
 
-    if(*lexer->current == '.' && isdigit(lexer->current[1]))
+    if(peek(lexer) == '.' && (charClass[(unsigned char)peekNext(lexer)] & CHAR_DIGIT))
     {
         advance(lexer);
-        while(isdigit(*lexer->current)) advance(lexer);
+        digits(lexer);
         return makeToken(lexer, TOKEN_FLOAT_LITERAL);
     }
     return makeToken(lexer, TOKEN_INTEGER_LITERAL);
@@ -140,15 +448,23 @@ static Token number(Lexer *lexer)
 
 Token nextToken(Lexer *lexer)
 {
-    skipWhitespace(lexer);
+    if(lexer->mode == LEXER_SCALAR)
+    {
+        skipWhitespace(lexer);
+    }
+    else
+    {
+        skipWhitespaceFast(lexer);
+    }
     lexer->start = lexer->current;
 
     if(isAtEnd(lexer)) return makeToken(lexer, TOKEN_EOF);
 
     char c = advance(lexer);
+    unsigned char kind = charClass[(unsigned char)c];
 
-    if(isalpha(c) || c == '_') return identifier(lexer);
-    if(isdigit(c)) return number(lexer);
+    if(kind & CHAR_ALPHA) return identifier(lexer);
+    if(kind & CHAR_DIGIT) return number(lexer);
 
     switch(c) {
         case '+': return makeToken(lexer, TOKEN_PLUS);
@@ -1,16 +1,33 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "interner.h"
+#include "source.h"
 #include "token.h"
 
+// How the lexer scans runs of whitespace, comments, identifiers and digits.
+typedef enum {
+    LEXER_SCALAR,       // One character at a time through <ctype.h>
+    LEXER_TABLE,        // Character-class table, one byte at a time
+    LEXER_SSE2,         // 16 bytes at a time
+    LEXER_AVX2          // 32 bytes at a time
+} LexerMode;
+
 typedef struct {
     const char *start;
     const char *current;
+    const char *end;
     int line;
     int column;
+    Source *source;     // Asked for more text when the lexer reaches end; NULL for a plain string
+    LexerMode mode;     // Defaults to bestLexerMode()
+    Interner *interner; // Gives each identifier token its symbol
 } Lexer;
 
-void initLexer(Lexer *lexer, const char *source);
+LexerMode bestLexerMode(void);
+
+void initLexer(Lexer *lexer, const char *source, Interner *interner);
+void initLexerSource(Lexer *lexer, Source *source, Interner *interner);
 Token nextToken(Lexer *lexer);
 
 #endif
@@ -1,62 +1,566 @@
+#include <limits.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "source.h"
 #include "lexer.h"
+#include "tokenbuffer.h"
 #include "parser.h"
+#include "resolver.h"
+#include "typecheck.h"
+#include "optimizer.h"
 #include "interpreter.h"
+#include "compiler.h"
+#include "vm.h"
+#include "codegen.h"
+#include "jit.h"
+#include "driver.h"
+#include "cache.h"
 
-char* readFile(const char* path) {
-    FILE* file = fopen(path, "rb");
-    if (file == NULL) {
-        fprintf(stderr, "Could not open file \"%s\".\n", path);
-        exit(74);
+extern char** environ;
+
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-O0|-O1|-O2] [--tree-walk|--jit] [--input <name>=<value>]... [--profile <stacks>] [--cache] [--stats] [--arena-stats] [--fusion-stats] [-S <asm>] [-o <executable>] <script|->\n",
+            program);
+    fprintf(stderr, "       %s --check [-j <threads>] [--manifest <list|->] [script...]\n", program);
+    exit(64);
+}
+
+static double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static double cpuNow(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+typedef enum {
+    PHASE_READ,
+    PHASE_CACHE,
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_RESOLVE,
+    PHASE_TYPECHECK,
+    PHASE_OPTIMIZE,
+    PHASE_COMPILE,
+    PHASE_RUN,
+    PHASE_COUNT
+} Phase;
+
+// Time spent in each phase, kept only with --stats so a normal run pays one
+// branch per phase.
+typedef struct {
+    int enabled;
+    int ran[PHASE_COUNT];
+    double wall[PHASE_COUNT];
+    double cpu[PHASE_COUNT];
+    double wallStart;
+    double cpuStart;
+    int codeBytes;          // Size of the bytecode or machine code that ran
+    int constantCount;
+} Stats;
+
+static void beginPhase(Stats* stats) {
+    if (!stats->enabled) return;
+    stats->wallStart = now();
+    stats->cpuStart = cpuNow();
+}
+
+static void endPhase(Stats* stats, Phase phase) {
+    if (!stats->enabled) return;
+    stats->wall[phase] += now() - stats->wallStart;
+    stats->cpu[phase] += cpuNow() - stats->cpuStart;
+    stats->ran[phase] = 1;
+}
+
+static void printStats(Stats* stats, TokenBuffer* tokens, Interner* interner, Parser* parser, Node* program,
+                       Arena* arena) {
+    static const char* phaseNames[PHASE_COUNT] = {
+        [PHASE_READ] = "read",
+        [PHASE_CACHE] = "cache",
+        [PHASE_LEX] = "lex",
+        [PHASE_PARSE] = "parse",
+        [PHASE_RESOLVE] = "resolve",
+        [PHASE_TYPECHECK] = "typecheck",
+        [PHASE_OPTIMIZE] = "optimize",
+        [PHASE_COMPILE] = "compile",
+        [PHASE_RUN] = "run",
+    };
+    static const char* nodeNames[NODE_TYPE_COUNT] = {
+        [NODE_PROGRAM] = "program",
+        [NODE_FUNCTION_DECLARATION] = "function declaration",
+        [NODE_VARIABLE_DECLARATION] = "variable declaration",
+        [NODE_TYPE] = "type",
+        [NODE_IDENTIFIER] = "identifier",
+        [NODE_BLOCK] = "block",
+        [NODE_IF_STATEMENT] = "if",
+        [NODE_WHILE_STATEMENT] = "while",
+        [NODE_RETURN_STATEMENT] = "return",
+        [NODE_EXPRESSION_STATEMENT] = "expression statement",
+        [NODE_BINARY] = "binary",
+        [NODE_UNARY] = "unary",
+        [NODE_PRIMARY] = "primary",
+        [NODE_ASSIGNMENT] = "assignment",
+        [NODE_LITERAL] = "literal",
+        [NODE_CALL] = "call",
+        [NODE_CONVERT] = "convert",
+        [NODE_LOGICAL] = "logical",
+        [NODE_VARIABLE_CONSTANT] = "variable op constant",
+        [NODE_UPDATE] = "update",
+    };
+
+    double wall = 0;
+    double cpu = 0;
+    fprintf(stderr, "stats: %-22s %10s %10s\n", "phase", "wall ms", "cpu ms");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        if (!stats->ran[i]) continue;
+        fprintf(stderr, "stats: %-22s %10.3f %10.3f\n", phaseNames[i], stats->wall[i] * 1e3, stats->cpu[i] * 1e3);
+        wall += stats->wall[i];
+        cpu += stats->cpu[i];
+    }
+    fprintf(stderr, "stats: %-22s %10.3f %10.3f\n", "total", wall * 1e3, cpu * 1e3);
+
+    // A program run from the cache was never lexed or parsed.
+    if (parser != NULL) {
+        fprintf(stderr, "stats: %-22s %10d\n", "tokens", tokens->count);
+        fprintf(stderr, "stats: %-22s %10d\n", "symbols", interner->count);
+        fprintf(stderr, "stats: %-22s %10d\n", "nodes", parser->node_count);
+        for (int i = 0; i < NODE_TYPE_COUNT; i++) {
+            if (parser->node_counts[i] == 0) continue;
+            fprintf(stderr, "stats:   %-20s %10d\n", nodeNames[i], parser->node_counts[i]);
+        }
+        if (!parser->hadError) {
+            fprintf(stderr, "stats: %-22s %10d\n", "variables", program->as.program.variable_count);
+            fprintf(stderr, "stats: %-22s %10d\n", "program frame slots", program->as.program.frame_size);
+        }
+        fprintf(stderr, "stats: %-22s %10zu\n", "ast bytes", arena->bytes_used);
+        fprintf(stderr, "stats: %-22s %10zu\n", "ast bytes reserved", arena->bytes_reserved);
+    }
+    if (stats->codeBytes > 0) {
+        fprintf(stderr, "stats: %-22s %10d\n", "code bytes", stats->codeBytes);
+        fprintf(stderr, "stats: %-22s %10d\n", "constants", stats->constantCount);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stderr, "stats: %-22s %10ld\n", "peak rss kb", usage.ru_maxrss);
+}
+
+static void printFusionStats(const char* engine, const long* fused) {
+    static const char* names[FUSED_FORM_COUNT] = {
+        [FUSED_VARIABLE_CONSTANT] = "x op constant",
+        [FUSED_UPDATE] = "x = x op constant",
+        [FUSED_TEST_BRANCH] = "test and branch",
+        [FUSED_COMPARE_BRANCH] = "compare and branch",
+    };
+    for (int i = 0; i < FUSED_FORM_COUNT; i++) {
+        fprintf(stderr, "%s: fused %-18s %ld\n", engine, names[i], fused[i]);
+    }
+}
+
+// The --input name=value arguments, in command line order.
+typedef struct {
+    char** arguments;
+    int count;
+} InputArguments;
+
+// Converts the --input arguments into a value for each of the program's input
+// slots, by index. Every input must be given exactly once, as a number of its
+// declared type.
+static Value* bindInputs(InputSlot* inputs, int inputCount, InputArguments* arguments) {
+    Value* values = malloc((inputCount > 0 ? inputCount : 1) * sizeof(Value));
+    for (int i = 0; i < inputCount; i++) values[i] = (Value){VALUE_VOID, {0}};
+    for (int i = 0; i < arguments->count; i++) {
+        const char* argument = arguments->arguments[i];
+        const char* equals = strchr(argument, '=');
+        int nameLength = (int)(equals - argument);
+        int index = -1;
+        for (int j = 0; j < inputCount; j++) {
+            if ((int)strlen(inputs[j].name) == nameLength && memcmp(inputs[j].name, argument, nameLength) == 0) {
+                index = j;
+            }
+        }
+        if (index == -1) {
+            fprintf(stderr, "The script has no input '%.*s'.\n", nameLength, argument);
+            exit(64);
+        }
+        if (values[index].type != VALUE_VOID) {
+            fprintf(stderr, "Input '%s' is given twice.\n", inputs[index].name);
+            exit(64);
+        }
+
+        char* end;
+        values[index].type = inputs[index].type;
+        if (inputs[index].type == VALUE_FLOAT) {
+            values[index].as.float_value = strtof(equals + 1, &end);
+        } else {
+            long value = strtol(equals + 1, &end, 10);
+            values[index].as.int_value = (int)value;
+            if (value < INT_MIN || value > INT_MAX) end = (char*)equals + 1;
+        }
+        if (end == equals + 1 || *end != '\0') {
+            fprintf(stderr, "Input '%s' needs %s value, not \"%s\".\n", inputs[index].name,
+                    inputs[index].type == VALUE_FLOAT ? "a float" : "an int", equals + 1);
+            exit(64);
+        }
+    }
+    for (int i = 0; i < inputCount; i++) {
+        if (values[i].type == VALUE_VOID) {
+            fprintf(stderr, "Missing --input %s=<value>.\n", inputs[i].name);
+            exit(64);
+        }
+    }
+    return values;
+}
+
+static Value* bindProgramInputs(Node* program, InputArguments* arguments) {
+    InputSlot* inputs = listInputs(program);
+    Value* values = bindInputs(inputs, program->as.program.input_count, arguments);
+    freeInputSlots(inputs, program->as.program.input_count);
+    return values;
+}
+
+// Runs compiled bytecode on the VM, optionally reporting how often each
+// superinstruction ran.
+static Value runChunk(Chunk* chunk, InputArguments* inputArguments, Stats* stats, int fusionStats) {
+    Value* inputs = bindInputs(chunk->inputs, chunk->input_count, inputArguments);
+    beginPhase(stats);
+    VM vm;
+    initVM(&vm);
+    vm.inputs = inputs;
+    Value result = runVM(&vm, chunk);
+    endPhase(stats, PHASE_RUN);
+    if (vm.error != NULL) {
+        fprintf(stderr, "%s\n", vm.error);
+        exit(70);
+    }
+
+    if (fusionStats) printFusionStats("vm", vm.fused);
+    stats->codeBytes = chunk->count;
+    stats->constantCount = chunk->constant_count;
+    freeVM(&vm);
+    free(inputs);
+    return result;
+}
+
+// Compiles the program to bytecode, saving it as the script's cache when
+// cacheKey is set, and runs it.
+static Value runBytecode(Node* program, InputArguments* inputArguments, Stats* stats, int fusionStats,
+                         CacheKey* cacheKey) {
+    beginPhase(stats);
+    Chunk chunk;
+    initChunk(&chunk);
+    if (!compileProgram(program, &chunk, stderr)) exit(65);
+    endPhase(stats, PHASE_COMPILE);
+
+    if (cacheKey != NULL) {
+        beginPhase(stats);
+        writeCache(cacheKey, &chunk);
+        endPhase(stats, PHASE_CACHE);
     }
 
-    fseek(file, 0L, SEEK_END);
-    size_t fileSize = ftell(file);
-    rewind(file);
+    Value result = runChunk(&chunk, inputArguments, stats, fusionStats);
+    freeChunk(&chunk);
+    return result;
+}
+
+// Runs the program as JIT-compiled machine code, then on the bytecode VM so
+// the two can be compared, and reports both timings on stderr. Programs the
+// JIT cannot translate run on the VM alone.
+static Value runJitted(Node* program, InputArguments* inputArguments, Stats* stats) {
+    Stats jitStats = *stats;
+    jitStats.enabled = 1;
+    beginPhase(&jitStats);
+    JitProgram jit;
+    const char* reason;
+    if (!compileJit(program, &jit, &reason)) {
+        fprintf(stderr, "jit: %s; running on the bytecode VM instead\n", reason);
+        return runBytecode(program, inputArguments, stats, 0, NULL);
+    }
+    endPhase(&jitStats, PHASE_COMPILE);
+
+    beginPhase(&jitStats);
+    const char* error;
+    Value result = runJit(&jit, &error);
+    endPhase(&jitStats, PHASE_RUN);
+    if (error != NULL) {
+        fprintf(stderr, "%s\n", error);
+        exit(70);
+    }
+    jitStats.codeBytes = (int)jit.size;
+    jitStats.constantCount = 0;
+    freeJit(&jit);
+
+    Stats vmStats = {.enabled = 1};
+    runBytecode(program, inputArguments, &vmStats, 0, NULL);
+
+    double jitCompile = jitStats.wall[PHASE_COMPILE] - stats->wall[PHASE_COMPILE];
+    double jitRun = jitStats.wall[PHASE_RUN] - stats->wall[PHASE_RUN];
+    fprintf(stderr, "jit: compile %.3f ms, run %.3f ms\n", jitCompile * 1e3, jitRun * 1e3);
+    fprintf(stderr, "vm:  compile %.3f ms, run %.3f ms\n", vmStats.wall[PHASE_COMPILE] * 1e3,
+            vmStats.wall[PHASE_RUN] * 1e3);
+    if (jitRun > 0) {
+        fprintf(stderr, "jit speedup over vm: %.1fx\n", vmStats.wall[PHASE_RUN] / jitRun);
+    }
+    if (stats->enabled) *stats = jitStats;
+    return result;
+}
 
-    char* buffer = (char*)malloc(fileSize + 1);
-    if (buffer == NULL) {
-        fprintf(stderr, "Not enough memory to read \"%s\".\n", path);
+// Runs the program on the tree-walking interpreter while profiling it, then
+// prints the per-line report to stderr and writes the sampled call stacks to
+// stacksPath in the collapsed format flame graph tools read.
+static void runProfiled(Node* program, InputArguments* inputArguments, TokenBuffer* tokens, Source* source,
+                        const char* stacksPath, Stats* stats) {
+    FILE* stacks = fopen(stacksPath, "w");
+    if (stacks == NULL) {
+        fprintf(stderr, "Could not write \"%s\".\n", stacksPath);
         exit(74);
     }
+    Profile profile;
+    initProfile(&profile, tokens->lines[tokens->count - 1] + 1);
+    Value* inputs = bindProgramInputs(program, inputArguments);
+
+    beginPhase(stats);
+    Interpreter interpreter;
+    initInterpreter(&interpreter, program);
+    interpreter.profile = &profile;
+    interpreter.inputs = inputs;
+    startProfiling();
+    interpret(&interpreter, program);
+    stopProfiling(&profile);
+    endPhase(stats, PHASE_RUN);
+    freeInterpreter(&interpreter);
+    free(inputs);
 
-    size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
-    if (bytesRead < fileSize) {
-        fprintf(stderr, "Could not read file \"%s\".\n", path);
+    printProfile(&profile, source->data, source->length, stderr);
+    writeCollapsedStacks(&profile, stacks);
+    fclose(stacks);
+    freeProfile(&profile);
+}
+
+// Writes the program as x86-64 assembly and, if exePath is set, assembles and
+// links it with the system C compiler ($CC, or cc).
+static int compileNative(Node* program, const char* asmPath, const char* exePath) {
+    char tempPath[] = "/tmp/tinycXXXXXX.s";
+    FILE* out;
+    if (asmPath != NULL) {
+        out = fopen(asmPath, "w");
+    } else {
+        int fd = mkstemps(tempPath, 2);
+        out = fd == -1 ? NULL : fdopen(fd, "w");
+        asmPath = tempPath;
+    }
+    if (out == NULL) {
+        fprintf(stderr, "Could not write \"%s\".\n", asmPath);
         exit(74);
     }
 
-    buffer[bytesRead] = '\0';
+    int ok = generateAssembly(program, out);
+    fclose(out);
+    if (!ok) {
+        if (asmPath == tempPath) unlink(tempPath);
+        exit(65);
+    }
+    if (exePath == NULL) return 0;
 
-    fclose(file);
-    return buffer;
+    const char* cc = getenv("CC");
+    if (cc == NULL || cc[0] == '\0') cc = "cc";
+    char* args[] = {(char*)cc, "-o", (char*)exePath, (char*)asmPath, NULL};
+    pid_t pid;
+    int status = -1;
+    if (posix_spawnp(&pid, cc, NULL, NULL, args, environ) == 0) {
+        waitpid(pid, &status, 0);
+    }
+    if (asmPath == tempPath) unlink(tempPath);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Could not assemble and link \"%s\" with %s.\n", exePath, cc);
+        exit(70);
+    }
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <script>\n", argv[0]);
-        exit(64);
+    const char* path = NULL;
+    int treeWalk = 0;
+    int useJit = 0;
+    int arenaStats = 0;
+    int fusionStats = 0;
+    int cache = 0;
+    const char* profilePath = NULL;
+    Stats stats = {0};
+    int optimizeLevel = OPTIMIZE_FOLD;
+    const char* asmPath = NULL;
+    const char* exePath = NULL;
+    int check = 0;
+    int jobs = 0;
+    InputArguments inputArguments = {NULL, 0};
+    FileList files;
+    initFileList(&files);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--check") == 0) {
+            check = 1;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (strncmp(argv[i], "-j", 2) == 0 && argv[i][2] >= '0' && argv[i][2] <= '9') {
+            jobs = atoi(argv[i] + 2);
+        } else if (strcmp(argv[i], "--manifest") == 0 && i + 1 < argc) {
+            check = 1;
+            if (!addManifest(&files, argv[++i], stderr)) exit(74);
+        } else if (strcmp(argv[i], "--tree-walk") == 0) {
+            treeWalk = 1;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            useJit = 1;
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profilePath = argv[++i];
+            treeWalk = 1;
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            if (strchr(argv[++i], '=') == NULL) usage(argv[0]);
+            inputArguments.arguments = realloc(inputArguments.arguments, (inputArguments.count + 1) * sizeof(char*));
+            inputArguments.arguments[inputArguments.count++] = argv[i];
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            cache = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats.enabled = 1;
+        } else if (strcmp(argv[i], "--arena-stats") == 0) {
+            arenaStats = 1;
+        } else if (strcmp(argv[i], "--fusion-stats") == 0) {
+            fusionStats = 1;
+        } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+            asmPath = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            exePath = argv[++i];
+        } else if (strncmp(argv[i], "-O", 2) == 0 && argv[i][2] >= '0' && argv[i][2] <= '2' && argv[i][3] == '\0') {
+            optimizeLevel = argv[i][2] - '0';
+        } else if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0) {
+            addFile(&files, argv[i]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (check) {
+        int status = checkFiles(&files, jobs, stdout);
+        freeFileList(&files);
+        return status;
     }
+    if (files.count != 1) usage(argv[0]);
+    path = files.paths[0];
 
-    char* source = readFile(argv[1]);
+    beginPhase(&stats);
+    Source source;
+    if (!openSource(&source, path, stderr)) exit(74);
+    endPhase(&stats, PHASE_READ);
+
+    // Only bytecode is cached, so only a plain VM run of a named script can
+    // use the cache.
+    CacheKey cacheKey;
+    int useCache = cache && !treeWalk && !useJit && asmPath == NULL && exePath == NULL && strcmp(path, "-") != 0;
+    if (useCache) {
+        beginPhase(&stats);
+        loadSource(&source);
+        initCacheKey(&cacheKey, path, &source, optimizeLevel);
+        CachedProgram cached;
+        int hit = loadCache(&cacheKey, &cached);
+        endPhase(&stats, PHASE_CACHE);
+        if (hit) {
+            printValue(runChunk(&cached.chunk, &inputArguments, &stats, fusionStats));
+            if (stats.enabled) printStats(&stats, NULL, NULL, NULL, NULL, NULL);
+            freeCachedProgram(&cached);
+            freeCacheKey(&cacheKey);
+            closeSource(&source);
+            freeFileList(&files);
+            free(inputArguments.arguments);
+            return 0;
+        }
+    }
+
+    // A streamed source is read while it is lexed.
+    beginPhase(&stats);
+    Interner interner;
+    initInterner(&interner);
 
     Lexer lexer;
-    initLexer(&lexer, source);
+    initLexerSource(&lexer, &source, &interner);
+
+    TokenBuffer tokens;
+    initTokenBuffer(&tokens);
+    tokenize(&tokens, &lexer);
+    endPhase(&stats, PHASE_LEX);
+
+    beginPhase(&stats);
+    Arena arena;
+    initArena(&arena);
 
     Parser parser;
-    initParser(&parser, &lexer);
+    initParser(&parser, &tokens, &arena);
 
     Node* program = parseProgram(&parser);
+    endPhase(&stats, PHASE_PARSE);
+    if (arenaStats) {
+        fprintf(stderr, "ast: %d nodes\n", parser.node_count);
+        printArenaStats(&arena, stderr);
+    }
+    int ok = !parser.hadError;
 
-    Interpreter interpreter;
-    initInterpreter(&interpreter);
+    if (ok) {
+        beginPhase(&stats);
+        ok = resolveProgram(program, stderr);
+        endPhase(&stats, PHASE_RESOLVE);
+    }
+    if (ok) {
+        beginPhase(&stats);
+        ok = typeCheckProgram(program, &arena, stderr);
+        endPhase(&stats, PHASE_TYPECHECK);
+    }
+    if (!ok) {
+        if (stats.enabled) printStats(&stats, &tokens, &interner, &parser, program, &arena);
+        exit(65);
+    }
+    beginPhase(&stats);
+    optimizeProgram(program, optimizeLevel, &arena);
+    endPhase(&stats, PHASE_OPTIMIZE);
 
-    interpret(&interpreter, program);
+    if (asmPath != NULL || exePath != NULL) {
+        beginPhase(&stats);
+        compileNative(program, asmPath, exePath);
+        endPhase(&stats, PHASE_COMPILE);
+    } else if (treeWalk && profilePath != NULL) {
+        runProfiled(program, &inputArguments, &tokens, &source, profilePath, &stats);
+    } else if (treeWalk) {
+        Value* inputs = bindProgramInputs(program, &inputArguments);
+        beginPhase(&stats);
+        Interpreter interpreter;
+        initInterpreter(&interpreter, program);
+        interpreter.inputs = inputs;
+
+        interpret(&interpreter, program);
+        endPhase(&stats, PHASE_RUN);
+        if (fusionStats) printFusionStats("tree-walk", interpreter.fused);
+        freeInterpreter(&interpreter);
+        free(inputs);
+    } else if (useJit) {
+        printValue(runJitted(program, &inputArguments, &stats));
+    } else {
+        printValue(runBytecode(program, &inputArguments, &stats, fusionStats, useCache ? &cacheKey : NULL));
+    }
+    if (useCache) freeCacheKey(&cacheKey);
+    if (stats.enabled) printStats(&stats, &tokens, &interner, &parser, program, &arena);
 
-    // Free allocated memory (implement proper cleanup functions)
-    free(source);
+    freeArena(&arena);
+    freeTokenBuffer(&tokens);
+    freeInterner(&interner);
+    closeSource(&source);
+    freeFileList(&files);
+    free(inputArguments.arguments);
 
     return 0;
 }
@@ -0,0 +1,332 @@
+#include <limits.h>
+#include <string.h>
+#include "optimizer.h"
+
+typedef struct {
+    int level;
+    Arena* arena;
+} Optimizer;
+
+static Node* newNode(Optimizer* optimizer, NodeType type, Token token) {
+    Node* node = arenaAlloc(optimizer->arena, sizeof(Node));
+    node->type = type;
+    node->token = token;
+    node->value_type = VALUE_VOID;
+    node->operation = OPERATION_NONE;
+    return node;
+}
+
+// True for an int literal equal to value, or a float literal with exactly the
+// bits of (float)value, so 0 matches +0.0 but not -0.0.
+static int isConstant(Node* node, int value) {
+    if (node->type != NODE_LITERAL) return 0;
+    Value literal = node->as.literal.value;
+    if (literal.type == VALUE_INT) return literal.as.int_value == value;
+    float wanted = (float)value;
+    return memcmp(&literal.as.float_value, &wanted, sizeof(float)) == 0;
+}
+
+// Whether dropping the expression could change what the program does. Int
+// division can stop the program with a runtime error unless its divisor is a
+// literal other than 0 and -1.
+static int hasSideEffects(Node* node) {
+    switch (node->type) {
+        case NODE_ASSIGNMENT:
+        case NODE_CALL:
+            return 1;
+        case NODE_UNARY:
+        case NODE_CONVERT:
+            return hasSideEffects(node->as.unary.operand);
+        case NODE_BINARY: {
+            Node* divisor = node->as.binary.right;
+            if (node->operation == OPERATION_DIVIDE_INT &&
+                (divisor->type != NODE_LITERAL || isConstant(divisor, 0) || isConstant(divisor, -1))) {
+                return 1;
+            }
+            return hasSideEffects(node->as.binary.left) || hasSideEffects(divisor);
+        }
+        case NODE_LOGICAL:
+            return hasSideEffects(node->as.binary.left) || hasSideEffects(node->as.binary.right);
+        default:
+            return 0;
+    }
+}
+
+static int isTruthy(Value value) {
+    return value.type == VALUE_INT ? value.as.int_value != 0 : value.as.float_value != 0;
+}
+
+// Evaluates an operation on constants exactly as the engines would. Returns 0
+// when it must be left for runtime (int division by zero or overflow).
+static int foldOperation(Operation operation, Value left, Value right, Value* result) {
+    unsigned int a = (unsigned int)left.as.int_value;
+    unsigned int b = (unsigned int)right.as.int_value;
+    result->type = VALUE_INT;
+    switch (operation) {
+        case OPERATION_ADD_INT:      result->as.int_value = (int)(a + b); return 1;
+        case OPERATION_SUBTRACT_INT: result->as.int_value = (int)(a - b); return 1;
+        case OPERATION_MULTIPLY_INT: result->as.int_value = (int)(a * b); return 1;
+        case OPERATION_NEGATE_INT:   result->as.int_value = (int)(0u - a); return 1;
+        case OPERATION_FLOAT_TO_INT: result->as.int_value = floatToInt(left.as.float_value); return 1;
+        case OPERATION_DIVIDE_INT:
+            if (right.as.int_value == 0) return 0;
+            if (left.as.int_value == INT_MIN && right.as.int_value == -1) return 0;
+            result->as.int_value = left.as.int_value / right.as.int_value;
+            return 1;
+        case OPERATION_EQUAL_INT:         result->as.int_value = left.as.int_value == right.as.int_value; return 1;
+        case OPERATION_NOT_EQUAL_INT:     result->as.int_value = left.as.int_value != right.as.int_value; return 1;
+        case OPERATION_LESS_INT:          result->as.int_value = left.as.int_value < right.as.int_value; return 1;
+        case OPERATION_LESS_EQUAL_INT:    result->as.int_value = left.as.int_value <= right.as.int_value; return 1;
+        case OPERATION_GREATER_INT:       result->as.int_value = left.as.int_value > right.as.int_value; return 1;
+        case OPERATION_GREATER_EQUAL_INT: result->as.int_value = left.as.int_value >= right.as.int_value; return 1;
+        case OPERATION_NOT_INT:           result->as.int_value = left.as.int_value == 0; return 1;
+        case OPERATION_EQUAL_FLOAT:
+            result->as.int_value = left.as.float_value == right.as.float_value;
+            return 1;
+        case OPERATION_NOT_EQUAL_FLOAT:
+            result->as.int_value = left.as.float_value != right.as.float_value;
+            return 1;
+        case OPERATION_LESS_FLOAT:
+            result->as.int_value = left.as.float_value < right.as.float_value;
+            return 1;
+        case OPERATION_LESS_EQUAL_FLOAT:
+            result->as.int_value = left.as.float_value <= right.as.float_value;
+            return 1;
+        case OPERATION_GREATER_FLOAT:
+            result->as.int_value = left.as.float_value > right.as.float_value;
+            return 1;
+        case OPERATION_GREATER_EQUAL_FLOAT:
+            result->as.int_value = left.as.float_value >= right.as.float_value;
+            return 1;
+        case OPERATION_NOT_FLOAT:
+            result->as.int_value = left.as.float_value == 0;
+            return 1;
+        default:
+            break;
+    }
+
+    float x = left.as.float_value;
+    float y = right.as.float_value;
+    result->type = VALUE_FLOAT;
+    switch (operation) {
+        case OPERATION_ADD_FLOAT:      result->as.float_value = x + y; return 1;
+        case OPERATION_SUBTRACT_FLOAT: result->as.float_value = x - y; return 1;
+        case OPERATION_MULTIPLY_FLOAT: result->as.float_value = x * y; return 1;
+        case OPERATION_DIVIDE_FLOAT:   result->as.float_value = x / y; return 1;
+        case OPERATION_NEGATE_FLOAT:   result->as.float_value = -x; return 1;
+        case OPERATION_INT_TO_FLOAT:   result->as.float_value = (float)left.as.int_value; return 1;
+        default:                       return 0;
+    }
+}
+
+static Node* makeLiteral(Node* node, Value value) {
+    node->type = NODE_LITERAL;
+    node->operation = OPERATION_NONE;
+    node->as.literal.value = value;
+    return node;
+}
+
+static Node* simplifyBinary(Optimizer* optimizer, Node* node) {
+    Node* left = node->as.binary.left;
+    Node* right = node->as.binary.right;
+
+    switch (node->operation) {
+        case OPERATION_ADD_INT:
+            // Only for ints: -0.0 + 0.0 is +0.0.
+            if (isConstant(right, 0)) return left;
+            if (isConstant(left, 0)) return right;
+            break;
+        case OPERATION_SUBTRACT_INT:
+        case OPERATION_SUBTRACT_FLOAT:
+            if (isConstant(right, 0)) return left;
+            break;
+        case OPERATION_MULTIPLY_INT:
+        case OPERATION_MULTIPLY_FLOAT:
+            if (isConstant(right, 1)) return left;
+            if (isConstant(left, 1)) return right;
+            // Only for ints: x * 0.0 is NaN or -0.0 for some x.
+            if (node->operation == OPERATION_MULTIPLY_INT) {
+                if (isConstant(right, 0) && !hasSideEffects(left)) return right;
+                if (isConstant(left, 0) && !hasSideEffects(right)) return left;
+            }
+            // x*2 -> x+x when x is a plain variable read, exact for int and float.
+            if (isConstant(right, 2) && left->type == NODE_IDENTIFIER) right = left;
+            else if (isConstant(left, 2) && right->type == NODE_IDENTIFIER) left = right;
+            else break;
+            node->operation = node->operation == OPERATION_MULTIPLY_INT ? OPERATION_ADD_INT : OPERATION_ADD_FLOAT;
+            node->token.type = TOKEN_PLUS;
+            node->as.binary.left = left;
+            node->as.binary.right = newNode(optimizer, NODE_IDENTIFIER, right->token);
+            node->as.binary.right->value_type = right->value_type;
+            node->as.binary.right->as.identifier = right->as.identifier;
+            return node;
+        case OPERATION_DIVIDE_INT:
+        case OPERATION_DIVIDE_FLOAT:
+            if (isConstant(right, 1)) return left;
+            break;
+        default:
+            break;
+    }
+    return node;
+}
+
+static Node* truthLiteral(Node* node, int truth) {
+    return makeLiteral(node, (Value){VALUE_INT, {.int_value = truth}});
+}
+
+// A constant left operand either decides && or || or leaves the result to the
+// right operand's truth. A constant right operand that decides it only lets
+// the left go when evaluating the left does nothing else.
+static Node* simplifyLogical(Optimizer* optimizer, Node* node) {
+    Node* left = node->as.binary.left;
+    Node* right = node->as.binary.right;
+    int decider = node->operation == OPERATION_OR;
+    if (left->type == NODE_LITERAL) {
+        int truth = isTruthy(left->as.literal.value);
+        if (truth == decider) return truthLiteral(node, truth);
+        if (right->type == NODE_LITERAL) return truthLiteral(node, isTruthy(right->as.literal.value));
+    } else if (optimizer->level >= OPTIMIZE_ALGEBRAIC && right->type == NODE_LITERAL &&
+               isTruthy(right->as.literal.value) == decider && !hasSideEffects(left)) {
+        return truthLiteral(node, decider);
+    }
+    return node;
+}
+
+static Node* optimizeExpression(Optimizer* optimizer, Node* node) {
+    switch (node->type) {
+        case NODE_BINARY: {
+            node->as.binary.left = optimizeExpression(optimizer, node->as.binary.left);
+            node->as.binary.right = optimizeExpression(optimizer, node->as.binary.right);
+            Node* left = node->as.binary.left;
+            Node* right = node->as.binary.right;
+            Value result;
+            if (left->type == NODE_LITERAL && right->type == NODE_LITERAL &&
+                foldOperation(node->operation, left->as.literal.value, right->as.literal.value, &result)) {
+                return makeLiteral(node, result);
+            }
+            if (optimizer->level >= OPTIMIZE_ALGEBRAIC) {
+                return simplifyBinary(optimizer, node);
+            }
+            return node;
+        }
+        case NODE_LOGICAL:
+            node->as.binary.left = optimizeExpression(optimizer, node->as.binary.left);
+            node->as.binary.right = optimizeExpression(optimizer, node->as.binary.right);
+            return simplifyLogical(optimizer, node);
+        case NODE_UNARY:
+        case NODE_CONVERT: {
+            Node* operand = optimizeExpression(optimizer, node->as.unary.operand);
+            node->as.unary.operand = operand;
+            Value result;
+            if (operand->type == NODE_LITERAL &&
+                foldOperation(node->operation, operand->as.literal.value, operand->as.literal.value, &result)) {
+                return makeLiteral(node, result);
+            }
+            // Only negation undoes itself: !!x is 0 or 1, not x.
+            if (optimizer->level >= OPTIMIZE_ALGEBRAIC && node->type == NODE_UNARY &&
+                operand->type == NODE_UNARY && operand->operation == node->operation &&
+                (node->operation == OPERATION_NEGATE_INT || node->operation == OPERATION_NEGATE_FLOAT)) {
+                return operand->as.unary.operand;
+            }
+            return node;
+        }
+        case NODE_ASSIGNMENT:
+            node->as.assignment.right = optimizeExpression(optimizer, node->as.assignment.right);
+            return node;
+        case NODE_CALL:
+            for (int i = 0; i < node->as.call.argument_count; i++) {
+                node->as.call.arguments[i] = optimizeExpression(optimizer, node->as.call.arguments[i]);
+            }
+            return node;
+        default:
+            return node;
+    }
+}
+
+static Node* emptyBlock(Optimizer* optimizer, Node* node) {
+    Node* block = newNode(optimizer, NODE_BLOCK, node->token);
+    block->as.block.statements = NULL;
+    block->as.block.statement_count = 0;
+    block->as.block.local_count = 0;
+    return block;
+}
+
+static Node* optimizeStatement(Optimizer* optimizer, Node* node);
+
+// Optimizes a statement that must stay a statement, e.g. a loop body.
+static Node* optimizeBranch(Optimizer* optimizer, Node* node) {
+    Node* result = optimizeStatement(optimizer, node);
+    return result != NULL ? result : emptyBlock(optimizer, node);
+}
+
+static void optimizeList(Optimizer* optimizer, Node** statements, int* count) {
+    int kept = 0;
+    for (int i = 0; i < *count; i++) {
+        Node* statement = optimizeStatement(optimizer, statements[i]);
+        if (statement != NULL) statements[kept++] = statement;
+    }
+    *count = kept;
+}
+
+// Returns the replacement for a statement, or NULL if it can be dropped.
+static Node* optimizeStatement(Optimizer* optimizer, Node* node) {
+    switch (node->type) {
+        case NODE_EXPRESSION_STATEMENT:
+            node->as.expression_statement.expression =
+                optimizeExpression(optimizer, node->as.expression_statement.expression);
+            return node;
+        case NODE_VARIABLE_DECLARATION:
+            if (node->as.variable_declaration.initializer != NULL) {
+                node->as.variable_declaration.initializer =
+                    optimizeExpression(optimizer, node->as.variable_declaration.initializer);
+            }
+            return node;
+        case NODE_RETURN_STATEMENT:
+            if (node->as.return_statement.expression != NULL) {
+                node->as.return_statement.expression =
+                    optimizeExpression(optimizer, node->as.return_statement.expression);
+            }
+            return node;
+        case NODE_IF_STATEMENT: {
+            Node* condition = optimizeExpression(optimizer, node->as.if_statement.condition);
+            node->as.if_statement.condition = condition;
+            if (condition->type == NODE_LITERAL) {
+                Node* taken = isTruthy(condition->as.literal.value)
+                    ? node->as.if_statement.then_branch
+                    : node->as.if_statement.else_branch;
+                return taken != NULL ? optimizeStatement(optimizer, taken) : NULL;
+            }
+            node->as.if_statement.then_branch = optimizeBranch(optimizer, node->as.if_statement.then_branch);
+            if (node->as.if_statement.else_branch != NULL) {
+                node->as.if_statement.else_branch = optimizeStatement(optimizer, node->as.if_statement.else_branch);
+            }
+            return node;
+        }
+        case NODE_WHILE_STATEMENT: {
+            Node* condition = optimizeExpression(optimizer, node->as.while_statement.condition);
+            node->as.while_statement.condition = condition;
+            if (condition->type == NODE_LITERAL && !isTruthy(condition->as.literal.value)) {
+                return NULL;
+            }
+            node->as.while_statement.body = optimizeBranch(optimizer, node->as.while_statement.body);
+            return node;
+        }
+        case NODE_BLOCK:
+            optimizeList(optimizer, node->as.block.statements, &node->as.block.statement_count);
+            return node;
+        case NODE_FUNCTION_DECLARATION:
+            optimizeStatement(optimizer, node->as.function_declaration.body);
+            return node;
+        default:
+            return node;
+    }
+}
+
+void optimizeProgram(Node* program, int level, Arena* arena) {
+    if (level <= OPTIMIZE_NONE) return;
+
+    Optimizer optimizer;
+    optimizer.level = level;
+    optimizer.arena = arena;
+    optimizeList(&optimizer, program->as.program.declarations, &program->as.program.declaration_count);
+}
@@ -0,0 +1,19 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "arena.h"
+#include "parser.h"
+
+// Optimization levels accepted by optimizeProgram.
+//   0  leave the tree untouched
+//   1  fold constant subtrees and drop if/while statements whose condition is constant
+//   2  also apply algebraic identities and strength reduction (x*1 -> x, x*2 -> x+x)
+#define OPTIMIZE_NONE 0
+#define OPTIMIZE_FOLD 1
+#define OPTIMIZE_ALGEBRAIC 2
+
+// Rewrites a type-checked program in place. New nodes come from the arena that
+// owns the tree. Every rewrite preserves the engines' int/float semantics.
+void optimizeProgram(Node* program, int level, Arena* arena);
+
+#endif
@@ -1,3 +1,6 @@
+#include <float.h>
+#include <limits.h>
+#include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -9,18 +12,18 @@ static void errorAt(Parser* parser, Token* token, const char* message) {
     if (parser->panicMode) return;
     parser->panicMode = 1;
 
-    fprintf(stderr, "[line %d] Error", token->line);
+    fprintf(parser->errors, "[line %d] Error", token->line);
 
     if (token->type == TOKEN_EOF) {
-        fprintf(stderr, " at end");
+        fprintf(parser->errors, " at end");
     } else if (token->type == TOKEN_ERROR) {
         // Nothing
     } else {
-        fprintf(stderr, " at '%s'", token->lexeme);
+        fprintf(parser->errors, " at '%.*s'", token->length, token->lexeme);
 
     }
 
-    fprintf(stderr, ": %s\n", message);
+    fprintf(parser->errors, ": %s\n", message);
     parser->hadError = 1;
 }
 
@@ -36,13 +39,20 @@ static void advance(Parser* parser) {
     parser->previous = parser->current;
 
     for (;;) {
-        parser->current = nextToken(parser->lexer);
+        parser->current = tokenAt(parser->tokens, ++parser->position);
         if (parser->current.type != TOKEN_ERROR) break;
 
         errorAtCurrent(parser, parser->current.lexeme);
     }
 }
 
+// Type of the token distance places after current, without consuming it.
+static TokenType peekType(Parser* parser, int distance) {
+    int index = parser->position + distance;
+    if (index >= parser->tokens->count) return TOKEN_EOF;
+    return (TokenType)parser->tokens->types[index];
+}
+
 static void consume(Parser* parser, TokenType type, const char* message) {
     if (parser->current.type == type) {
         advance(parser);
@@ -62,24 +72,109 @@ static int match(Parser* parser, TokenType type) {
     return 1;
 }
 
-static Node* createNode(NodeType type) {
-    Node* node = (Node*)malloc(sizeof(Node));
+static Node* createNode(Parser* parser, NodeType type) {
+    Node* node = (Node*)arenaAlloc(parser->arena, sizeof(Node));
     node->type = type;
+    node->token = parser->previous;
+    node->value_type = VALUE_VOID;
+    node->operation = OPERATION_NONE;
+    parser->node_count++;
+    parser->node_counts[type]++;
     return node;
 }
 
+// Child lists are collected on a scratch stack shared by all nesting levels
+// and copied into the arena once their final length is known.
+static void pushScratch(Parser* parser, Node* node) {
+    if (parser->scratch_count == parser->scratch_capacity) {
+        parser->scratch_capacity = parser->scratch_capacity < 64 ? 64 : parser->scratch_capacity * 2;
+        parser->scratch = realloc(parser->scratch, parser->scratch_capacity * sizeof(Node*));
+    }
+    parser->scratch[parser->scratch_count++] = node;
+}
+
+static Node** popScratch(Parser* parser, int base, int* count) {
+    *count = parser->scratch_count - base;
+    parser->scratch_count = base;
+    if (*count == 0) return NULL;
+
+    Node** nodes = arenaAlloc(parser->arena, *count * sizeof(Node*));
+    memcpy(nodes, parser->scratch + base, *count * sizeof(Node*));
+    return nodes;
+}
+
 static Node* expression(Parser* parser);
 static Node* statement(Parser* parser);
 static Node* declaration(Parser* parser);
 
+static Value integerLiteral(Parser* parser, Token* token) {
+    long long value = 0;
+    for (int i = 0; i < token->length; i++) {
+        value = value * 10 + (token->lexeme[i] - '0');
+        if (value > INT_MAX) {
+            error(parser, "Integer literal is too large.");
+            break;
+        }
+    }
+    Value result = {VALUE_INT, {0}};
+    result.as.int_value = (int)value;
+    return result;
+}
+
+static Value floatLiteral(Parser* parser, Token* token) {
+    // Lexemes are not NUL-terminated, so strtod needs its own copy. The text
+    // is converted at double precision and rounded to float exactly once.
+    char buffer[64];
+    char* text = token->length < (int)sizeof(buffer) ? buffer : malloc(token->length + 1);
+    memcpy(text, token->lexeme, token->length);
+    text[token->length] = '\0';
+    double value = strtod(text, NULL);
+    if (text != buffer) free(text);
+
+    if (!isfinite(value) || value > FLT_MAX) {
+        error(parser, "Float literal is too large.");
+        value = 0;
+    }
+    Value result = {VALUE_FLOAT, {0}};
+    result.as.float_value = (float)value;
+    return result;
+}
+
+// The callee's name has just been consumed.
+static Node* call(Parser* parser) {
+    Node* node = createNode(parser, NODE_CALL);
+    node->as.call.function = NULL;
+    node->as.call.tail = 0;
+    advance(parser);
+
+    int base = parser->scratch_count;
+    if (!check(parser, TOKEN_RPAREN)) {
+        do {
+            if (parser->scratch_count - base >= 255) {
+                errorAtCurrent(parser, "Can't have more than 255 arguments.");
+            }
+            pushScratch(parser, expression(parser));
+        } while (match(parser, TOKEN_COMMA));
+    }
+    node->as.call.arguments = popScratch(parser, base, &node->as.call.argument_count);
+    consume(parser, TOKEN_RPAREN, "Expect ')' after arguments.");
+    return node;
+}
+
 static Node* primary(Parser* parser) {
-    if (match(parser, TOKEN_INTEGER_LITERAL) || match(parser, TOKEN_FLOAT_LITERAL)) {
-        Node* node = createNode(NODE_LITERAL);
-        node->token = parser->previous;
+    if (match(parser, TOKEN_INTEGER_LITERAL)) {
+        Node* node = createNode(parser, NODE_LITERAL);
+        node->as.literal.value = integerLiteral(parser, &parser->previous);
+        return node;
+    }
+    if (match(parser, TOKEN_FLOAT_LITERAL)) {
+        Node* node = createNode(parser, NODE_LITERAL);
+        node->as.literal.value = floatLiteral(parser, &parser->previous);
         return node;
     }
     if (match(parser, TOKEN_IDENTIFIER)) {
-        Node* node = createNode(NODE_IDENTIFIER);
+        if (check(parser, TOKEN_LPAREN)) return call(parser);
+        Node* node = createNode(parser, NODE_IDENTIFIER);
         node->token = parser->previous;
         return node;
     }
@@ -88,13 +183,13 @@ static Node* primary(Parser* parser) {
         consume(parser, TOKEN_RPAREN, "Expect ')' after expression.");
         return expr;
     }
-    error(parser, "Expect expression.");
+    errorAtCurrent(parser, "Expect expression.");
     return NULL;
 }
 
 static Node* unary(Parser* parser) {
     if (match(parser, TOKEN_MINUS) || match(parser, TOKEN_BANG)) {
-        Node* node = createNode(NODE_UNARY);
+        Node* node = createNode(parser, NODE_UNARY);
         node->token = parser->previous;
         node->as.unary.operand = unary(parser);
         return node;
@@ -107,7 +202,7 @@ static Node* factor(Parser* parser) {
     Node* node = unary(parser);
 
     while (match(parser, TOKEN_ASTERISK) || match(parser, TOKEN_SLASH)) {
-        Node* newNode = createNode(NODE_BINARY);
+        Node* newNode = createNode(parser, NODE_BINARY);
         newNode->token = parser->previous;
         newNode->as.binary.left = node;
         newNode->as.binary.right = unary(parser);
@@ -121,7 +216,7 @@ static Node* term(Parser* parser) {
     Node* node = factor(parser);
 
     while (match(parser, TOKEN_PLUS) || match(parser, TOKEN_MINUS)) {
-        Node* newNode = createNode(NODE_BINARY);
+        Node* newNode = createNode(parser, NODE_BINARY);
         newNode->token = parser->previous;
         newNode->as.binary.left = node;
         newNode->as.binary.right = factor(parser);
@@ -136,7 +231,7 @@ static Node* comparison(Parser* parser) {
 
     while (match(parser, TOKEN_LESS) || match(parser, TOKEN_LESS_EQUAL) ||
            match(parser, TOKEN_GREATER) || match(parser, TOKEN_GREATER_EQUAL)) {
-        Node* newNode = createNode(NODE_BINARY);
+        Node* newNode = createNode(parser, NODE_BINARY);
         newNode->token = parser->previous;
         newNode->as.binary.left = node;
         newNode->as.binary.right = term(parser);
@@ -150,7 +245,7 @@ static Node* equality(Parser* parser) {
     Node* node = comparison(parser);
 
     while (match(parser, TOKEN_EQUAL_EQUAL) || match(parser, TOKEN_BANG_EQUAL)) {
-        Node* newNode = createNode(NODE_BINARY);
+        Node* newNode = createNode(parser, NODE_BINARY);
         newNode->token = parser->previous;
         newNode->as.binary.left = node;
         newNode->as.binary.right = comparison(parser);
@@ -164,7 +259,7 @@ static Node* logicalAnd(Parser* parser) {
     Node* node = equality(parser);
 
     while (match(parser, TOKEN_AND)) {
-        Node* newNode = createNode(NODE_BINARY);
+        Node* newNode = createNode(parser, NODE_LOGICAL);
         newNode->token = parser->previous;
         newNode->as.binary.left = node;
         newNode->as.binary.right = equality(parser);
@@ -178,7 +273,7 @@ static Node* logicalOr(Parser* parser) {
     Node* node = logicalAnd(parser);
 
     while (match(parser, TOKEN_OR)) {
-        Node* newNode = createNode(NODE_BINARY);
+        Node* newNode = createNode(parser, NODE_LOGICAL);
         newNode->token = parser->previous;
         newNode->as.binary.left = node;
         newNode->as.binary.right = logicalAnd(parser);
@@ -192,7 +287,7 @@ static Node* assignment(Parser* parser) {
     Node* node = logicalOr(parser);
 
     if (match(parser, TOKEN_ASSIGN)) {
-        Node* newNode = createNode(NODE_ASSIGNMENT);
+        Node* newNode = createNode(parser, NODE_ASSIGNMENT);
         newNode->token = parser->previous;
         newNode->as.assignment.left = node;
         newNode->as.assignment.right = assignment(parser);
@@ -207,14 +302,15 @@ static Node* expression(Parser* parser) {
 }
 
 static Node* expressionStatement(Parser* parser) {
-    Node* node = createNode(NODE_EXPRESSION_STATEMENT);
+    Node* node = createNode(parser, NODE_EXPRESSION_STATEMENT);
+    node->token = parser->current;      // Its first token, not the one before it
     node->as.expression_statement.expression = expression(parser);
     consume(parser, TOKEN_SEMICOLON, "Expect ';' after expression.");
     return node;
 }
 
 static Node* ifStatement(Parser* parser) {
-    Node* node = createNode(NODE_IF_STATEMENT);
+    Node* node = createNode(parser, NODE_IF_STATEMENT);
     consume(parser, TOKEN_LPAREN, "Expect '(' after 'if'.");
     node->as.if_statement.condition = expression(parser);
     consume(parser, TOKEN_RPAREN, "Expect ')' after if condition.");
@@ -227,7 +323,7 @@ static Node* ifStatement(Parser* parser) {
 }
 
 static Node* whileStatement(Parser* parser) {
-    Node* node = createNode(NODE_WHILE_STATEMENT);
+    Node* node = createNode(parser, NODE_WHILE_STATEMENT);
     consume(parser, TOKEN_LPAREN, "Expect '(' after 'while'.");
     node->as.while_statement.condition = expression(parser);
     consume(parser, TOKEN_RPAREN, "Expect ')' after while condition.");
@@ -236,23 +332,22 @@ static Node* whileStatement(Parser* parser) {
 }
 
 static Node* block(Parser* parser) {
-    Node* node = createNode(NODE_BLOCK);
-    node->as.block.statements = NULL;
-    node->as.block.statement_count = 0;
+    Node* node = createNode(parser, NODE_BLOCK);
+    node->as.block.local_count = 0;
 
+    int base = parser->scratch_count;
     while (!check(parser, TOKEN_RBRACE) && !check(parser, TOKEN_EOF)) {
-        Node* stmt = declaration(parser);
-        node->as.block.statement_count++;
-        node->as.block.statements = realloc(node->as.block.statements, node->as.block.statement_count * sizeof(Node*));
-        node->as.block.statements[node->as.block.statement_count - 1] = stmt;
+        pushScratch(parser, declaration(parser));
     }
+    node->as.block.statements = popScratch(parser, base, &node->as.block.statement_count);
 
     consume(parser, TOKEN_RBRACE, "Expect '}' after block.");
     return node;
 }
 
 static Node* returnStatement(Parser* parser) {
-    Node* node = createNode(NODE_RETURN_STATEMENT);
+    Node* node = createNode(parser, NODE_RETURN_STATEMENT);
+    node->as.return_statement.expression = NULL;
     if (!check(parser, TOKEN_SEMICOLON)) {
         node->as.return_statement.expression = expression(parser);
     }
@@ -269,14 +364,15 @@ static Node* statement(Parser* parser) {
 }
 
 static Node* varDeclaration(Parser* parser) {
-    Node* node = createNode(NODE_VARIABLE_DECLARATION);
-    node->as.variable_declaration.type = createNode(NODE_TYPE);
+    Node* node = createNode(parser, NODE_VARIABLE_DECLARATION);
+    node->as.variable_declaration.type = createNode(parser, NODE_TYPE);
     node->as.variable_declaration.type->token = parser->previous;
 
     consume(parser, TOKEN_IDENTIFIER, "Expect variable name.");
-    node->as.variable_declaration.identifier = createNode(NODE_IDENTIFIER);
+    node->as.variable_declaration.identifier = createNode(parser, NODE_IDENTIFIER);
     node->as.variable_declaration.identifier->token = parser->previous;
 
+    node->as.variable_declaration.input = -1;
     if (match(parser, TOKEN_ASSIGN)) {
         node->as.variable_declaration.initializer = expression(parser);
     } else {
@@ -287,144 +383,144 @@ static Node* varDeclaration(Parser* parser) {
     return node;
 }
 
+// input int x; declares a variable whose value the host supplies for each
+// run, through the input slot with the next index.
+static Node* inputDeclaration(Parser* parser) {
+    Node* node = createNode(parser, NODE_VARIABLE_DECLARATION);
+    node->as.variable_declaration.initializer = NULL;
+    node->as.variable_declaration.input = parser->input_count++;
+    if (match(parser, TOKEN_INT) || match(parser, TOKEN_FLOAT)) {
+        node->as.variable_declaration.type = createNode(parser, NODE_TYPE);
+        node->as.variable_declaration.type->token = parser->previous;
+    } else {
+        node->as.variable_declaration.type = NULL;
+        errorAtCurrent(parser, "Expect input type.");
+    }
+
+    consume(parser, TOKEN_IDENTIFIER, "Expect input name.");
+    node->as.variable_declaration.identifier = createNode(parser, NODE_IDENTIFIER);
+    node->as.variable_declaration.identifier->token = parser->previous;
+
+    consume(parser, TOKEN_SEMICOLON, "Expect ';' after input declaration.");
+    return node;
+}
+
 static Node* funDeclaration(Parser* parser) {
-    Node* node = createNode(NODE_FUNCTION_DECLARATION);
-    node->as.function_declaration.type = createNode(NODE_TYPE);
+    Node* node = createNode(parser, NODE_FUNCTION_DECLARATION);
+    node->as.function_declaration.type = createNode(parser, NODE_TYPE);
     node->as.function_declaration.type->token = parser->previous;
 
     consume(parser, TOKEN_IDENTIFIER, "Expect function name.");
-    node->as.function_declaration.identifier = createNode(NODE_IDENTIFIER);
+    node->as.function_declaration.identifier = createNode(parser, NODE_IDENTIFIER);
     node->as.function_declaration.identifier->token = parser->previous;
 
     consume(parser, TOKEN_LPAREN, "Expect '(' after function name.");
-    node->as.function_declaration.parameters = NULL;
-    node->as.function_declaration.parameter_count = 0;
-
+    int base = parser->scratch_count;
     if (!check(parser, TOKEN_RPAREN)) {
         do {
-            if (node->as.function_declaration.parameter_count >= 255) {
+            if (parser->scratch_count - base >= 255) {
                 error(parser, "Can't have more than 255 parameters.");
             }
-            node->as.function_declaration.parameter_count++;
-            node->as.function_declaration.parameters = realloc(node->as.function_declaration.parameters,
-                                                               node->as.function_declaration.parameter_count * sizeof(Node*));
 
-            Node* param = createNode(NODE_VARIABLE_DECLARATION);
+            Node* param = createNode(parser, NODE_VARIABLE_DECLARATION);
+            param->as.variable_declaration.initializer = NULL;
+            param->as.variable_declaration.input = -1;
             if (match(parser, TOKEN_INT) || match(parser, TOKEN_FLOAT)) {
-                param->as.variable_declaration.type = createNode(NODE_TYPE);
+                param->as.variable_declaration.type = createNode(parser, NODE_TYPE);
                 param->as.variable_declaration.type->token = parser->previous;
             } else {
-                error(parser, "Expect parameter type.");
+                param->as.variable_declaration.type = NULL;
+                errorAtCurrent(parser, "Expect parameter type.");
             }
 
             consume(parser, TOKEN_IDENTIFIER, "Expect parameter name.");
-            param->as.variable_declaration.identifier = createNode(NODE_IDENTIFIER);
+            param->as.variable_declaration.identifier = createNode(parser, NODE_IDENTIFIER);
             param->as.variable_declaration.identifier->token = parser->previous;
 
-            node->as.function_declaration.parameters[node->as.function_declaration.parameter_count - 1] = param;
+            pushScratch(parser, param);
         } while (match(parser, TOKEN_COMMA));
     }
+    node->as.function_declaration.parameters = popScratch(parser, base,
+                                                          &node->as.function_declaration.parameter_count);
     consume(parser, TOKEN_RPAREN, "Expect ')' after parameters.");
     consume(parser, TOKEN_LBRACE, "Expect '{' before function body.");
     node->as.function_declaration.body = block(parser);
+    node->as.function_declaration.frame_size = 0;
+    node->as.function_declaration.index = -1;
     return node;
 }
 
+// Skips to the start of the next statement after an error so parsing can
+// continue and report further errors. Always consumes at least one token when
+// the failed declaration consumed none, so a stray token cannot stall it.
+static void synchronize(Parser* parser, int start) {
+    parser->panicMode = 0;
+    if (parser->position == start && parser->current.type != TOKEN_EOF) advance(parser);
+
+    while (parser->current.type != TOKEN_EOF) {
+        if (parser->previous.type == TOKEN_SEMICOLON) return;
+        switch (parser->current.type) {
+            case TOKEN_INT:
+            case TOKEN_FLOAT:
+            case TOKEN_IF:
+            case TOKEN_WHILE:
+            case TOKEN_RETURN:
+            case TOKEN_INPUT:
+                return;
+            default:
+                advance(parser);
+        }
+    }
+}
+
 static Node* declaration(Parser* parser) {
+    int start = parser->position;
+    Node* node;
     if (match(parser, TOKEN_INT) || match(parser, TOKEN_FLOAT)) {
-        if (check(parser, TOKEN_IDENTIFIER) && parser->lexer->current[0] == '(') {
-            return funDeclaration(parser);
+        if (check(parser, TOKEN_IDENTIFIER) && peekType(parser, 1) == TOKEN_LPAREN) {
+            node = funDeclaration(parser);
         } else {
-            return varDeclaration(parser);
+            node = varDeclaration(parser);
         }
+    } else if (match(parser, TOKEN_INPUT)) {
+        node = inputDeclaration(parser);
+    } else {
+        node = statement(parser);
     }
-    return statement(parser);
+    if (parser->panicMode) synchronize(parser, start);
+    return node;
 }
 
 Node* parseProgram(Parser* parser) {
-    Node* program = createNode(NODE_PROGRAM);
-    program->as.program.declarations = NULL;
-    program->as.program.declaration_count = 0;
+    Node* program = createNode(parser, NODE_PROGRAM);
+    program->as.program.frame_size = 0;
+    program->as.program.variable_count = 0;
+    program->as.program.function_count = 0;
 
     while (!match(parser, TOKEN_EOF)) {
         Node* decl = declaration(parser);
-        if (decl) {
-            program->as.program.declaration_count++;
-            program->as.program.declarations = realloc(program->as.program.declarations,
-                program->as.program.declaration_count * sizeof(Node*));
-            program->as.program.declarations[program->as.program.declaration_count - 1] = decl;
-        }
+        if (decl) pushScratch(parser, decl);
     }
+    program->as.program.declarations = popScratch(parser, 0, &program->as.program.declaration_count);
+    program->as.program.input_count = parser->input_count;
 
+    free(parser->scratch);
+    parser->scratch = NULL;
+    parser->scratch_capacity = 0;
     return program;
 }
 
-void freeAST(Node* node) {
-    if (node == NULL) return;
-
-    switch (node->type) {
-        case NODE_PROGRAM:
-            for (int i = 0; i < node->as.program.declaration_count; i++) {
-                freeAST(node->as.program.declarations[i]);
-            }
-            free(node->as.program.declarations);
-            break;
-        case NODE_FUNCTION_DECLARATION:
-            freeAST(node->as.function_declaration.type);
-            freeAST(node->as.function_declaration.identifier);
-            for (int i = 0; i < node->as.function_declaration.parameter_count; i++) {
-                freeAST(node->as.function_declaration.parameters[i]);
-            }
-            free(node->as.function_declaration.parameters);
-            freeAST(node->as.function_declaration.body);
-            break;
-        case NODE_VARIABLE_DECLARATION:
-            freeAST(node->as.variable_declaration.type);
-            freeAST(node->as.variable_declaration.identifier);
-            freeAST(node->as.variable_declaration.initializer);
-            break;
-        case NODE_BLOCK:
-            for (int i = 0; i < node->as.block.statement_count; i++) {
-                freeAST(node->as.block.statements[i]);
-            }
-            free(node->as.block.statements);
-            break;
-        case NODE_IF_STATEMENT:
-            freeAST(node->as.if_statement.condition);
-            freeAST(node->as.if_statement.then_branch);
-            freeAST(node->as.if_statement.else_branch);
-            break;
-        case NODE_WHILE_STATEMENT:
-            freeAST(node->as.while_statement.condition);
-            freeAST(node->as.while_statement.body);
-            break;
-        case NODE_RETURN_STATEMENT:
-            freeAST(node->as.return_statement.expression);
-            break;
-        case NODE_EXPRESSION_STATEMENT:
-            freeAST(node->as.expression_statement.expression);
-            break;
-        case NODE_BINARY:
-            freeAST(node->as.binary.left);
-            freeAST(node->as.binary.right);
-            break;
-        case NODE_UNARY:
-            freeAST(node->as.unary.operand);
-            break;
-        case NODE_ASSIGNMENT:
-            freeAST(node->as.assignment.left);
-            freeAST(node->as.assignment.right);
-            break;
-        default:
-            // For NODE_LITERAL, NODE_IDENTIFIER, and NODE_TYPE, no additional freeing is needed
-            break;
-    }
-
-    free(node);
-}
-
-void initParser(Parser* parser, Lexer* lexer) {
-    parser->lexer = lexer;
+void initParser(Parser* parser, TokenBuffer* tokens, Arena* arena) {
+    parser->tokens = tokens;
+    parser->position = -1;
+    parser->errors = stderr;
+    parser->arena = arena;
+    parser->scratch = NULL;
+    parser->scratch_count = 0;
+    parser->scratch_capacity = 0;
+    parser->input_count = 0;
+    parser->node_count = 0;
+    for (int i = 0; i < NODE_TYPE_COUNT; i++) parser->node_counts[i] = 0;
     parser->hadError = 0;
     parser->panicMode = 0;
     advance(parser);
@@ -1,7 +1,10 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-#include "lexer.h"
+#include <stdio.h>
+#include "arena.h"
+#include "tokenbuffer.h"
+#include "value.h"
 
 // Node types
 typedef enum {
@@ -19,9 +22,57 @@ typedef enum {
     NODE_UNARY,
     NODE_PRIMARY,
     NODE_ASSIGNMENT,
-    NODE_LITERAL
+    NODE_LITERAL,
+    NODE_CALL,
+    NODE_CONVERT,
+    NODE_LOGICAL,               // && or ||, which skips its right operand when the left decides
+    // Quickened forms the tree-walking interpreter rewrites nodes into the
+    // first time it runs them; no other pass sees them.
+    NODE_VARIABLE_CONSTANT,     // Binary with an identifier left and a literal right
+    NODE_UPDATE,                // Assignment of x op literal to the same x
+    NODE_TYPE_COUNT
 } NodeType;
 
+// Typed operation of an arithmetic, comparison, logical or conversion node,
+// chosen by the type checker so the engines never look at runtime value tags.
+// Comparisons and logical operations produce an int, 1 or 0, whatever the
+// type of their operands.
+typedef enum {
+    OPERATION_NONE,
+    OPERATION_ADD_INT,
+    OPERATION_SUBTRACT_INT,
+    OPERATION_MULTIPLY_INT,
+    OPERATION_DIVIDE_INT,
+    OPERATION_NEGATE_INT,
+    OPERATION_ADD_FLOAT,
+    OPERATION_SUBTRACT_FLOAT,
+    OPERATION_MULTIPLY_FLOAT,
+    OPERATION_DIVIDE_FLOAT,
+    OPERATION_NEGATE_FLOAT,
+    OPERATION_INT_TO_FLOAT,
+    OPERATION_FLOAT_TO_INT,
+    OPERATION_EQUAL_INT,
+    OPERATION_NOT_EQUAL_INT,
+    OPERATION_LESS_INT,
+    OPERATION_LESS_EQUAL_INT,
+    OPERATION_GREATER_INT,
+    OPERATION_GREATER_EQUAL_INT,
+    OPERATION_EQUAL_FLOAT,
+    OPERATION_NOT_EQUAL_FLOAT,
+    OPERATION_LESS_FLOAT,
+    OPERATION_LESS_EQUAL_FLOAT,
+    OPERATION_GREATER_FLOAT,
+    OPERATION_GREATER_EQUAL_FLOAT,
+    OPERATION_NOT_INT,
+    OPERATION_NOT_FLOAT,
+    OPERATION_AND,
+    OPERATION_OR
+} Operation;
+
+static inline int isComparison(Operation operation) {
+    return operation >= OPERATION_EQUAL_INT && operation <= OPERATION_GREATER_EQUAL_FLOAT;
+}
+
 // Forward declaration of Node
 typedef struct Node Node;
 
@@ -29,10 +80,16 @@ typedef struct Node Node;
 struct Node {
     NodeType type;
     Token token;
+    ValueType value_type;   // Static type of an expression, set by the type checker
+    Operation operation;
     union {
         struct {
             Node** declarations;
             int declaration_count;
+            int frame_size;
+            int variable_count;
+            int function_count;
+            int input_count;
         } program;
         struct {
             Node* type;
@@ -40,15 +97,19 @@ struct Node {
             Node** parameters;
             int parameter_count;
             Node* body;
+            int frame_size;     // Slots the function's frame needs, parameters first
+            int index;          // Position among the program's functions
         } function_declaration;
         struct {
             Node* type;
             Node* identifier;
             Node* initializer;
+            int input;          // Host-bound input slot it is read from, or -1
         } variable_declaration;
         struct {
             Node** statements;
             int statement_count;
+            int local_count;
         } block;
         struct {
             Node* condition;
@@ -68,31 +129,52 @@ struct Node {
         struct {
             Node* left;
             Node* right;
-        } binary;
+        } binary;               // Also used by NODE_LOGICAL
         struct {
             Node* operand;
-        } unary;
+        } unary;                // Also used by NODE_CONVERT
         struct {
-            Token value;
+            Value value;    // Decoded once by the parser
         } literal;
+        struct {
+            int depth;      // Scopes between the use and the declaration
+            int slot;       // Offset of the variable in its frame
+            int variable;   // Program-wide index of the declaration
+            int global;     // Slot is in the program's frame, not the current function's
+        } identifier;
         struct {
             Node* left;
             Node* right;
         } assignment;
+        struct {
+            Node** arguments;
+            int argument_count;
+            Node* function;     // Declaration of the callee, set by the resolver
+            int tail;           // Result is returned directly, so the caller's frame can be reused
+        } call;
     } as;
 };
 
 // Parser structure
 typedef struct {
-    Lexer* lexer;
+    TokenBuffer* tokens;
+    int position;       // Index of current in tokens
     Token current;
     Token previous;
     int hadError;
     int panicMode;
+    FILE* errors;       // Where syntax errors are reported; stderr by default
+    Arena* arena;       // Owns every node and child array of the tree
+    Node** scratch;
+    int scratch_count;
+    int scratch_capacity;
+    int input_count;    // Input declarations so far, numbered in source order
+    int node_count;
+    int node_counts[NODE_TYPE_COUNT];   // Nodes created, by type
 } Parser;
 
 // Function prototypes
-void initParser(Parser* parser, Lexer* lexer);
+void initParser(Parser* parser, TokenBuffer* tokens, Arena* arena);
 Node* parseProgram(Parser* parser);
 
 #endif // PARSER_H
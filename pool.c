@@ -0,0 +1,131 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+
+// The indexes a worker has yet to hand out, [next, end). Only the owner takes
+// from the front and thieves take from the back, each under the lock. Parts
+// are cache-line aligned so workers never write to the same line.
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    long next;
+    long end;
+} PoolPart;
+
+typedef struct {
+    PoolPart* parts;
+    int count;
+    long grain;
+    PoolWork work;
+    void* context;
+    atomic_long steals;
+} Pool;
+
+typedef struct {
+    Pool* pool;
+    int index;
+} PoolWorker;
+
+static int take(PoolPart* part, long grain, long* start, long* end) {
+    pthread_mutex_lock(&part->lock);
+    int found = part->next < part->end;
+    if (found) {
+        *start = part->next;
+        *end = part->end - part->next > grain ? part->next + grain : part->end;
+        part->next = *end;
+    }
+    pthread_mutex_unlock(&part->lock);
+    return found;
+}
+
+// Moves the back half of the first part with more than a grain left into the
+// thief's own, empty part. A part with a grain or less is left to its owner,
+// which is already about to take it. Returns 0 once there is nothing to steal,
+// which stays true: parts only ever shrink.
+static int steal(Pool* pool, int thief) {
+    for (int i = 1; i < pool->count; i++) {
+        PoolPart* victim = &pool->parts[(thief + i) % pool->count];
+        pthread_mutex_lock(&victim->lock);
+        long remaining = victim->end - victim->next;
+        if (remaining <= pool->grain) {
+            pthread_mutex_unlock(&victim->lock);
+            continue;
+        }
+        long split = victim->next + remaining / 2;
+        long end = victim->end;
+        victim->end = split;
+        pthread_mutex_unlock(&victim->lock);
+
+        PoolPart* own = &pool->parts[thief];
+        pthread_mutex_lock(&own->lock);
+        own->next = split;
+        own->end = end;
+        pthread_mutex_unlock(&own->lock);
+        atomic_fetch_add(&pool->steals, 1);
+        return 1;
+    }
+    return 0;
+}
+
+static void* worker(void* argument) {
+    PoolWorker* self = argument;
+    Pool* pool = self->pool;
+    long start, end;
+    do {
+        while (take(&pool->parts[self->index], pool->grain, &start, &end)) {
+            pool->work(pool->context, self->index, start, end);
+        }
+    } while (steal(pool, self->index));
+    return NULL;
+}
+
+int runPool(long count, long grain, int jobs, PoolWork work, void* context, long* steals) {
+    if (jobs <= 0) jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (grain < 1) grain = 1;
+    if (jobs > (count + grain - 1) / grain) jobs = (int)((count + grain - 1) / grain);
+    if (jobs < 1) jobs = 1;
+
+    Pool pool;
+    pool.parts = aligned_alloc(_Alignof(PoolPart), jobs * sizeof(PoolPart));
+    PoolWorker* workers = malloc(jobs * sizeof(PoolWorker));
+    pthread_t* threads = malloc(jobs * sizeof(pthread_t));
+    if (pool.parts == NULL || workers == NULL || threads == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(74);
+    }
+    pool.count = jobs;
+    pool.grain = grain;
+    pool.work = work;
+    pool.context = context;
+    atomic_init(&pool.steals, 0);
+    for (int i = 0; i < jobs; i++) {
+        pthread_mutex_init(&pool.parts[i].lock, NULL);
+        pool.parts[i].next = count * i / jobs;
+        pool.parts[i].end = count * (i + 1) / jobs;
+        workers[i].pool = &pool;
+        workers[i].index = i;
+    }
+
+    int started = 0;
+    for (int i = 1; i < jobs; i++) {
+        if (pthread_create(&threads[i], NULL, worker, &workers[i]) != 0) break;
+        started = i;
+    }
+    worker(&workers[0]);
+    // Steals leave the last grain of each part to its owner, so the parts of
+    // workers that could not be started are finished here.
+    long start, end;
+    for (int i = started + 1; i < jobs; i++) {
+        while (take(&pool.parts[i], grain, &start, &end)) work(context, 0, start, end);
+    }
+    for (int i = 1; i <= started; i++) pthread_join(threads[i], NULL);
+
+    for (int i = 0; i < jobs; i++) pthread_mutex_destroy(&pool.parts[i].lock);
+    if (steals != NULL) *steals = atomic_load(&pool.steals);
+    free(threads);
+    free(workers);
+    free(pool.parts);
+    return started + 1;
+}
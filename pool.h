@@ -0,0 +1,17 @@
+#ifndef POOL_H
+#define POOL_H
+
+// Called with a range of indexes [start, end) to process, on the worker
+// numbered worker.
+typedef void (*PoolWork)(void* context, int worker, long start, long end);
+
+// Runs work over every index in [0, count) exactly once, on jobs threads (one
+// per CPU when jobs is 0), the calling thread being worker 0. The range starts
+// out split evenly between the workers, and each takes grain indexes at a
+// time from the front of its own part. A worker whose part runs out steals
+// the back half of another's, so a part that runs slowly is shared out
+// instead of holding up the rest. Returns the number of workers, and stores
+// how many steals there were in *steals if it is not NULL.
+int runPool(long count, long grain, int jobs, PoolWork work, void* context, long* steals);
+
+#endif
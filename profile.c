@@ -0,0 +1,166 @@
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "profile.h"
+
+#define SAMPLE_MICROSECONDS 1000
+
+// Samples taken since the last safe point. The signal handler does nothing
+// else, so the interpreter is never interrupted in the middle of an update.
+static volatile sig_atomic_t pendingSamples;
+
+static void onSample(int signal) {
+    (void)signal;
+    pendingSamples++;
+}
+
+static void* allocateOrDie(void* pointer, size_t size) {
+    void* result = realloc(pointer, size);
+    if (result == NULL) {
+        fprintf(stderr, "Out of memory profiling.\n");
+        exit(74);
+    }
+    return result;
+}
+
+void initProfile(Profile* profile, int line_count) {
+    profile->line_count = line_count;
+    profile->hits = allocateOrDie(NULL, line_count * sizeof(long));
+    profile->samples = allocateOrDie(NULL, line_count * sizeof(long));
+    memset(profile->hits, 0, line_count * sizeof(long));
+    memset(profile->samples, 0, line_count * sizeof(long));
+    profile->sample_count = 0;
+    profile->frames = allocateOrDie(NULL, (FRAMES_MAX + 1) * sizeof(ProfileFrame));
+    profile->frames[0] = (ProfileFrame){NULL, 0};
+    profile->depth = 0;
+    profile->line = 0;
+    initInterner(&profile->stacks);
+    profile->stack_samples = NULL;
+    profile->stack_capacity = 0;
+    profile->key = NULL;
+    profile->key_capacity = 0;
+}
+
+void freeProfile(Profile* profile) {
+    free(profile->hits);
+    free(profile->samples);
+    free(profile->frames);
+    freeInterner(&profile->stacks);
+    free(profile->stack_samples);
+    free(profile->key);
+}
+
+void startProfiling(void) {
+    pendingSamples = 0;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onSample;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, NULL);
+
+    struct itimerval timer = {{0, SAMPLE_MICROSECONDS}, {0, SAMPLE_MICROSECONDS}};
+    setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+static void appendKey(Profile* profile, size_t* length, const char* text, int textLength) {
+    if (*length + textLength + 1 > profile->key_capacity) {
+        size_t capacity = profile->key_capacity < 256 ? 256 : profile->key_capacity;
+        while (*length + textLength + 1 > capacity) capacity *= 2;
+        profile->key = allocateOrDie(profile->key, capacity);
+        profile->key_capacity = capacity;
+    }
+    memcpy(profile->key + *length, text, textLength);
+    *length += textLength;
+}
+
+// Charges the samples taken since the last safe point to the running line
+// and to the stack of calls that led to it.
+static void takeSamples(Profile* profile) {
+    long count = pendingSamples;
+    pendingSamples = 0;
+    if (profile->line < profile->line_count) profile->samples[profile->line] += count;
+    profile->sample_count += count;
+
+    size_t length = 0;
+    char number[16];
+    for (int i = 0; i <= profile->depth; i++) {
+        Node* function = profile->frames[i].function;
+        if (i > 0) appendKey(profile, &length, ";", 1);
+        if (function == NULL) {
+            appendKey(profile, &length, "main", 4);
+        } else {
+            Token* name = &function->as.function_declaration.identifier->token;
+            appendKey(profile, &length, name->lexeme, name->length);
+        }
+        int line = i < profile->depth ? profile->frames[i + 1].line : profile->line;
+        appendKey(profile, &length, number, snprintf(number, sizeof(number), ":%d", line));
+    }
+
+    int stack = internSymbol(&profile->stacks, profile->key, (int)length);
+    if (stack >= profile->stack_capacity) {
+        int capacity = profile->stack_capacity < 64 ? 64 : profile->stack_capacity * 2;
+        profile->stack_samples = allocateOrDie(profile->stack_samples, capacity * sizeof(long));
+        memset(profile->stack_samples + profile->stack_capacity, 0,
+               (capacity - profile->stack_capacity) * sizeof(long));
+        profile->stack_capacity = capacity;
+    }
+    profile->stack_samples[stack] += count;
+}
+
+void stopProfiling(Profile* profile) {
+    struct itimerval timer = {{0, 0}, {0, 0}};
+    setitimer(ITIMER_PROF, &timer, NULL);
+    signal(SIGPROF, SIG_DFL);
+    if (pendingSamples > 0) takeSamples(profile);
+}
+
+void profileStatement(Profile* profile, Node* statement) {
+    if (pendingSamples > 0) takeSamples(profile);
+    profile->line = statement->token.line;
+    if (profile->line < profile->line_count) profile->hits[profile->line]++;
+}
+
+// Time spent evaluating the arguments belongs to the caller's line.
+void profileCall(Profile* profile, Node* function) {
+    if (pendingSamples > 0) takeSamples(profile);
+    profile->depth++;
+    profile->frames[profile->depth] = (ProfileFrame){function, profile->line};
+}
+
+void profileTailCall(Profile* profile, Node* function) {
+    if (pendingSamples > 0) takeSamples(profile);
+    profile->frames[profile->depth].function = function;
+}
+
+void profileReturn(Profile* profile) {
+    if (pendingSamples > 0) takeSamples(profile);
+    profile->line = profile->frames[profile->depth].line;
+    profile->depth--;
+}
+
+void printProfile(Profile* profile, const char* source, size_t length, FILE* out) {
+    fprintf(out, "%6s %12s %9s %7s  %s\n", "line", "hits", "samples", "time", "source");
+
+    const char* start = source;
+    const char* end = source + length;
+    for (int line = 1; line < profile->line_count && start < end; line++) {
+        const char* newline = memchr(start, '\n', end - start);
+        const char* lineEnd = newline != NULL ? newline : end;
+        if (profile->hits[line] > 0 || profile->samples[line] > 0) {
+            double share = profile->sample_count > 0 ? 100.0 * profile->samples[line] / profile->sample_count : 0;
+            fprintf(out, "%6d %12ld %9ld %6.1f%%  %.*s\n", line, profile->hits[line], profile->samples[line], share,
+                    (int)(lineEnd - start), start);
+        }
+        start = lineEnd + 1;
+    }
+    fprintf(out, "%6s %12s %9ld %7s  (%d ms per sample)\n", "total", "", profile->sample_count, "",
+            SAMPLE_MICROSECONDS / 1000);
+}
+
+void writeCollapsedStacks(Profile* profile, FILE* out) {
+    for (int stack = 0; stack < profile->stacks.count; stack++) {
+        fprintf(out, "%s %ld\n", symbolName(&profile->stacks, stack), profile->stack_samples[stack]);
+    }
+}
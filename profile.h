@@ -0,0 +1,58 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include "interner.h"
+#include "parser.h"
+
+// One active call as the profiler sees it: the function, and the line its
+// caller was running when it was called.
+typedef struct {
+    Node* function;         // NULL for the program's own frame
+    int line;
+} ProfileFrame;
+
+// Execution profile of a tree-walking run. Statement executions are counted
+// by line as they happen. Time is sampled: a CPU-time timer signal only bumps
+// a counter, and the next statement, call or return charges the pending
+// samples to the statement that was running and to the call stack above it.
+typedef struct {
+    long* hits;             // Statement executions, by line
+    long* samples;          // Timer samples, by line
+    int line_count;
+    long sample_count;
+    ProfileFrame* frames;   // Shadow of the interpreter's call stack
+    int depth;
+    int line;               // Line of the statement running now
+    Interner stacks;        // Every distinct call stack sampled, collapsed to a string
+    long* stack_samples;    // Samples, by stack symbol
+    int stack_capacity;
+    char* key;              // Scratch space for collapsing a stack
+    size_t key_capacity;
+} Profile;
+
+// line_count is one past the highest line of the script.
+void initProfile(Profile* profile, int line_count);
+void freeProfile(Profile* profile);
+
+// Starts and stops sampling CPU time every millisecond. Only one profile can
+// be sampled at a time.
+void startProfiling(void);
+void stopProfiling(Profile* profile);
+
+// Hooks the interpreter calls while profiling.
+void profileStatement(Profile* profile, Node* statement);
+void profileCall(Profile* profile, Node* function);
+void profileTailCall(Profile* profile, Node* function);
+void profileReturn(Profile* profile);
+
+// Writes hits, samples and the share of time of every line that ran, next to
+// its source text.
+void printProfile(Profile* profile, const char* source, size_t length, FILE* out);
+
+// Writes one line per sampled stack, "main:3;fib:7;fib:5 42", frames from the
+// outermost in, each named by its function and the line it was running. This
+// is the collapsed format flame graph tools read.
+void writeCollapsedStacks(Profile* profile, FILE* out);
+
+#endif
@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "resolver.h"
+
+typedef struct {
+    int symbol;
+    int variable;
+} Binding;
+
+typedef struct Scope {
+    Binding* names;
+    int count;
+    int capacity;
+    int base;               // Frame slot of the scope's first variable
+    struct Scope* enclosing;
+} Scope;
+
+typedef struct {
+    Scope* scope;
+    Scope* globals;         // The program's outermost scope
+    Node* function;         // Function being resolved, or NULL at top level
+    Node** functions;       // Every top-level function, by index
+    int function_count;
+    int frame_size;         // Most slots live at once in the current frame
+    int variable_count;
+    int hadError;
+    FILE* errors;
+} Resolver;
+
+static void report(Resolver* resolver, Token* token, const char* kind, const char* message) {
+    fprintf(resolver->errors, "[line %d] %s at '%.*s': %s\n", token->line, kind, token->length, token->lexeme,
+            message);
+}
+
+static void error(Resolver* resolver, Token* token, const char* message) {
+    report(resolver, token, "Error", message);
+    resolver->hadError = 1;
+}
+
+static int findInScope(Scope* scope, int symbol) {
+    for (int i = scope->count - 1; i >= 0; i--) {
+        if (scope->names[i].symbol == symbol) return i;
+    }
+    return -1;
+}
+
+// Nested blocks continue the enclosing scope's slots; a new frame starts at 0.
+static void beginScope(Resolver* resolver, Scope* scope, int newFrame) {
+    scope->names = NULL;
+    scope->count = 0;
+    scope->capacity = 0;
+    scope->base = 0;
+    if (!newFrame && resolver->scope != NULL) {
+        scope->base = resolver->scope->base + resolver->scope->count;
+    }
+    scope->enclosing = resolver->scope;
+    resolver->scope = scope;
+}
+
+static int endScope(Resolver* resolver) {
+    Scope* scope = resolver->scope;
+    int count = scope->count;
+    free(scope->names);
+    resolver->scope = scope->enclosing;
+    return count;
+}
+
+static void declare(Resolver* resolver, Node* identifier) {
+    Scope* scope = resolver->scope;
+    Token* name = &identifier->token;
+
+    if (findInScope(scope, name->symbol) != -1) {
+        error(resolver, name, "Already a variable with this name in this scope.");
+        return;
+    }
+    for (Scope* outer = scope->enclosing; outer != NULL; outer = outer->enclosing) {
+        if (findInScope(outer, name->symbol) != -1) {
+            report(resolver, name, "Warning", "Declaration shadows a variable in an enclosing scope.");
+            break;
+        }
+    }
+
+    if (scope->count == scope->capacity) {
+        scope->capacity = scope->capacity < 8 ? 8 : scope->capacity * 2;
+        scope->names = realloc(scope->names, scope->capacity * sizeof(Binding));
+    }
+    identifier->as.identifier.depth = 0;
+    identifier->as.identifier.global = 0;
+    identifier->as.identifier.slot = scope->base + scope->count;
+    identifier->as.identifier.variable = resolver->variable_count;
+    scope->names[scope->count].symbol = name->symbol;
+    scope->names[scope->count].variable = resolver->variable_count++;
+    scope->count++;
+    if (scope->base + scope->count > resolver->frame_size) {
+        resolver->frame_size = scope->base + scope->count;
+    }
+}
+
+static void resolveName(Resolver* resolver, Node* identifier) {
+    int depth = 0;
+    for (Scope* scope = resolver->scope; scope != NULL; scope = scope->enclosing) {
+        int slot = findInScope(scope, identifier->token.symbol);
+        if (slot != -1) {
+            identifier->as.identifier.depth = depth;
+            // A function sees its own frame plus the program's globals, which
+            // stay in the program's frame.
+            identifier->as.identifier.global = scope == resolver->globals && resolver->function != NULL;
+            identifier->as.identifier.slot = scope->base + slot;
+            identifier->as.identifier.variable = scope->names[slot].variable;
+            return;
+        }
+        depth++;
+    }
+    error(resolver, &identifier->token, "Undefined variable.");
+}
+
+static Node* findFunction(Resolver* resolver, int symbol) {
+    for (int i = 0; i < resolver->function_count; i++) {
+        if (resolver->functions[i]->as.function_declaration.identifier->token.symbol == symbol) {
+            return resolver->functions[i];
+        }
+    }
+    return NULL;
+}
+
+static void resolveCall(Resolver* resolver, Node* call) {
+    Node* function = findFunction(resolver, call->token.symbol);
+    if (function == NULL) {
+        error(resolver, &call->token, "Undefined function.");
+    } else if (function->as.function_declaration.parameter_count != call->as.call.argument_count) {
+        char message[64];
+        snprintf(message, sizeof(message), "Expected %d arguments but got %d.",
+                 function->as.function_declaration.parameter_count, call->as.call.argument_count);
+        error(resolver, &call->token, message);
+    }
+    call->as.call.function = function;
+}
+
+static void resolveNode(Resolver* resolver, Node* node) {
+    if (node == NULL) return;
+
+    switch (node->type) {
+        case NODE_VARIABLE_DECLARATION:
+            if (node->as.variable_declaration.input != -1 && resolver->scope != resolver->globals) {
+                error(resolver, &node->as.variable_declaration.identifier->token,
+                      "Inputs must be declared at the top level.");
+                break;
+            }
+            // The initializer sees the enclosing binding, not the one being declared.
+            resolveNode(resolver, node->as.variable_declaration.initializer);
+            declare(resolver, node->as.variable_declaration.identifier);
+            break;
+        case NODE_FUNCTION_DECLARATION: {
+            if (resolver->scope != resolver->globals) {
+                error(resolver, &node->as.function_declaration.identifier->token,
+                      "Functions must be declared at the top level.");
+                break;
+            }
+            Scope scope;
+            int enclosingFrameSize = resolver->frame_size;
+            resolver->frame_size = 0;
+            resolver->function = node;
+            beginScope(resolver, &scope, 1);
+            for (int i = 0; i < node->as.function_declaration.parameter_count; i++) {
+                resolveNode(resolver, node->as.function_declaration.parameters[i]);
+            }
+            resolveNode(resolver, node->as.function_declaration.body);
+            endScope(resolver);
+            node->as.function_declaration.frame_size = resolver->frame_size;
+            resolver->function = NULL;
+            resolver->frame_size = enclosingFrameSize;
+            break;
+        }
+        case NODE_BLOCK: {
+            Scope scope;
+            beginScope(resolver, &scope, 0);
+            for (int i = 0; i < node->as.block.statement_count; i++) {
+                resolveNode(resolver, node->as.block.statements[i]);
+            }
+            node->as.block.local_count = endScope(resolver);
+            break;
+        }
+        case NODE_IF_STATEMENT:
+            resolveNode(resolver, node->as.if_statement.condition);
+            resolveNode(resolver, node->as.if_statement.then_branch);
+            resolveNode(resolver, node->as.if_statement.else_branch);
+            break;
+        case NODE_WHILE_STATEMENT:
+            resolveNode(resolver, node->as.while_statement.condition);
+            resolveNode(resolver, node->as.while_statement.body);
+            break;
+        case NODE_RETURN_STATEMENT: {
+            Node* value = node->as.return_statement.expression;
+            resolveNode(resolver, value);
+            // A top-level return ends the program, so only returns inside a
+            // function can hand their frame to the callee.
+            if (value != NULL && value->type == NODE_CALL && resolver->function != NULL) {
+                value->as.call.tail = 1;
+            }
+            break;
+        }
+        case NODE_EXPRESSION_STATEMENT:
+            resolveNode(resolver, node->as.expression_statement.expression);
+            break;
+        case NODE_BINARY:
+        case NODE_LOGICAL:
+            resolveNode(resolver, node->as.binary.left);
+            resolveNode(resolver, node->as.binary.right);
+            break;
+        case NODE_UNARY:
+            resolveNode(resolver, node->as.unary.operand);
+            break;
+        case NODE_ASSIGNMENT:
+            resolveNode(resolver, node->as.assignment.right);
+            if (node->as.assignment.left->type != NODE_IDENTIFIER) {
+                error(resolver, &node->token, "Invalid assignment target.");
+                break;
+            }
+            resolveNode(resolver, node->as.assignment.left);
+            break;
+        case NODE_IDENTIFIER:
+            resolveName(resolver, node);
+            break;
+        case NODE_CALL:
+            for (int i = 0; i < node->as.call.argument_count; i++) {
+                resolveNode(resolver, node->as.call.arguments[i]);
+            }
+            resolveCall(resolver, node);
+            break;
+        default:
+            break;
+    }
+}
+
+int resolveProgram(Node* program, FILE* errors) {
+    Resolver resolver;
+    resolver.errors = errors;
+    resolver.scope = NULL;
+    resolver.frame_size = 0;
+    resolver.variable_count = 0;
+    resolver.hadError = 0;
+    resolver.function = NULL;
+    resolver.functions = NULL;
+    resolver.function_count = 0;
+
+    // Functions are visible from the whole program, so calls can come before
+    // the declaration and functions can be mutually recursive.
+    int capacity = 0;
+    for (int i = 0; i < program->as.program.declaration_count; i++) {
+        Node* declaration = program->as.program.declarations[i];
+        if (declaration->type != NODE_FUNCTION_DECLARATION) continue;
+
+        Token* name = &declaration->as.function_declaration.identifier->token;
+        if (findFunction(&resolver, name->symbol) != NULL) {
+            error(&resolver, name, "Already a function with this name.");
+            continue;
+        }
+        if (resolver.function_count == capacity) {
+            capacity = capacity < 8 ? 8 : capacity * 2;
+            resolver.functions = realloc(resolver.functions, capacity * sizeof(Node*));
+        }
+        declaration->as.function_declaration.index = resolver.function_count;
+        resolver.functions[resolver.function_count++] = declaration;
+    }
+
+    Scope globals;
+    beginScope(&resolver, &globals, 1);
+    resolver.globals = &globals;
+    for (int i = 0; i < program->as.program.declaration_count; i++) {
+        resolveNode(&resolver, program->as.program.declarations[i]);
+    }
+    endScope(&resolver);
+    program->as.program.frame_size = resolver.frame_size;
+    program->as.program.variable_count = resolver.variable_count;
+    program->as.program.function_count = resolver.function_count;
+    free(resolver.functions);
+
+    return !resolver.hadError;
+}
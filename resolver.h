@@ -0,0 +1,17 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <stdio.h>
+#include "parser.h"
+
+// Binds every identifier to the (depth, slot) of its declaration, where slot
+// is an offset into the current frame, and records how many slots each block
+// declares and how large the program's frame must be. Each declaration also
+// gets a program-wide variable index that its uses share, for passes that
+// keep per-variable facts. Calls are bound to their function's declaration,
+// and calls whose result is returned directly are marked as tail calls.
+// Undefined names, redeclarations and argument count mismatches are reported
+// to errors, before anything runs. Returns 0 on error.
+int resolveProgram(Node* program, FILE* errors);
+
+#endif
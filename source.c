@@ -0,0 +1,116 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "source.h"
+
+#define SOURCE_CHUNK (1 << 20)
+#define SOURCE_RESERVE ((size_t)1 << 36)
+
+static int openStream(Source* source) {
+    // Reserve address space without backing it; pages become writable one
+    // chunk at a time as input arrives.
+    for (size_t reserve = SOURCE_RESERVE; reserve >= SOURCE_CHUNK; reserve /= 4) {
+        void* region = mmap(NULL, reserve, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (region != MAP_FAILED) {
+            source->data = region;
+            source->reserved = reserve;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int openSource(Source* source, const char* path, FILE* errors) {
+    source->errors = errors;
+    source->data = "";
+    source->length = 0;
+    source->mapped = 0;
+    source->eof = 0;
+    source->reserved = 0;
+    source->committed = 0;
+
+    if (strcmp(path, "-") == 0) {
+        source->fd = STDIN_FILENO;
+    } else {
+        source->fd = open(path, O_RDONLY);
+        if (source->fd == -1) {
+            fprintf(source->errors, "Could not open file \"%s\".\n", path);
+            return 0;
+        }
+    }
+
+    struct stat info;
+    if (fstat(source->fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        source->eof = 1;
+        if (info.st_size == 0) return 1;
+
+        void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, source->fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, info.st_size, MADV_SEQUENTIAL);
+            source->data = data;
+            source->length = info.st_size;
+            source->mapped = 1;
+            return 1;
+        }
+        source->eof = 0;
+    }
+
+    if (!openStream(source)) {
+        fprintf(source->errors, "Not enough memory to read \"%s\".\n", path);
+        closeSource(source);
+        return 0;
+    }
+    return 1;
+}
+
+int fillSource(Source* source) {
+    if (source->eof) return 0;
+
+    char* data = (char*)source->data;
+    if (source->length == source->committed) {
+        if (source->committed + SOURCE_CHUNK > source->reserved ||
+            mprotect(data + source->committed, SOURCE_CHUNK, PROT_READ | PROT_WRITE) != 0) {
+            fprintf(source->errors, "Script is too large to read from a stream.\n");
+            source->eof = 1;
+            return 0;
+        }
+        source->committed += SOURCE_CHUNK;
+    }
+
+    ssize_t count;
+    do {
+        count = read(source->fd, data + source->length, source->committed - source->length);
+    } while (count == -1 && errno == EINTR);
+
+    if (count <= 0) {
+        if (count == -1) fprintf(source->errors, "Could not read script: %s.\n", strerror(errno));
+        source->eof = 1;
+        return 0;
+    }
+    source->length += count;
+    return 1;
+}
+
+void loadSource(Source* source) {
+    while (fillSource(source)) {
+    }
+}
+
+void closeSource(Source* source) {
+    if (source->mapped) {
+        munmap((void*)source->data, source->length);
+    } else if (source->reserved > 0) {
+        munmap((void*)source->data, source->reserved);
+    }
+    if (source->fd > STDIN_FILENO) close(source->fd);
+    source->data = "";
+    source->length = 0;
+    source->mapped = 0;
+    source->reserved = 0;
+    source->committed = 0;
+    source->fd = -1;
+}
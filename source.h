@@ -0,0 +1,33 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Script text, read without an intermediate copy. Regular files are mapped
+// read-only in one piece. Pipes and stdin are read in chunks into a reserved
+// address range, so the text never moves and tokens can keep pointing into
+// it while more input arrives.
+typedef struct {
+    const char* data;
+    size_t length;          // Bytes available so far
+    int fd;
+    int mapped;             // data is a read-only mapping of the whole file
+    int eof;                // Everything has been read
+    size_t reserved;        // Address space reserved for a stream
+    size_t committed;       // Part of the reservation that is writable
+    FILE* errors;           // Where I/O errors are reported
+} Source;
+
+// Opens path, or stdin for "-". Returns 0 and reports to errors on failure.
+int openSource(Source* source, const char* path, FILE* errors);
+
+// Reads the next chunk of a stream. Returns 0 once there is no more input.
+int fillSource(Source* source);
+
+// Reads the rest of a stream, for callers that need the whole text at once.
+void loadSource(Source* source);
+
+void closeSource(Source* source);
+
+#endif
@@ -0,0 +1,315 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "columns.h"
+#include "compiler.h"
+#include "interner.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "pool.h"
+#include "resolver.h"
+#include "source.h"
+#include "tinyc.h"
+#include "tokenbuffer.h"
+#include "typecheck.h"
+#include "vm.h"
+
+// Records a worker takes at a time in tinycRunRecords: enough that taking them
+// costs little next to running them, few enough to even out the threads' loads.
+#define RECORD_GRAIN 256
+
+// Scripts run on the bytecode VM: once compiled, a chunk is only read, so
+// one script can run on many contexts at once. The chunk is sealed read-only
+// to hold every engine to that. The tree-walker rewrites nodes as it runs
+// them and could not be shared that way. Scripts that can also
+// run over columns keep their column program next to the chunk.
+struct TinycScript {
+    Chunk chunk;
+    ColumnProgram columns;
+    const char* columns_unsupported;    // Why the script cannot run over columns, or NULL
+};
+
+struct TinycContext {
+    VM vm;
+    ColumnMode column_mode;
+    char message[96];       // Error text that names a record
+};
+
+static void* allocOrDie(size_t size) {
+    void* result = malloc(size);
+    if (result == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(74);
+    }
+    return result;
+}
+
+// Runs every phase from lexing to bytecode on a lexer that is ready to go,
+// reporting to errors.
+static TinycStatus compileLexer(Lexer* lexer, int optimizeLevel, TinycScript** script, FILE* errors) {
+    TokenBuffer tokens;
+    initTokenBuffer(&tokens);
+    tokenize(&tokens, lexer);
+
+    Arena arena;
+    initArena(&arena);
+
+    Parser parser;
+    initParser(&parser, &tokens, &arena);
+    parser.errors = errors;
+
+    TinycStatus status = TINYC_COMPILE_ERROR;
+    Node* program = parseProgram(&parser);
+    if (!parser.hadError && resolveProgram(program, errors) && typeCheckProgram(program, &arena, errors)) {
+        optimizeProgram(program, optimizeLevel, &arena);
+        TinycScript* compiled = allocOrDie(sizeof(TinycScript));
+        initChunk(&compiled->chunk);
+        compileColumns(program, &compiled->columns, &compiled->columns_unsupported);
+        if (compileProgram(program, &compiled->chunk, errors)) {
+            sealChunk(&compiled->chunk);
+            *script = compiled;
+            status = TINYC_OK;
+        } else {
+            tinycFreeScript(compiled);
+        }
+    }
+
+    freeArena(&arena);
+    freeTokenBuffer(&tokens);
+    return status;
+}
+
+// Diagnostics are collected in memory and handed to the caller, or dropped
+// if the caller did not ask for them.
+static FILE* openErrors(char** text, size_t* length) {
+    FILE* errors = open_memstream(text, length);
+    if (errors == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(74);
+    }
+    return errors;
+}
+
+// The stream only fills in text and length when it is closed.
+static void closeErrors(FILE* stream, char** text, size_t* length, char** errors) {
+    fclose(stream);
+    if (errors != NULL && *length > 0) {
+        *errors = *text;
+    } else {
+        free(*text);
+    }
+}
+
+TinycStatus tinycCompile(const char* source, size_t length, int optimizeLevel, TinycScript** script,
+                         char** errors) {
+    *script = NULL;
+    if (errors != NULL) *errors = NULL;
+    if (optimizeLevel < OPTIMIZE_NONE || optimizeLevel > OPTIMIZE_ALGEBRAIC) return TINYC_USAGE_ERROR;
+
+    // The lexer reads up to a terminating NUL.
+    char* text = allocOrDie(length + 1);
+    memcpy(text, source, length);
+    text[length] = '\0';
+
+    char* diagnostics = NULL;
+    size_t diagnosticsLength = 0;
+    FILE* stream = openErrors(&diagnostics, &diagnosticsLength);
+
+    Interner interner;
+    initInterner(&interner);
+    Lexer lexer;
+    initLexer(&lexer, text, &interner);
+    TinycStatus status = compileLexer(&lexer, optimizeLevel, script, stream);
+    freeInterner(&interner);
+
+    closeErrors(stream, &diagnostics, &diagnosticsLength, errors);
+    free(text);
+    return status;
+}
+
+TinycStatus tinycCompileFile(const char* path, int optimizeLevel, TinycScript** script, char** errors) {
+    *script = NULL;
+    if (errors != NULL) *errors = NULL;
+    if (optimizeLevel < OPTIMIZE_NONE || optimizeLevel > OPTIMIZE_ALGEBRAIC) return TINYC_USAGE_ERROR;
+
+    char* diagnostics = NULL;
+    size_t diagnosticsLength = 0;
+    FILE* stream = openErrors(&diagnostics, &diagnosticsLength);
+
+    Source source;
+    if (!openSource(&source, path, stream)) {
+        closeErrors(stream, &diagnostics, &diagnosticsLength, errors);
+        return TINYC_IO_ERROR;
+    }
+    Interner interner;
+    initInterner(&interner);
+    Lexer lexer;
+    initLexerSource(&lexer, &source, &interner);
+    TinycStatus status = compileLexer(&lexer, optimizeLevel, script, stream);
+    freeInterner(&interner);
+
+    closeSource(&source);
+    closeErrors(stream, &diagnostics, &diagnosticsLength, errors);
+    return status;
+}
+
+void tinycFreeScript(TinycScript* script) {
+    if (script == NULL) return;
+    freeChunk(&script->chunk);
+    freeColumns(&script->columns);
+    free(script);
+}
+
+int tinycInputCount(const TinycScript* script) {
+    return script->chunk.input_count;
+}
+
+int tinycInputIndex(const TinycScript* script, const char* name) {
+    for (int i = 0; i < script->chunk.input_count; i++) {
+        if (strcmp(script->chunk.inputs[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+ValueType tinycInputType(const TinycScript* script, int index) {
+    return script->chunk.inputs[index].type;
+}
+
+TinycContext* tinycNewContext(void) {
+    TinycContext* context = allocOrDie(sizeof(TinycContext));
+    initVM(&context->vm);
+    context->column_mode = bestColumnMode();
+    return context;
+}
+
+void tinycFreeContext(TinycContext* context) {
+    if (context == NULL) return;
+    freeVM(&context->vm);
+    free(context);
+}
+
+void tinycBindInputs(TinycContext* context, const Value* inputs) {
+    context->vm.inputs = inputs;
+}
+
+// Records handed to the worker threads of one tinycRunRecords call.
+typedef struct {
+    const TinycScript* script;
+    const Value* records;
+    Value* results;
+    VM* vms;                // One per worker
+    atomic_long failed;     // Lowest record that failed so far, or the record count
+    const char* error;      // Its error, under lock
+    pthread_mutex_t lock;
+} RecordRun;
+
+static void runRecordRange(void* argument, int worker, long start, long end) {
+    RecordRun* run = argument;
+    VM* vm = &run->vms[worker];
+    int inputCount = run->script->chunk.input_count;
+    // Records after one that already failed need not run, but every record
+    // before it must, so the failure reported is the first.
+    for (long i = start; i < end && i < atomic_load(&run->failed); i++) {
+        vm->inputs = run->records + i * inputCount;
+        run->results[i] = runVM(vm, &run->script->chunk);
+        if (vm->error == NULL) continue;
+
+        pthread_mutex_lock(&run->lock);
+        if (i < atomic_load(&run->failed)) {
+            atomic_store(&run->failed, i);
+            run->error = vm->error;
+        }
+        pthread_mutex_unlock(&run->lock);
+        return;
+    }
+}
+
+TinycStatus tinycRunRecords(TinycContext* context, const TinycScript* script, const Value* records, long count,
+                            Value* results, int threads) {
+    const Chunk* chunk = &script->chunk;
+    context->vm.error = NULL;
+    for (long i = 0; i < count * chunk->input_count; i++) {
+        if (records[i].type != chunk->inputs[i % chunk->input_count].type) {
+            snprintf(context->message, sizeof(context->message), "Record %ld: Input has the wrong type.",
+                     i / chunk->input_count);
+            context->vm.error = context->message;
+            return TINYC_USAGE_ERROR;
+        }
+    }
+
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    RecordRun run;
+    run.script = script;
+    run.records = records;
+    run.results = results;
+    run.vms = allocOrDie(threads * sizeof(VM));
+    for (int i = 0; i < threads; i++) initVM(&run.vms[i]);
+    atomic_init(&run.failed, count);
+    run.error = NULL;
+    pthread_mutex_init(&run.lock, NULL);
+
+    runPool(count, RECORD_GRAIN, threads, runRecordRange, &run, NULL);
+
+    for (int i = 0; i < threads; i++) freeVM(&run.vms[i]);
+    free(run.vms);
+    pthread_mutex_destroy(&run.lock);
+    if (run.error == NULL) return TINYC_OK;
+    snprintf(context->message, sizeof(context->message), "Record %ld: %s", atomic_load(&run.failed), run.error);
+    context->vm.error = context->message;
+    return TINYC_RUNTIME_ERROR;
+}
+
+TinycStatus tinycRun(TinycContext* context, const TinycScript* script, Value* result) {
+    // The VM trusts every input to have its declared type, so check here.
+    const Chunk* chunk = &script->chunk;
+    if (chunk->input_count > 0 && context->vm.inputs == NULL) {
+        context->vm.error = "Inputs are not bound.";
+        return TINYC_USAGE_ERROR;
+    }
+    for (int i = 0; i < chunk->input_count; i++) {
+        if (context->vm.inputs[i].type != chunk->inputs[i].type) {
+            context->vm.error = "Input has the wrong type.";
+            return TINYC_USAGE_ERROR;
+        }
+    }
+    Value value = runVM(&context->vm, &script->chunk);
+    if (context->vm.error != NULL) return TINYC_RUNTIME_ERROR;
+    if (result != NULL) *result = value;
+    return TINYC_OK;
+}
+
+const char* tinycContextError(const TinycContext* context) {
+    return context->vm.error;
+}
+
+ValueType tinycColumnResultType(const TinycScript* script) {
+    return script->columns_unsupported == NULL ? script->columns.result_type : VALUE_VOID;
+}
+
+TinycStatus tinycRunColumns(TinycContext* context, const TinycScript* script, const void* const* inputs, long count,
+                            void* results) {
+    if (script->columns_unsupported != NULL) {
+        context->vm.error = script->columns_unsupported;
+        return TINYC_USAGE_ERROR;
+    }
+    if (script->columns.input_count > 0 && inputs == NULL) {
+        context->vm.error = "Inputs are not bound.";
+        return TINYC_USAGE_ERROR;
+    }
+    context->vm.error = runColumns(&script->columns, context->column_mode, inputs, count, results);
+    return context->vm.error != NULL ? TINYC_RUNTIME_ERROR : TINYC_OK;
+}
+
+int tinycUseKernels(TinycContext* context, TinycKernels kernels) {
+    ColumnMode mode = kernels == TINYC_KERNELS_AVX2 ? COLUMN_AVX2
+                      : kernels == TINYC_KERNELS_SSE2 ? COLUMN_SSE2
+                                                      : COLUMN_SCALAR;
+    if (!columnModeSupported(mode)) return 0;
+    context->column_mode = mode;
+    return 1;
+}
@@ -0,0 +1,109 @@
+#ifndef TINYC_H
+#define TINYC_H
+
+#include <stddef.h>
+#include "value.h"
+
+// Embedding API, built as libtinyc.a. A script is compiled once into a
+// TinycScript, which is immutable afterwards and can run any number of times,
+// from any number of threads at once. Each run needs a TinycContext holding
+// the execution state; a context can be reused for many runs but only by one
+// thread at a time. Nothing here prints or exits the process except on
+// running out of memory.
+//
+// A script takes values from the host through its input declarations
+// (input int x;). Inputs are numbered in declaration order; the host looks
+// up each index once, binds an array with one value per input to the
+// context, and then only rewrites the array between runs.
+
+// Results, numbered like the command line tool's exit statuses.
+typedef enum {
+    TINYC_OK = 0,
+    TINYC_USAGE_ERROR = 64,
+    TINYC_COMPILE_ERROR = 65,
+    TINYC_RUNTIME_ERROR = 70,
+    TINYC_IO_ERROR = 74
+} TinycStatus;
+
+typedef struct TinycScript TinycScript;
+typedef struct TinycContext TinycContext;
+
+// Compiles length bytes of source at an optimization level from 0 to 2 (see
+// -O0 to -O2). On success stores the script in *script. Otherwise *script is
+// NULL and, if errors is not NULL, *errors is set to the diagnostics as a
+// string the caller frees (or NULL if there are none).
+TinycStatus tinycCompile(const char* source, size_t length, int optimizeLevel, TinycScript** script,
+                         char** errors);
+
+// Like tinycCompile, reading the source from path.
+TinycStatus tinycCompileFile(const char* path, int optimizeLevel, TinycScript** script, char** errors);
+
+void tinycFreeScript(TinycScript* script);
+
+int tinycInputCount(const TinycScript* script);
+// The index of the input declared as name, or -1 if there is none.
+int tinycInputIndex(const TinycScript* script, const char* name);
+// The declared type of an input, VALUE_INT or VALUE_FLOAT.
+ValueType tinycInputType(const TinycScript* script, int index);
+
+TinycContext* tinycNewContext(void);
+void tinycFreeContext(TinycContext* context);
+
+// Makes later runs on context read their inputs from inputs, which holds a
+// value of the declared type for each input of the scripts run there. The
+// array is not copied: the host keeps it alive and may change it between
+// runs.
+void tinycBindInputs(TinycContext* context, const Value* inputs);
+
+// Runs script on context and stores the program's result in *result: the
+// value of its top-level return, or a void value if it has none. On a runtime
+// error returns TINYC_RUNTIME_ERROR, and TINYC_USAGE_ERROR if the script has
+// inputs and none are bound or one has the wrong type; tinycContextError
+// then describes it.
+TinycStatus tinycRun(TinycContext* context, const TinycScript* script, Value* result);
+
+// Runs script once for each of count records on threads worker threads (one
+// per CPU when threads is 0), each with its own VM, all sharing the script.
+// records holds tinycInputCount(script) values per record, one record after
+// another, and results receives each record's result. Threads that run out of
+// records take over part of a slower thread's share. On a runtime error
+// returns TINYC_RUNTIME_ERROR, and tinycContextError names the first record
+// that failed; every record before it has its result. Returns
+// TINYC_USAGE_ERROR if a value has the wrong type for its input.
+TinycStatus tinycRunRecords(TinycContext* context, const TinycScript* script, const Value* records, long count,
+                            Value* results, int threads);
+
+// Why the context's last run failed, or NULL if it succeeded.
+const char* tinycContextError(const TinycContext* context);
+
+// Column evaluation runs a script for many records in one call. Each input
+// is a column holding one int or float per record, as it is declared, and
+// the results fill a column of the script's result type. Records are worked
+// through in slices with SIMD kernels, both branches of an if running under
+// a mask of the records that take them. Scripts with loops or calls, or that
+// can finish without returning a value, cannot run this way.
+
+// The type of the script's result column, or VALUE_VOID if it cannot run over
+// columns.
+ValueType tinycColumnResultType(const TinycScript* script);
+
+// Runs script for count records, reading inputs[i] for input i and writing
+// count results. Returns TINYC_USAGE_ERROR if the script cannot run over
+// columns and TINYC_RUNTIME_ERROR if any record fails, such as on a division
+// by zero; tinycContextError then says why, and results may be partly
+// written.
+TinycStatus tinycRunColumns(TinycContext* context, const TinycScript* script, const void* const* inputs, long count,
+                            void* results);
+
+typedef enum {
+    TINYC_KERNELS_SCALAR,   // One record at a time
+    TINYC_KERNELS_SSE2,     // 4 records at a time
+    TINYC_KERNELS_AVX2      // 8 records at a time
+} TinycKernels;
+
+// Picks the kernels tinycRunColumns uses on context; the default is the widest
+// the CPU supports. Returns 0 and changes nothing if the CPU or build cannot
+// use them.
+int tinycUseKernels(TinycContext* context, TinycKernels kernels);
+
+#endif
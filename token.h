@@ -9,6 +9,7 @@ typedef enum {
     TOKEN_ELSE,
     TOKEN_WHILE,
     TOKEN_RETURN,
+    TOKEN_INPUT,
     // Identifiers and literals
     TOKEN_IDENTIFIER,
     TOKEN_INTEGER_LITERAL,
@@ -44,8 +45,10 @@ typedef enum {
 typedef struct {
     TokenType type;
     const char *lexeme;
+    int length;
     int line;
     int column;
+    int symbol;         // Interned name of an identifier, otherwise -1
 } Token;
 
 #endif
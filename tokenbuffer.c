@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "tokenbuffer.h"
+
+void initTokenBuffer(TokenBuffer* buffer) {
+    buffer->base = NULL;
+    buffer->types = NULL;
+    buffer->offsets = NULL;
+    buffer->lengths = NULL;
+    buffer->lines = NULL;
+    buffer->columns = NULL;
+    buffer->symbols = NULL;
+    buffer->count = 0;
+    buffer->capacity = 0;
+    buffer->messages = NULL;
+    buffer->message_count = 0;
+    buffer->message_capacity = 0;
+}
+
+void freeTokenBuffer(TokenBuffer* buffer) {
+    free(buffer->types);
+    free(buffer->offsets);
+    free(buffer->lengths);
+    free(buffer->lines);
+    free(buffer->columns);
+    free(buffer->symbols);
+    free(buffer->messages);
+    initTokenBuffer(buffer);
+}
+
+static void* growArray(void* array, int capacity, size_t size) {
+    void* result = realloc(array, (size_t)capacity * size);
+    if (result == NULL) {
+        fprintf(stderr, "Out of memory storing tokens.\n");
+        exit(74);
+    }
+    return result;
+}
+
+static void grow(TokenBuffer* buffer) {
+    int capacity = buffer->capacity < 1024 ? 1024 : buffer->capacity * 2;
+    buffer->types = growArray(buffer->types, capacity, sizeof(uint8_t));
+    buffer->offsets = growArray(buffer->offsets, capacity, sizeof(uint32_t));
+    buffer->lengths = growArray(buffer->lengths, capacity, sizeof(uint32_t));
+    buffer->lines = growArray(buffer->lines, capacity, sizeof(int32_t));
+    buffer->columns = growArray(buffer->columns, capacity, sizeof(int32_t));
+    buffer->symbols = growArray(buffer->symbols, capacity, sizeof(int32_t));
+    buffer->capacity = capacity;
+}
+
+static uint32_t addMessage(TokenBuffer* buffer, const char* message) {
+    if (buffer->message_count == buffer->message_capacity) {
+        buffer->message_capacity = buffer->message_capacity < 8 ? 8 : buffer->message_capacity * 2;
+        buffer->messages = growArray(buffer->messages, buffer->message_capacity, sizeof(const char*));
+    }
+    buffer->messages[buffer->message_count] = message;
+    return (uint32_t)buffer->message_count++;
+}
+
+static void push(TokenBuffer* buffer, Token* token, uint32_t offset) {
+    if (buffer->count == buffer->capacity) grow(buffer);
+
+    int index = buffer->count++;
+    buffer->types[index] = (uint8_t)token->type;
+    buffer->offsets[index] = token->type == TOKEN_ERROR ? addMessage(buffer, token->lexeme) : offset;
+    buffer->lengths[index] = (uint32_t)token->length;
+    buffer->lines[index] = token->line;
+    buffer->columns[index] = token->column;
+    buffer->symbols[index] = token->symbol;
+}
+
+void tokenize(TokenBuffer* buffer, Lexer* lexer) {
+    buffer->base = lexer->current;
+
+    for (;;) {
+        Token token = nextToken(lexer);
+        size_t offset = token.type == TOKEN_ERROR ? 0 : (size_t)(token.lexeme - buffer->base);
+
+        if (offset > UINT32_MAX) {
+            // Offsets are 32 bits; stop rather than wrap around.
+            token.type = TOKEN_ERROR;
+            token.lexeme = "Script too large.";
+            token.length = 17;
+            token.symbol = -1;
+            push(buffer, &token, 0);
+            token.type = TOKEN_EOF;
+            token.length = 0;
+            offset = 0;
+        }
+        push(buffer, &token, (uint32_t)offset);
+        if (token.type == TOKEN_EOF) break;
+    }
+}
+
+Token tokenAt(TokenBuffer* buffer, int index) {
+    // Reading past the end keeps returning the final TOKEN_EOF.
+    if (index >= buffer->count) index = buffer->count - 1;
+
+    Token token;
+    token.type = (TokenType)buffer->types[index];
+    if (token.type == TOKEN_ERROR) {
+        token.lexeme = buffer->messages[buffer->offsets[index]];
+    } else {
+        token.lexeme = buffer->base + buffer->offsets[index];
+    }
+    token.length = (int)buffer->lengths[index];
+    token.line = buffer->lines[index];
+    token.column = buffer->columns[index];
+    token.symbol = buffer->symbols[index];
+    return token;
+}
@@ -0,0 +1,34 @@
+#ifndef TOKENBUFFER_H
+#define TOKENBUFFER_H
+
+#include <stdint.h>
+#include "lexer.h"
+#include "token.h"
+
+// The whole token stream of a script, lexed up front and stored as parallel
+// arrays so the parser can look ahead any distance. Lexemes are offsets from
+// the start of the source text, which stays in place while tokens refer to it.
+typedef struct {
+    const char* base;
+    uint8_t* types;
+    uint32_t* offsets;      // Lexeme start relative to base; for TOKEN_ERROR an index into messages
+    uint32_t* lengths;
+    int32_t* lines;
+    int32_t* columns;
+    int32_t* symbols;
+    int count;
+    int capacity;
+    const char** messages;  // Lexer error messages
+    int message_count;
+    int message_capacity;
+} TokenBuffer;
+
+void initTokenBuffer(TokenBuffer* buffer);
+void freeTokenBuffer(TokenBuffer* buffer);
+
+// Lexes until TOKEN_EOF, which is always the last token stored.
+void tokenize(TokenBuffer* buffer, Lexer* lexer);
+
+Token tokenAt(TokenBuffer* buffer, int index);
+
+#endif
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "typecheck.h"
+
+typedef struct {
+    ValueType* types;       // Declared type of each program variable
+    Node* function;         // Function being checked, or NULL at top level
+    Arena* arena;
+    int hadError;
+    FILE* errors;
+} TypeChecker;
+
+static void error(TypeChecker* checker, Token* token, const char* message) {
+    fprintf(checker->errors, "[line %d] Error at '%.*s': %s\n", token->line, token->length, token->lexeme, message);
+    checker->hadError = 1;
+}
+
+static ValueType declaredType(Node* type) {
+    return type->token.type == TOKEN_FLOAT ? VALUE_FLOAT : VALUE_INT;
+}
+
+// Wraps expression in a conversion when its type is not the one wanted.
+static Node* convert(TypeChecker* checker, Node* expression, ValueType type) {
+    if (expression->value_type == type) return expression;
+    Node* node = arenaAlloc(checker->arena, sizeof(Node));
+    node->type = NODE_CONVERT;
+    node->token = expression->token;
+    node->value_type = type;
+    node->operation = type == VALUE_FLOAT ? OPERATION_INT_TO_FLOAT : OPERATION_FLOAT_TO_INT;
+    node->as.unary.operand = expression;
+    return node;
+}
+
+static Operation binaryOperation(TokenType op, ValueType type) {
+    int isFloat = type == VALUE_FLOAT;
+    switch (op) {
+        case TOKEN_PLUS:           return isFloat ? OPERATION_ADD_FLOAT : OPERATION_ADD_INT;
+        case TOKEN_MINUS:          return isFloat ? OPERATION_SUBTRACT_FLOAT : OPERATION_SUBTRACT_INT;
+        case TOKEN_ASTERISK:       return isFloat ? OPERATION_MULTIPLY_FLOAT : OPERATION_MULTIPLY_INT;
+        case TOKEN_SLASH:          return isFloat ? OPERATION_DIVIDE_FLOAT : OPERATION_DIVIDE_INT;
+        case TOKEN_EQUAL_EQUAL:    return isFloat ? OPERATION_EQUAL_FLOAT : OPERATION_EQUAL_INT;
+        case TOKEN_BANG_EQUAL:     return isFloat ? OPERATION_NOT_EQUAL_FLOAT : OPERATION_NOT_EQUAL_INT;
+        case TOKEN_LESS:           return isFloat ? OPERATION_LESS_FLOAT : OPERATION_LESS_INT;
+        case TOKEN_LESS_EQUAL:     return isFloat ? OPERATION_LESS_EQUAL_FLOAT : OPERATION_LESS_EQUAL_INT;
+        case TOKEN_GREATER:        return isFloat ? OPERATION_GREATER_FLOAT : OPERATION_GREATER_INT;
+        case TOKEN_GREATER_EQUAL:  return isFloat ? OPERATION_GREATER_EQUAL_FLOAT : OPERATION_GREATER_EQUAL_INT;
+        default:                   return OPERATION_NONE;
+    }
+}
+
+static void declare(TypeChecker* checker, Node* declaration) {
+    Node* type = declaration->as.variable_declaration.type;
+    Node* identifier = declaration->as.variable_declaration.identifier;
+    type->value_type = declaredType(type);
+    identifier->value_type = type->value_type;
+    checker->types[identifier->as.identifier.variable] = type->value_type;
+}
+
+static void checkExpression(TypeChecker* checker, Node* node) {
+    switch (node->type) {
+        case NODE_LITERAL:
+            node->value_type = node->as.literal.value.type;
+            break;
+        case NODE_IDENTIFIER:
+            node->value_type = checker->types[node->as.identifier.variable];
+            break;
+        case NODE_ASSIGNMENT: {
+            Node* target = node->as.assignment.left;
+            checkExpression(checker, target);
+            checkExpression(checker, node->as.assignment.right);
+            node->value_type = target->value_type;
+            node->as.assignment.right = convert(checker, node->as.assignment.right, node->value_type);
+            break;
+        }
+        case NODE_UNARY:
+            checkExpression(checker, node->as.unary.operand);
+            node->value_type = node->as.unary.operand->value_type;
+            if (node->token.type == TOKEN_MINUS) {
+                node->operation = node->value_type == VALUE_FLOAT ? OPERATION_NEGATE_FLOAT : OPERATION_NEGATE_INT;
+            } else if (node->token.type == TOKEN_BANG) {
+                node->operation = node->value_type == VALUE_FLOAT ? OPERATION_NOT_FLOAT : OPERATION_NOT_INT;
+                node->value_type = VALUE_INT;
+            } else {
+                error(checker, &node->token, "Unknown unary operator.");
+            }
+            break;
+        case NODE_BINARY: {
+            checkExpression(checker, node->as.binary.left);
+            checkExpression(checker, node->as.binary.right);
+            ValueType type = VALUE_INT;
+            if (node->as.binary.left->value_type == VALUE_FLOAT || node->as.binary.right->value_type == VALUE_FLOAT) {
+                type = VALUE_FLOAT;
+            }
+            node->operation = binaryOperation(node->token.type, type);
+            node->value_type = isComparison(node->operation) ? VALUE_INT : type;
+            if (node->operation == OPERATION_NONE) error(checker, &node->token, "Unknown operator.");
+            node->as.binary.left = convert(checker, node->as.binary.left, type);
+            node->as.binary.right = convert(checker, node->as.binary.right, type);
+            break;
+        }
+        case NODE_LOGICAL:
+            // Each side is only tested against zero, so keeps its own type.
+            checkExpression(checker, node->as.binary.left);
+            checkExpression(checker, node->as.binary.right);
+            node->value_type = VALUE_INT;
+            node->operation = node->token.type == TOKEN_AND ? OPERATION_AND : OPERATION_OR;
+            break;
+        case NODE_CALL: {
+            // Types come from the callee's declaration, which may not have
+            // been checked yet.
+            Node* function = node->as.call.function;
+            for (int i = 0; i < node->as.call.argument_count; i++) {
+                Node* parameter = function->as.function_declaration.parameters[i];
+                checkExpression(checker, node->as.call.arguments[i]);
+                node->as.call.arguments[i] = convert(checker, node->as.call.arguments[i],
+                                                     declaredType(parameter->as.variable_declaration.type));
+            }
+            node->value_type = declaredType(function->as.function_declaration.type);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void checkStatement(TypeChecker* checker, Node* node) {
+    switch (node->type) {
+        case NODE_VARIABLE_DECLARATION: {
+            Node* initializer = node->as.variable_declaration.initializer;
+            declare(checker, node);
+            if (initializer != NULL) {
+                checkExpression(checker, initializer);
+                node->as.variable_declaration.initializer =
+                    convert(checker, initializer, node->as.variable_declaration.type->value_type);
+            }
+            break;
+        }
+        case NODE_FUNCTION_DECLARATION: {
+            Node* type = node->as.function_declaration.type;
+            type->value_type = declaredType(type);
+            node->value_type = type->value_type;
+            for (int i = 0; i < node->as.function_declaration.parameter_count; i++) {
+                declare(checker, node->as.function_declaration.parameters[i]);
+            }
+            checker->function = node;
+            checkStatement(checker, node->as.function_declaration.body);
+            checker->function = NULL;
+            break;
+        }
+        case NODE_BLOCK:
+            for (int i = 0; i < node->as.block.statement_count; i++) {
+                checkStatement(checker, node->as.block.statements[i]);
+            }
+            break;
+        case NODE_IF_STATEMENT:
+            checkExpression(checker, node->as.if_statement.condition);
+            checkStatement(checker, node->as.if_statement.then_branch);
+            if (node->as.if_statement.else_branch != NULL) {
+                checkStatement(checker, node->as.if_statement.else_branch);
+            }
+            break;
+        case NODE_WHILE_STATEMENT:
+            checkExpression(checker, node->as.while_statement.condition);
+            checkStatement(checker, node->as.while_statement.body);
+            break;
+        case NODE_RETURN_STATEMENT: {
+            Node* value = node->as.return_statement.expression;
+            if (checker->function == NULL) {
+                // The program's result is printed with whatever type it has.
+                if (value != NULL) checkExpression(checker, value);
+                break;
+            }
+            if (value == NULL) {
+                error(checker, &node->token, "Function must return a value.");
+                break;
+            }
+            checkExpression(checker, value);
+            Node* converted = convert(checker, value, checker->function->value_type);
+            // A converted result is no longer returned directly.
+            if (converted != value && value->type == NODE_CALL) value->as.call.tail = 0;
+            node->as.return_statement.expression = converted;
+            break;
+        }
+        case NODE_EXPRESSION_STATEMENT:
+            checkExpression(checker, node->as.expression_statement.expression);
+            break;
+        default:
+            break;
+    }
+}
+
+int typeCheckProgram(Node* program, Arena* arena, FILE* errors) {
+    TypeChecker checker;
+    int count = program->as.program.variable_count;
+    checker.types = calloc(count > 0 ? count : 1, sizeof(ValueType));
+    checker.function = NULL;
+    checker.arena = arena;
+    checker.hadError = 0;
+    checker.errors = errors;
+
+    for (int i = 0; i < program->as.program.declaration_count; i++) {
+        checkStatement(&checker, program->as.program.declarations[i]);
+    }
+
+    free(checker.types);
+    return !checker.hadError;
+}
@@ -0,0 +1,17 @@
+#ifndef TYPECHECK_H
+#define TYPECHECK_H
+
+#include <stdio.h>
+#include "arena.h"
+#include "parser.h"
+
+// Gives every expression of a resolved program its static type and every
+// arithmetic node its typed operation. Variables, parameters and function
+// results have their declared type: values stored in them, passed to them or
+// returned from them are converted to it, and an int operand meeting a float
+// one is converted to float. Conversions are explicit NODE_CONVERT nodes
+// allocated from the arena that owns the tree. Unsupported operators and
+// functions returning nothing are reported to errors. Returns 0 on error.
+int typeCheckProgram(Node* program, Arena* arena, FILE* errors);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <limits.h>
+
+typedef enum {
+    VALUE_INT,
+    VALUE_FLOAT,
+    VALUE_VOID
+} ValueType;
+
+typedef struct {
+    ValueType type;
+    union {
+        int int_value;
+        float float_value;
+    } as;
+} Value;
+
+// Float to int conversion as every engine performs it: truncation toward
+// zero, with NaN and out-of-range values giving INT_MIN like the x86
+// cvttss2si instruction the native backends use.
+static inline int floatToInt(float value) {
+    if (value >= -2147483648.0f && value < 2147483648.0f) return (int)value;
+    return INT_MIN;
+}
+
+// Call depth and frame stack size shared by the engines, so a script runs out
+// of stack at the same point on each of them.
+#define FRAMES_MAX 4096
+#define STACK_MAX (FRAMES_MAX * 256)
+
+// Fused forms the engines run in place of several nodes or instructions,
+// each counted every time it runs.
+typedef enum {
+    FUSED_VARIABLE_CONSTANT,    // x op constant
+    FUSED_UPDATE,               // x = x op constant, done in place
+    FUSED_TEST_BRANCH,          // if/while testing a variable or a fused x op constant
+    FUSED_COMPARE_BRANCH,       // Comparison that branches without producing a value
+    FUSED_FORM_COUNT
+} FusedForm;
+
+#endif
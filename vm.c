@@ -0,0 +1,484 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm.h"
+
+// GCC and Clang support taking the address of a label, which lets every
+// handler jump straight to the next one instead of going back through a switch.
+#if defined(__GNUC__) || defined(__clang__)
+#define USE_COMPUTED_GOTO 1
+#else
+#define USE_COMPUTED_GOTO 0
+#endif
+
+void initVM(VM* vm) {
+    vm->stack = NULL;
+    vm->stack_capacity = 0;
+    vm->frames = NULL;
+    for (int i = 0; i < FUSED_FORM_COUNT; i++) vm->fused[i] = 0;
+    vm->inputs = NULL;
+    vm->error = NULL;
+}
+
+void freeVM(VM* vm) {
+    free(vm->stack);
+    free(vm->frames);
+    initVM(vm);
+}
+
+Value runVM(VM* vm, const Chunk* chunk) {
+    int capacity = chunk->max_stack > STACK_MAX ? chunk->max_stack : STACK_MAX;
+    if (vm->stack_capacity < capacity) {
+        vm->stack = realloc(vm->stack, capacity * sizeof(Value));
+        vm->stack_capacity = capacity;
+    }
+    if (vm->frames == NULL) vm->frames = malloc(FRAMES_MAX * sizeof(CallFrame));
+    vm->error = NULL;
+
+    const uint8_t* code = chunk->code;
+    const uint8_t* ip = code;
+    const Value* constants = chunk->constants;
+    const FunctionEntry* functions = chunk->functions;
+    const Value* inputs = vm->inputs;
+    Value* stack = vm->stack;
+    Value* stackEnd = stack + vm->stack_capacity;
+    memset(stack, 0, chunk->frame_size * sizeof(Value));
+    Value* sp = stack + chunk->frame_size;
+    Value* slots = stack;
+    CallFrame* frame = vm->frames;
+    CallFrame* framesEnd = vm->frames + FRAMES_MAX;
+
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+#define PUSH(value) (*sp++ = (value))
+#define POP() (*--sp)
+#define PEEK() (sp[-1])
+#define RUNTIME_ERROR(message) \
+    do { \
+        vm->error = message; \
+        return (Value){VALUE_VOID, {0}}; \
+    } while (0)
+
+// Operand types were checked before compiling, so the result keeps the left
+// operand's tag and only the payload changes.
+#define BINARY_OP(field, op) \
+    do { \
+        sp--; \
+        sp[-1].as.field = sp[-1].as.field op sp[0].as.field; \
+    } while (0)
+
+// Int add, subtract and multiply wrap around through unsigned arithmetic, as
+// signed overflow is undefined in C.
+#define WRAPPING_OP(op) \
+    do { \
+        sp--; \
+        sp[-1].as.int_value = (int)((unsigned int)sp[-1].as.int_value op (unsigned int)sp[0].as.int_value); \
+    } while (0)
+
+// Replaces two operands with the int 1 if they compare true, or 0.
+#define COMPARE_OP(field, op) \
+    do { \
+        sp--; \
+        sp[-1] = (Value){VALUE_INT, {.int_value = sp[-1].as.field op sp[0].as.field}}; \
+    } while (0)
+
+// Pops two operands and jumps unless they compare true, so a condition never
+// pushes the comparison's result only to pop and test it.
+#define JUMP_UNLESS_OP(field, op) \
+    do { \
+        uint16_t offset = READ_SHORT(); \
+        sp -= 2; \
+        vm->fused[FUSED_COMPARE_BRANCH]++; \
+        if (!(sp[0].as.field op sp[1].as.field)) ip += offset; \
+    } while (0)
+
+// Pushes an int local combined with an int constant, computed in type so
+// that add, subtract and multiply can wrap like WRAPPING_OP.
+#define LOCAL_CONSTANT_OP(op, type) \
+    do { \
+        Value* local = &slots[READ_SHORT()]; \
+        int constant = constants[READ_SHORT()].as.int_value; \
+        vm->fused[FUSED_VARIABLE_CONSTANT]++; \
+        PUSH(((Value){VALUE_INT, {.int_value = (int)((type)local->as.int_value op (type)constant)}})); \
+    } while (0)
+
+#if USE_COMPUTED_GOTO
+    static void* dispatchTable[] = {
+        [OP_CONSTANT] = &&do_OP_CONSTANT,
+        [OP_VOID] = &&do_OP_VOID,
+        [OP_GET_LOCAL] = &&do_OP_GET_LOCAL,
+        [OP_SET_LOCAL] = &&do_OP_SET_LOCAL,
+        [OP_INPUT] = &&do_OP_INPUT,
+        [OP_GET_GLOBAL] = &&do_OP_GET_GLOBAL,
+        [OP_SET_GLOBAL] = &&do_OP_SET_GLOBAL,
+        [OP_POP] = &&do_OP_POP,
+        [OP_POPN] = &&do_OP_POPN,
+        [OP_ADD_INT] = &&do_OP_ADD_INT,
+        [OP_SUBTRACT_INT] = &&do_OP_SUBTRACT_INT,
+        [OP_MULTIPLY_INT] = &&do_OP_MULTIPLY_INT,
+        [OP_DIVIDE_INT] = &&do_OP_DIVIDE_INT,
+        [OP_NEGATE_INT] = &&do_OP_NEGATE_INT,
+        [OP_ADD_FLOAT] = &&do_OP_ADD_FLOAT,
+        [OP_SUBTRACT_FLOAT] = &&do_OP_SUBTRACT_FLOAT,
+        [OP_MULTIPLY_FLOAT] = &&do_OP_MULTIPLY_FLOAT,
+        [OP_DIVIDE_FLOAT] = &&do_OP_DIVIDE_FLOAT,
+        [OP_NEGATE_FLOAT] = &&do_OP_NEGATE_FLOAT,
+        [OP_INT_TO_FLOAT] = &&do_OP_INT_TO_FLOAT,
+        [OP_FLOAT_TO_INT] = &&do_OP_FLOAT_TO_INT,
+        [OP_EQUAL_INT] = &&do_OP_EQUAL_INT,
+        [OP_NOT_EQUAL_INT] = &&do_OP_NOT_EQUAL_INT,
+        [OP_LESS_INT] = &&do_OP_LESS_INT,
+        [OP_LESS_EQUAL_INT] = &&do_OP_LESS_EQUAL_INT,
+        [OP_GREATER_INT] = &&do_OP_GREATER_INT,
+        [OP_GREATER_EQUAL_INT] = &&do_OP_GREATER_EQUAL_INT,
+        [OP_EQUAL_FLOAT] = &&do_OP_EQUAL_FLOAT,
+        [OP_NOT_EQUAL_FLOAT] = &&do_OP_NOT_EQUAL_FLOAT,
+        [OP_LESS_FLOAT] = &&do_OP_LESS_FLOAT,
+        [OP_LESS_EQUAL_FLOAT] = &&do_OP_LESS_EQUAL_FLOAT,
+        [OP_GREATER_FLOAT] = &&do_OP_GREATER_FLOAT,
+        [OP_GREATER_EQUAL_FLOAT] = &&do_OP_GREATER_EQUAL_FLOAT,
+        [OP_NOT_INT] = &&do_OP_NOT_INT,
+        [OP_NOT_FLOAT] = &&do_OP_NOT_FLOAT,
+        [OP_JUMP] = &&do_OP_JUMP,
+        [OP_JUMP_IF_FALSE] = &&do_OP_JUMP_IF_FALSE,
+        [OP_JUMP_IF_FALSE_FLOAT] = &&do_OP_JUMP_IF_FALSE_FLOAT,
+        [OP_JUMP_IF_TRUE] = &&do_OP_JUMP_IF_TRUE,
+        [OP_JUMP_IF_TRUE_FLOAT] = &&do_OP_JUMP_IF_TRUE_FLOAT,
+        [OP_ADD_LOCAL_CONSTANT] = &&do_OP_ADD_LOCAL_CONSTANT,
+        [OP_SUBTRACT_LOCAL_CONSTANT] = &&do_OP_SUBTRACT_LOCAL_CONSTANT,
+        [OP_MULTIPLY_LOCAL_CONSTANT] = &&do_OP_MULTIPLY_LOCAL_CONSTANT,
+        [OP_DIVIDE_LOCAL_CONSTANT] = &&do_OP_DIVIDE_LOCAL_CONSTANT,
+        [OP_INCREMENT_LOCAL] = &&do_OP_INCREMENT_LOCAL,
+        [OP_JUMP_IF_LOCAL_FALSE] = &&do_OP_JUMP_IF_LOCAL_FALSE,
+        [OP_JUMP_UNLESS_EQUAL_INT] = &&do_OP_JUMP_UNLESS_EQUAL_INT,
+        [OP_JUMP_UNLESS_NOT_EQUAL_INT] = &&do_OP_JUMP_UNLESS_NOT_EQUAL_INT,
+        [OP_JUMP_UNLESS_LESS_INT] = &&do_OP_JUMP_UNLESS_LESS_INT,
+        [OP_JUMP_UNLESS_LESS_EQUAL_INT] = &&do_OP_JUMP_UNLESS_LESS_EQUAL_INT,
+        [OP_JUMP_UNLESS_GREATER_INT] = &&do_OP_JUMP_UNLESS_GREATER_INT,
+        [OP_JUMP_UNLESS_GREATER_EQUAL_INT] = &&do_OP_JUMP_UNLESS_GREATER_EQUAL_INT,
+        [OP_JUMP_UNLESS_EQUAL_FLOAT] = &&do_OP_JUMP_UNLESS_EQUAL_FLOAT,
+        [OP_JUMP_UNLESS_NOT_EQUAL_FLOAT] = &&do_OP_JUMP_UNLESS_NOT_EQUAL_FLOAT,
+        [OP_JUMP_UNLESS_LESS_FLOAT] = &&do_OP_JUMP_UNLESS_LESS_FLOAT,
+        [OP_JUMP_UNLESS_LESS_EQUAL_FLOAT] = &&do_OP_JUMP_UNLESS_LESS_EQUAL_FLOAT,
+        [OP_JUMP_UNLESS_GREATER_FLOAT] = &&do_OP_JUMP_UNLESS_GREATER_FLOAT,
+        [OP_JUMP_UNLESS_GREATER_EQUAL_FLOAT] = &&do_OP_JUMP_UNLESS_GREATER_EQUAL_FLOAT,
+        [OP_LOOP] = &&do_OP_LOOP,
+        [OP_CALL] = &&do_OP_CALL,
+        [OP_TAIL_CALL] = &&do_OP_TAIL_CALL,
+        [OP_RETURN] = &&do_OP_RETURN,
+    };
+#define DISPATCH() goto *dispatchTable[READ_BYTE()]
+#define CASE(op) do_##op:
+#else
+#define DISPATCH() goto dispatch
+#define CASE(op) case op:
+#endif
+
+#if USE_COMPUTED_GOTO
+    DISPATCH();
+#else
+dispatch:
+    switch (READ_BYTE()) {
+#endif
+        CASE(OP_CONSTANT) {
+            PUSH(constants[READ_SHORT()]);
+            DISPATCH();
+        }
+        CASE(OP_VOID) {
+            PUSH(((Value){VALUE_VOID, {0}}));
+            DISPATCH();
+        }
+        CASE(OP_GET_LOCAL) {
+            PUSH(slots[READ_SHORT()]);
+            DISPATCH();
+        }
+        CASE(OP_SET_LOCAL) {
+            slots[READ_SHORT()] = PEEK();
+            DISPATCH();
+        }
+        CASE(OP_INPUT) {
+            PUSH(inputs[READ_SHORT()]);
+            DISPATCH();
+        }
+        CASE(OP_GET_GLOBAL) {
+            PUSH(stack[READ_SHORT()]);
+            DISPATCH();
+        }
+        CASE(OP_SET_GLOBAL) {
+            stack[READ_SHORT()] = PEEK();
+            DISPATCH();
+        }
+        CASE(OP_POP) {
+            sp--;
+            DISPATCH();
+        }
+        CASE(OP_POPN) {
+            sp -= READ_SHORT();
+            DISPATCH();
+        }
+        CASE(OP_ADD_INT) {
+            WRAPPING_OP(+);
+            DISPATCH();
+        }
+        CASE(OP_SUBTRACT_INT) {
+            WRAPPING_OP(-);
+            DISPATCH();
+        }
+        CASE(OP_MULTIPLY_INT) {
+            WRAPPING_OP(*);
+            DISPATCH();
+        }
+        CASE(OP_DIVIDE_INT) {
+            if (sp[-1].as.int_value == 0) RUNTIME_ERROR("Division by zero.");
+            if (sp[-1].as.int_value == -1 && sp[-2].as.int_value == INT_MIN) RUNTIME_ERROR("Integer overflow.");
+            BINARY_OP(int_value, /);
+            DISPATCH();
+        }
+        CASE(OP_NEGATE_INT) {
+            sp[-1].as.int_value = (int)-(unsigned int)sp[-1].as.int_value;
+            DISPATCH();
+        }
+        CASE(OP_ADD_FLOAT) {
+            BINARY_OP(float_value, +);
+            DISPATCH();
+        }
+        CASE(OP_SUBTRACT_FLOAT) {
+            BINARY_OP(float_value, -);
+            DISPATCH();
+        }
+        CASE(OP_MULTIPLY_FLOAT) {
+            BINARY_OP(float_value, *);
+            DISPATCH();
+        }
+        CASE(OP_DIVIDE_FLOAT) {
+            BINARY_OP(float_value, /);
+            DISPATCH();
+        }
+        CASE(OP_NEGATE_FLOAT) {
+            sp[-1].as.float_value = -sp[-1].as.float_value;
+            DISPATCH();
+        }
+        CASE(OP_INT_TO_FLOAT) {
+            sp[-1].type = VALUE_FLOAT;
+            sp[-1].as.float_value = (float)sp[-1].as.int_value;
+            DISPATCH();
+        }
+        CASE(OP_FLOAT_TO_INT) {
+            sp[-1].type = VALUE_INT;
+            sp[-1].as.int_value = floatToInt(sp[-1].as.float_value);
+            DISPATCH();
+        }
+        CASE(OP_EQUAL_INT) {
+            COMPARE_OP(int_value, ==);
+            DISPATCH();
+        }
+        CASE(OP_NOT_EQUAL_INT) {
+            COMPARE_OP(int_value, !=);
+            DISPATCH();
+        }
+        CASE(OP_LESS_INT) {
+            COMPARE_OP(int_value, <);
+            DISPATCH();
+        }
+        CASE(OP_LESS_EQUAL_INT) {
+            COMPARE_OP(int_value, <=);
+            DISPATCH();
+        }
+        CASE(OP_GREATER_INT) {
+            COMPARE_OP(int_value, >);
+            DISPATCH();
+        }
+        CASE(OP_GREATER_EQUAL_INT) {
+            COMPARE_OP(int_value, >=);
+            DISPATCH();
+        }
+        CASE(OP_EQUAL_FLOAT) {
+            COMPARE_OP(float_value, ==);
+            DISPATCH();
+        }
+        CASE(OP_NOT_EQUAL_FLOAT) {
+            COMPARE_OP(float_value, !=);
+            DISPATCH();
+        }
+        CASE(OP_LESS_FLOAT) {
+            COMPARE_OP(float_value, <);
+            DISPATCH();
+        }
+        CASE(OP_LESS_EQUAL_FLOAT) {
+            COMPARE_OP(float_value, <=);
+            DISPATCH();
+        }
+        CASE(OP_GREATER_FLOAT) {
+            COMPARE_OP(float_value, >);
+            DISPATCH();
+        }
+        CASE(OP_GREATER_EQUAL_FLOAT) {
+            COMPARE_OP(float_value, >=);
+            DISPATCH();
+        }
+        CASE(OP_NOT_INT) {
+            sp[-1].as.int_value = sp[-1].as.int_value == 0;
+            DISPATCH();
+        }
+        CASE(OP_NOT_FLOAT) {
+            sp[-1] = (Value){VALUE_INT, {.int_value = sp[-1].as.float_value == 0}};
+            DISPATCH();
+        }
+        CASE(OP_JUMP) {
+            uint16_t offset = READ_SHORT();
+            ip += offset;
+            DISPATCH();
+        }
+        CASE(OP_JUMP_IF_FALSE) {
+            uint16_t offset = READ_SHORT();
+            if (POP().as.int_value == 0) ip += offset;
+            DISPATCH();
+        }
+        CASE(OP_JUMP_IF_FALSE_FLOAT) {
+            uint16_t offset = READ_SHORT();
+            if (POP().as.float_value == 0) ip += offset;
+            DISPATCH();
+        }
+        CASE(OP_JUMP_IF_TRUE) {
+            uint16_t offset = READ_SHORT();
+            if (POP().as.int_value != 0) ip += offset;
+            DISPATCH();
+        }
+        CASE(OP_JUMP_IF_TRUE_FLOAT) {
+            uint16_t offset = READ_SHORT();
+            if (POP().as.float_value != 0) ip += offset;
+            DISPATCH();
+        }
+        CASE(OP_ADD_LOCAL_CONSTANT) {
+            LOCAL_CONSTANT_OP(+, unsigned int);
+            DISPATCH();
+        }
+        CASE(OP_SUBTRACT_LOCAL_CONSTANT) {
+            LOCAL_CONSTANT_OP(-, unsigned int);
+            DISPATCH();
+        }
+        CASE(OP_MULTIPLY_LOCAL_CONSTANT) {
+            LOCAL_CONSTANT_OP(*, unsigned int);
+            DISPATCH();
+        }
+        CASE(OP_DIVIDE_LOCAL_CONSTANT) {
+            LOCAL_CONSTANT_OP(/, int);
+            DISPATCH();
+        }
+        CASE(OP_INCREMENT_LOCAL) {
+            Value* local = &slots[READ_SHORT()];
+            unsigned int step = (unsigned int)constants[READ_SHORT()].as.int_value;
+            vm->fused[FUSED_UPDATE]++;
+            local->as.int_value = (int)((unsigned int)local->as.int_value + step);
+            DISPATCH();
+        }
+        CASE(OP_JUMP_IF_LOCAL_FALSE) {
+            Value* local = &slots[READ_SHORT()];
+            uint16_t offset = READ_SHORT();
+            vm->fused[FUSED_TEST_BRANCH]++;
+            if (local->as.int_value == 0) ip += offset;
+            DISPATCH();
+        }
+        CASE(OP_JUMP_UNLESS_EQUAL_INT) {
+            JUMP_UNLESS_OP(int_value, ==);
+            DISPATCH();
+        }
+        CASE(OP_JUMP_UNLESS_NOT_EQUAL_INT) {
+            JUMP_UNLESS_OP(int_value, !=);
+            DISPATCH();
+        }
+        CASE(OP_JUMP_UNLESS_LESS_INT) {
+            JUMP_UNLESS_OP(int_value, <);
+            DISPATCH();
+        }
+        CASE(OP_JUMP_UNLESS_LESS_EQUAL_INT) {
+            JUMP_UNLESS_OP(int_value, <=);
+            DISPATCH();
+        }
+        CASE(OP_JUMP_UNLESS_GREATER_INT) {
+            JUMP_UNLESS_OP(int_value, >);
+            DISPATCH();
+        }
+        CASE(OP_JUMP_UNLESS_GREATER_EQUAL_INT) {
+            JUMP_UNLESS_OP(int_value, >=);
+            DISPATCH();
+        }
+        CASE(OP_JUMP_UNLESS_EQUAL_FLOAT) {
+            JUMP_UNLESS_OP(float_value, ==);
+            DISPATCH();
+        }
+        CASE(OP_JUMP_UNLESS_NOT_EQUAL_FLOAT) {
+            JUMP_UNLESS_OP(float_value, !=);
+            DISPATCH();
+        }
+        CASE(OP_JUMP_UNLESS_LESS_FLOAT) {
+            JUMP_UNLESS_OP(float_value, <);
+            DISPATCH();
+        }
+        CASE(OP_JUMP_UNLESS_LESS_EQUAL_FLOAT) {
+            JUMP_UNLESS_OP(float_value, <=);
+            DISPATCH();
+        }
+        CASE(OP_JUMP_UNLESS_GREATER_FLOAT) {
+            JUMP_UNLESS_OP(float_value, >);
+            DISPATCH();
+        }
+        CASE(OP_JUMP_UNLESS_GREATER_EQUAL_FLOAT) {
+            JUMP_UNLESS_OP(float_value, >=);
+            DISPATCH();
+        }
+        CASE(OP_LOOP) {
+            uint16_t offset = READ_SHORT();
+            ip -= offset;
+            DISPATCH();
+        }
+        CASE(OP_CALL) {
+            const FunctionEntry* function = &functions[READ_SHORT()];
+            if (frame + 1 == framesEnd || sp - function->arity + function->max_stack > stackEnd) {
+                RUNTIME_ERROR("Stack overflow.");
+            }
+            frame->ip = ip;
+            frame->slots = slots;
+            frame++;
+            slots = sp - function->arity;
+            ip = code + function->entry;
+            DISPATCH();
+        }
+        CASE(OP_TAIL_CALL) {
+            const FunctionEntry* function = &functions[READ_SHORT()];
+            if (slots + function->max_stack > stackEnd) RUNTIME_ERROR("Stack overflow.");
+            memmove(slots, sp - function->arity, function->arity * sizeof(Value));
+            sp = slots + function->arity;
+            ip = code + function->entry;
+            DISPATCH();
+        }
+        CASE(OP_RETURN) {
+            Value result = POP();
+            if (frame == vm->frames) return result;
+            sp = slots;
+            frame--;
+            ip = frame->ip;
+            slots = frame->slots;
+            PUSH(result);
+            DISPATCH();
+        }
+#if !USE_COMPUTED_GOTO
+    }
+#endif
+
+    RUNTIME_ERROR("Unknown opcode.");
+
+#undef READ_BYTE
+#undef READ_SHORT
+#undef PUSH
+#undef POP
+#undef PEEK
+#undef RUNTIME_ERROR
+#undef BINARY_OP
+#undef COMPARE_OP
+#undef JUMP_UNLESS_OP
+#undef LOCAL_CONSTANT_OP
+#undef DISPATCH
+#undef CASE
+}
@@ -0,0 +1,31 @@
+#ifndef VM_H
+#define VM_H
+
+#include "chunk.h"
+
+typedef struct {
+    const uint8_t* ip;      // Where the caller resumes
+    Value* slots;           // Frame base: parameters, then locals
+} CallFrame;
+
+// Frames of all active calls share one stack; each frame starts at the
+// arguments its caller pushed.
+typedef struct {
+    Value* stack;
+    int stack_capacity;
+    CallFrame* frames;
+    long fused[FUSED_FORM_COUNT];   // Runs of superinstructions, by the form they fuse
+    const Value* inputs;    // Values of the chunk's input slots, by index; set by the host
+    const char* error;      // Why the last run stopped early, or NULL
+} VM;
+
+void initVM(VM* vm);
+void freeVM(VM* vm);
+// Runs chunk and returns the program's result. A chunk with inputs needs
+// vm->inputs to hold a value of the declared type for each of them; they are
+// read when the run reaches their declarations. On a runtime error, sets
+// vm->error and returns a void value. The chunk is only read, so threads
+// may run one chunk at once, each on its own VM.
+Value runVM(VM* vm, const Chunk* chunk);
+
+#endif